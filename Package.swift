@@ -2,15 +2,24 @@
 
 import PackageDescription
 
+// Trace zones (see vgerTrace.h) are recorded in debug builds.
+let tracing: [CXXSetting] = [.define("VGER_TRACING", .when(configuration: .debug))]
+
 let package = Package(
     name: "vger",
     platforms: [.macOS(.v11), .iOS(.v14)],
     products: [.library(name: "vger", targets: ["vger", "vgerSwift"])],
     dependencies: [.package(url: "https://github.com/wtholliday/MetalNanoVG", branch: "spm")],
     targets: [
-        .target(name: "vger", dependencies: [], resources: [.copy("fonts")]),
+        // The parts of vger which don't need Metal, so they also build on Linux.
+        .target(name: "vgerCore", dependencies: [], cxxSettings: tracing),
+        .target(name: "vger", dependencies: ["vgerCore"], resources: [.copy("fonts")], cxxSettings: tracing),
         .target(name: "vgerSwift", dependencies: ["vger"]),
-        .testTarget(name: "vgerTests", dependencies: ["vger", "MetalNanoVG"], resources: [.copy("images")]),
+        .target(name: "nanosvg", dependencies: []),
+        .target(name: "vgerBenchHarness", dependencies: []),
+        .executableTarget(name: "vgerBench", dependencies: ["vgerCore", "vgerBenchHarness", "nanosvg"]),
+        .executableTarget(name: "vgerMetalBench", dependencies: ["vger", "vgerBenchHarness", "nanosvg"]),
+        .testTarget(name: "vgerTests", dependencies: ["vger", "MetalNanoVG", "nanosvg"], resources: [.copy("images")], cxxSettings: tracing),
     ],
     cxxLanguageStandard: .cxx20
 )
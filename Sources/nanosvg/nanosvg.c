@@ -0,0 +1,7 @@
+// NanoSVG, shared by the tests and benchmarks for loading SVGs.
+
+// nanosvg.h uses stdio without including it.
+#include <stdio.h>
+
+#define NANOSVG_IMPLEMENTATION
+#include "nanosvg.h"
@@ -0,0 +1,48 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include "metal_compat.h"
+
+/// Affine transforms are stored as 3x2 matrices: the first two columns are
+/// the linear part and the third is the translation. They're 24 bytes with
+/// the same layout in Metal and on the CPU.
+#ifdef __METAL_VERSION__
+typedef float3x2 vgerAffine;
+#else
+typedef simd_float3x2 vgerAffine;
+#endif
+
+inline vgerAffine affineIdentity() {
+    return vgerAffine{float2{1, 0}, float2{0, 1}, float2{0, 0}};
+}
+
+inline float2 affineApply(const vgerAffine M, float2 p) {
+    return M.columns[0] * p.x + M.columns[1] * p.y + M.columns[2];
+}
+
+/// Transforms a vector, ignoring translation.
+inline float2 affineApplyVector(const vgerAffine M, float2 v) {
+    return M.columns[0] * v.x + M.columns[1] * v.y;
+}
+
+/// Returns A * B, that is, applying B then A.
+inline vgerAffine affineCompose(const vgerAffine A, const vgerAffine B) {
+    return vgerAffine{
+        affineApplyVector(A, B.columns[0]),
+        affineApplyVector(A, B.columns[1]),
+        affineApply(A, B.columns[2])
+    };
+}
+
+inline float affineDeterminant(const vgerAffine M) {
+    return M.columns[0].x * M.columns[1].y - M.columns[1].x * M.columns[0].y;
+}
+
+inline vgerAffine affineInverse(const vgerAffine M) {
+    float s = 1.0f / affineDeterminant(M);
+    auto c0 = float2{M.columns[1].y, -M.columns[0].y} * s;
+    auto c1 = float2{-M.columns[1].x, M.columns[0].x} * s;
+    auto t = -(c0 * M.columns[2].x + c1 * M.columns[2].y);
+    return vgerAffine{c0, c1, t};
+}
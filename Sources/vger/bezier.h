@@ -2,13 +2,17 @@
 
 #pragma once
 
-#include <simd/simd.h>
+#include "simd_compat.h"
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include "include/vger.h"
 using namespace simd;
 
 // See https://ttnghia.github.io/pdf/QuadraticApproximation.pdf
 
 // Approximate cubic bezier with two quadratics.
-void approx_cubic(float2 b[4], float2 q[6]) {
+inline void approx_cubic(float2 b[4], float2 q[6]) {
 
     q[0] = b[0];
     q[5] = b[3];
@@ -19,3 +23,87 @@ void approx_cubic(float2 b[4], float2 q[6]) {
     q[2] = q[3] = simd_mix(q[1], q[4], 0.5);
 
 }
+
+/// Most quadratics approx_cubic_adaptive emits for one cubic.
+constexpr int maxCubicQuads = 64;
+
+/// Number of quadratics approx_cubic_adaptive needs to stay within
+/// tolerance. Splitting a cubic into n equal pieces and replacing each
+/// with its midpoint quadratic has error at most
+/// sqrt(3)/36 * |p3 - 3p2 + 3p1 - p0| / n^3.
+/// See http://caffeineowl.com/graphics/2d/vectorial/cubic2quad01.html
+inline int cubic_quad_count(const float2 b[4], float tolerance) {
+    float d = sqrtf(3.0f) / 36.0f * simd_length(b[3] - 3*b[2] + 3*b[1] - b[0]);
+    float n = ceilf(cbrtf(d / std::max(tolerance, 1e-6f)));
+    return int(std::clamp(n, 1.0f, float(maxCubicQuads)));
+}
+
+/// Approximates a cubic with quadratics which are each within tolerance
+/// of it, calling emit(control, end) for each. Nearly quadratic cubics
+/// (including flat ones) need only one. Returns the number emitted.
+template<class F>
+inline int approx_cubic_adaptive(const float2 b[4], float tolerance, F emit) {
+
+    int n = cubic_quad_count(b, tolerance);
+
+    // Power basis, so each piece's endpoints and tangents are cheap.
+    float2 c1 = 3*(b[1] - b[0]);
+    float2 c2 = 3*(b[2] - 2*b[1] + b[0]);
+    float2 c3 = b[3] - 3*b[2] + 3*b[1] - b[0];
+
+    auto point = [&](float t) { return ((c3*t + c2)*t + c1)*t + b[0]; };
+    auto tangent = [&](float t) { return (3*c3*t + 2*c2)*t + c1; };
+
+    float dt = 1.0f / n;
+    float2 p0 = b[0];
+    float2 d0 = c1;
+
+    for(int i=1;i<=n;++i) {
+        float t = i * dt;
+        float2 p3 = i == n ? b[3] : point(t);
+        float2 d3 = tangent(t);
+
+        // Midpoint quadratic of the piece's cubic, whose inner cvs are
+        // p0 + d0*dt/3 and p3 - d3*dt/3.
+        float2 q = (p0 + p3)/2 + (d0 - d3) * (dt / 4);
+        emit(q, p3);
+
+        p0 = p3;
+        d0 = d3;
+    }
+
+    return n;
+}
+
+// Helper function to subdivide a bezier curve and collect segments
+inline void subdivideBezierForStroke(vgerBezierSegment s, float width, std::vector<vgerBezierSegment>& segments) {
+    const float min_length = 0.001f;
+    
+    // Check if this curve needs subdivision
+    float2 chord = s.c - s.a;
+    float chord_length = simd_length(chord);
+    
+    if (chord_length < min_length) {
+        return; // Skip degenerate curves
+    }
+    
+    // Calculate curve deviation from its chord
+    float2 mid_point = 0.25f * s.a + 0.5f * s.b + 0.25f * s.c; // Approximate curve midpoint
+    float2 chord_mid = 0.5f * (s.a + s.c);
+    float deviation = simd_length(mid_point - chord_mid);
+    
+    // Subdivide if deviation is too high relative to stroke width
+    if (deviation > width * 1.5f && chord_length > width * 2.0f) {
+        // Subdivide using De Casteljau's algorithm
+        float2 ab = 0.5f * (s.a + s.b);
+        float2 bc = 0.5f * (s.b + s.c);
+        float2 mid = 0.5f * (ab + bc);
+        
+        // Recursively subdivide both halves
+        subdivideBezierForStroke({s.a, ab, mid}, width, segments);
+        subdivideBezierForStroke({mid, bc, s.c}, width, segments);
+    } else {
+        // Curve is acceptable, add to segments
+        segments.push_back(s);
+    }
+}
@@ -0,0 +1,308 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include "metal_compat.h"
+#include "prim.h"
+#include "sdf.h"
+
+#ifndef __METAL_VERSION__
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#endif
+
+/// Compact encoding of vgerPrim for the prim buffer.
+///
+/// The header packs the type (4 bits), a per-type auxiliary value (4 bits)
+/// and the paint index (24 bits). The payload layout depends on the type:
+///
+///   vgerCircle:      center, radius, width
+///   vgerArc:         center, radius, width, sin/cos of rotation and
+///                    of aperture (2 x snorm16 each)
+///   vgerRect:        min, max, radius, width
+///   vgerRectStroke:  min, max, radius, width (aux is the piece, 0-7)
+///   vgerSegment:     a, b, width
+///   vgerWire:        a, b, width
+///   vgerBezier:      start (cvs buffer), width
+///   vgerCurve:       start, count, width
+///   vgerGlyph:       quad min, quad max, texture origin (2 x u16, with
+///                    the atlas page in the top 4 bits of x), texture
+///                    size (2 x half) (aux is the distance field spread
+///                    in texels, or 0 for coverage glyphs)
+///   vgerPathFill:    start, count, quad min, quad max
+///
+/// Before encodeLayer, a glyph's texture origin holds its region index and
+/// its y origin within the region instead.
+///
+/// Quad and texture bounds for the other types aren't stored. They're
+/// derived from the other fields by decodePrimBounds.
+typedef struct {
+
+    /// type | aux << 4 | paint << 8
+    uint32_t header;
+
+    /// Index of transform applied to drawing region.
+    uint32_t xform;
+
+    /// Per-type payload, as floats, 32-bit indices or packed 16-bit values.
+    uint32_t data[6];
+
+} vgerCompactPrim;
+
+#define VGER_MAX_COMPACT_PAINTS (1 << 24)
+
+#ifdef __METAL_VERSION__
+
+inline float asFloat(uint32_t u) { return as_type<float>(u); }
+
+inline float2 unpackHalf2(uint32_t u) { return float2(as_type<half2>(u)); }
+
+inline float2 unpackSnorm2(uint32_t u) { return unpack_snorm2x16_to_float(u); }
+
+#else
+
+inline float asFloat(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+inline uint32_t asUInt(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+/// GCC only has __fp16 on ARM, but _Float16 where the target supports it.
+#ifdef __FLT16_MAX__
+typedef _Float16 vgerHalf;
+#else
+typedef __fp16 vgerHalf;
+#endif
+
+inline float2 unpackHalf2(uint32_t u) {
+    vgerHalf h[2];
+    memcpy(h, &u, sizeof(u));
+    return float2{float(h[0]), float(h[1])};
+}
+
+inline uint32_t packHalf2(float2 v) {
+    vgerHalf h[2] = { vgerHalf(v.x), vgerHalf(v.y) };
+    uint32_t u;
+    memcpy(&u, h, sizeof(u));
+    return u;
+}
+
+/// Same as Metal's unpack_snorm2x16_to_float, x in the low bits.
+inline float2 unpackSnorm2(uint32_t u) {
+    auto x = int16_t(u & 0xffff), y = int16_t(u >> 16);
+    return float2{fmaxf(x / 32767.0f, -1), fmaxf(y / 32767.0f, -1)};
+}
+
+inline uint32_t packSnorm2(float2 v) {
+    auto x = int16_t(lrintf(fminf(fmaxf(v.x, -1), 1) * 32767));
+    auto y = int16_t(lrintf(fminf(fmaxf(v.y, -1), 1) * 32767));
+    return uint32_t(uint16_t(x)) | uint32_t(uint16_t(y)) << 16;
+}
+
+#endif
+
+inline vgerPrimType primType(const DEVICE vgerCompactPrim& cp) {
+    return vgerPrimType(cp.header & 0xf);
+}
+
+inline uint32_t primAux(const DEVICE vgerCompactPrim& cp) {
+    return (cp.header >> 4) & 0xf;
+}
+
+inline uint32_t primPaint(const DEVICE vgerCompactPrim& cp) {
+    return cp.header >> 8;
+}
+
+/// Atlas page of a glyph, after encodeLayer.
+inline uint32_t primGlyphPage(const DEVICE vgerCompactPrim& cp) {
+    return (cp.data[4] >> 12) & 0xf;
+}
+
+inline float2 primFloat2(const DEVICE vgerCompactPrim& cp, int i) {
+    return float2{asFloat(cp.data[i]), asFloat(cp.data[i+1])};
+}
+
+/// Decodes everything but the bounds, which the fragment function doesn't need.
+inline vgerPrim decodePrim(const DEVICE vgerCompactPrim& cp, const DEVICE float2* cvs) {
+
+    vgerPrim prim = {};
+    prim.type = primType(cp);
+    prim.paint = primPaint(cp);
+    prim.xform = cp.xform;
+
+    switch(prim.type) {
+        case vgerCircle:
+            prim.cvs[0] = primFloat2(cp, 0);
+            prim.radius = asFloat(cp.data[2]);
+            prim.width = asFloat(cp.data[3]);
+            break;
+        case vgerArc: {
+            prim.cvs[0] = primFloat2(cp, 0);
+            prim.radius = asFloat(cp.data[2]);
+            prim.width = asFloat(cp.data[3]);
+            prim.cvs[1] = unpackSnorm2(cp.data[4]);
+            prim.cvs[2] = unpackSnorm2(cp.data[5]);
+            break;
+        }
+        case vgerRect:
+        case vgerRectStroke:
+            prim.cvs[0] = primFloat2(cp, 0);
+            prim.cvs[1] = primFloat2(cp, 2);
+            prim.radius = asFloat(cp.data[4]);
+            prim.width = asFloat(cp.data[5]);
+            break;
+        case vgerSegment:
+        case vgerWire:
+            prim.cvs[0] = primFloat2(cp, 0);
+            prim.cvs[1] = primFloat2(cp, 2);
+            prim.width = asFloat(cp.data[4]);
+            break;
+        case vgerBezier:
+            prim.start = cp.data[0];
+            prim.width = asFloat(cp.data[1]);
+            for(int i=0;i<3;++i) {
+                prim.cvs[i] = cvs[prim.start + i];
+            }
+            break;
+        case vgerCurve:
+            prim.start = cp.data[0];
+            prim.count = cp.data[1];
+            prim.width = asFloat(cp.data[2]);
+            break;
+        case vgerGlyph: {
+            prim.quadBounds[0] = primFloat2(cp, 0);
+            prim.quadBounds[1] = primFloat2(cp, 2);
+            float2 origin = float2{float(cp.data[4] & 0xfff), float(cp.data[4] >> 16)};
+            prim.glyph = primGlyphPage(cp);
+            float2 size = unpackHalf2(cp.data[5]);
+            prim.texBounds[0] = origin;
+            prim.texBounds[1] = origin + float2{size.x, -size.y};
+            prim.width = primAux(cp);
+            break;
+        }
+        case vgerPathFill:
+            prim.start = cp.data[0];
+            prim.count = cp.data[1];
+            prim.quadBounds[0] = prim.texBounds[0] = primFloat2(cp, 2);
+            prim.quadBounds[1] = prim.texBounds[1] = primFloat2(cp, 4);
+            break;
+    }
+
+    return prim;
+}
+
+/// Computes quadBounds and texBounds for prims which don't store them.
+inline void decodePrimBounds(const DEVICE vgerCompactPrim& cp, THREAD vgerPrim& prim, const DEVICE float2* cvs) {
+
+    switch(prim.type) {
+        case vgerGlyph:
+        case vgerPathFill:
+            break;
+        case vgerRectStroke: {
+            // Same pieces as vgerStrokeRect.
+            auto min = prim.cvs[0], max = prim.cvs[1];
+            float pad = prim.width + 1.0;
+            float corner = prim.radius > pad ? prim.radius : pad;
+            float2 a, b;
+            switch(primAux(cp)) {
+                case 0: a = float2{min.x + corner, min.y - pad}; b = float2{max.x - corner, min.y + pad}; break;
+                case 1: a = float2{max.x - pad, min.y + corner}; b = float2{max.x + pad, max.y - corner}; break;
+                case 2: a = float2{min.x + corner, max.y - pad}; b = float2{max.x - corner, max.y + pad}; break;
+                case 3: a = float2{min.x - pad, min.y + corner}; b = float2{min.x + pad, max.y - corner}; break;
+                case 4: a = float2{min.x - pad, min.y - pad}; b = float2{min.x + corner, min.y + corner}; break;
+                case 5: a = float2{max.x - corner, min.y - pad}; b = float2{max.x + pad, min.y + corner}; break;
+                case 6: a = float2{max.x - corner, max.y - corner}; b = float2{max.x + pad, max.y + pad}; break;
+                default: a = float2{min.x - pad, max.y - corner}; b = float2{min.x + corner, max.y + pad}; break;
+            }
+            prim.quadBounds[0] = prim.texBounds[0] = a;
+            prim.quadBounds[1] = prim.texBounds[1] = b;
+            break;
+        }
+        default: {
+            auto bounds = sdPrimBounds(prim, cvs).inset(-1);
+            prim.quadBounds[0] = prim.texBounds[0] = bounds.min;
+            prim.quadBounds[1] = prim.texBounds[1] = bounds.max;
+            break;
+        }
+    }
+}
+
+#ifndef __METAL_VERSION__
+
+/// Encodes a prim. Bezier cvs must already be in the cvs buffer at
+/// cvStart. Rect stroke pieces are passed as aux.
+inline vgerCompactPrim encodePrim(const vgerPrim& prim, uint32_t cvStart, uint32_t aux = 0) {
+
+    assert(prim.paint < VGER_MAX_COMPACT_PAINTS);
+
+    vgerCompactPrim cp = {};
+    cp.header = uint32_t(prim.type) | (aux & 0xf) << 4 | prim.paint << 8;
+    cp.xform = prim.xform;
+    auto d = cp.data;
+
+    switch(prim.type) {
+        case vgerCircle:
+            d[0] = asUInt(prim.cvs[0].x); d[1] = asUInt(prim.cvs[0].y);
+            d[2] = asUInt(prim.radius);
+            d[3] = asUInt(prim.width);
+            break;
+        case vgerArc:
+            d[0] = asUInt(prim.cvs[0].x); d[1] = asUInt(prim.cvs[0].y);
+            d[2] = asUInt(prim.radius);
+            d[3] = asUInt(prim.width);
+            d[4] = packSnorm2(prim.cvs[1]);
+            d[5] = packSnorm2(prim.cvs[2]);
+            break;
+        case vgerRect:
+        case vgerRectStroke:
+            d[0] = asUInt(prim.cvs[0].x); d[1] = asUInt(prim.cvs[0].y);
+            d[2] = asUInt(prim.cvs[1].x); d[3] = asUInt(prim.cvs[1].y);
+            d[4] = asUInt(prim.radius);
+            d[5] = asUInt(prim.width);
+            break;
+        case vgerSegment:
+        case vgerWire:
+            d[0] = asUInt(prim.cvs[0].x); d[1] = asUInt(prim.cvs[0].y);
+            d[2] = asUInt(prim.cvs[1].x); d[3] = asUInt(prim.cvs[1].y);
+            d[4] = asUInt(prim.width);
+            break;
+        case vgerBezier:
+            d[0] = cvStart;
+            d[1] = asUInt(prim.width);
+            break;
+        case vgerCurve:
+            d[0] = prim.start;
+            d[1] = prim.count;
+            d[2] = asUInt(prim.width);
+            break;
+        case vgerGlyph: {
+            d[0] = asUInt(prim.quadBounds[0].x); d[1] = asUInt(prim.quadBounds[0].y);
+            d[2] = asUInt(prim.quadBounds[1].x); d[3] = asUInt(prim.quadBounds[1].y);
+            assert(prim.glyph <= 0xffff);
+            auto originY = uint32_t(prim.texBounds[0].y);
+            assert(originY <= 0xffff);
+            d[4] = prim.glyph | originY << 16;
+            auto size = prim.texBounds[1] - prim.texBounds[0];
+            d[5] = packHalf2(float2{size.x, -size.y});
+            cp.header |= (uint32_t(prim.width) & 0xf) << 4;
+            break;
+        }
+        case vgerPathFill:
+            d[0] = prim.start;
+            d[1] = prim.count;
+            d[2] = asUInt(prim.quadBounds[0].x); d[3] = asUInt(prim.quadBounds[0].y);
+            d[4] = asUInt(prim.quadBounds[1].x); d[5] = asUInt(prim.quadBounds[1].y);
+            break;
+    }
+
+    return cp;
+}
+
+#endif
@@ -0,0 +1,25 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include <functional>
+
+inline void hash_combine(size_t& seed) { }
+
+template <typename T, typename... Rest>
+inline void hash_combine(size_t& seed, const T& v, Rest... rest) {
+    std::hash<T> hasher;
+    seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
+    hash_combine(seed, rest...);
+}
+
+#define MAKE_HASHABLE(Type, ...) \
+namespace std {\
+    template<> struct hash<Type> {\
+        size_t operator()(const Type &t) const {\
+            size_t ret = 0;\
+            hash_combine(ret, __VA_ARGS__);\
+            return ret;\
+        }\
+    };\
+}
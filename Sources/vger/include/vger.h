@@ -19,7 +19,12 @@
 #define vger_h
 
 #ifndef __METAL_VERSION__
+#if __has_include(<simd/simd.h>)
 #include <simd/simd.h>
+#else
+// Building vger's portable code without Apple's headers.
+#include "../simd_compat.h"
+#endif
 #endif
 
 /// Text alignment.
@@ -41,6 +46,12 @@ typedef struct { uint32_t index; } vgerPaintIndex;
 /// Type safety for image indices.
 typedef struct { uint32_t index; } vgerImageIndex;
 
+/// Type safety for retained path indices.
+typedef struct { uint32_t index; } vgerPathIndex;
+
+/// Index of a scene loaded with vgerLoadScene.
+typedef struct { uint32_t index; } vgerStaticSceneIndex;
+
 #ifndef __METAL_VERSION__
 
 #ifdef __OBJC__
@@ -122,6 +133,90 @@ void vgerStrokeWire(vgerContext, vector_float2 a, vector_float2 b, float width,
 /// This can be useful if you want to impose a limit.
 size_t vgerPrimCount(vgerContext);
 
+/// Returns the number of prims, cvs, transforms and paints dropped this
+/// frame because the scene buffers couldn't grow. They aren't drawn.
+size_t vgerDroppedCount(vgerContext);
+
+/// Layers counted in vgerStats.
+#define VGER_STATS_LAYERS 4
+
+/// Prim types counted in vgerStats (see vgerPrimType).
+#define VGER_STATS_PRIM_TYPES 10
+
+/// How glyphs missing from the atlas are rasterized.
+enum vgerGlyphRasterMode {
+    // Default. Rasterize on the recording thread as text is drawn.
+    VGER_GLYPHS_SYNC = 0,
+
+    // Rasterize on worker threads, in parallel, and wait for them when
+    // encoding.
+    VGER_GLYPHS_ASYNC_WAIT = 1,
+
+    // Rasterize on worker threads, in parallel. Glyphs which aren't ready
+    // when encoding are left blank, keeping their space, and appear in a
+    // later frame.
+    VGER_GLYPHS_ASYNC_PLACEHOLDER = 2,
+};
+
+/// Statistics for the current frame, for attributing performance
+/// problems. Counters accumulate from vgerBegin; the buffer sizes and
+/// atlas usage are sampled when encoding.
+typedef struct {
+
+    /// Prims by layer and vgerPrimType.
+    uint32_t prims[VGER_STATS_LAYERS][VGER_STATS_PRIM_TYPES];
+
+    /// Scene buffer sizes.
+    uint32_t cvs;
+    uint32_t xforms;
+    uint32_t paints;
+
+    /// Slabs scanned when filling and creating paths. Each produces one or
+    /// more vgerPathFill prims.
+    uint32_t pathFillSlabs;
+
+    /// Text drawn from the layout cache, and text which was typeset.
+    uint32_t textCacheHits;
+    uint32_t textCacheMisses;
+
+    /// Fraction of the glyph atlas in use, over all its pages.
+    float glyphAtlasUsage;
+
+    /// Glyph atlas pages, which are added when a page is full.
+    uint32_t glyphAtlasPages;
+
+    /// Glyph atlases replaced because glyphs didn't fit, even after
+    /// evicting unused ones.
+    uint32_t glyphAtlasResets;
+
+    /// Glyphs evicted from the atlas because they hadn't been used recently.
+    uint32_t glyphEvictions;
+
+    /// Glyphs drawn blank because they were still rasterizing (see
+    /// VGER_GLYPHS_ASYNC_PLACEHOLDER).
+    uint32_t glyphPlaceholders;
+
+    /// Scene buffers allocated or grown.
+    uint32_t bufferReallocations;
+
+    /// See vgerDroppedCount.
+    uint32_t dropped;
+
+    /// Milliseconds spent filling paths, typesetting text and encoding.
+    double fillTime;
+    double textLayoutTime;
+    double encodeTime;
+
+} vgerStats;
+
+/// Gets statistics for the current frame.
+void vgerGetStats(vgerContext, vgerStats* stats);
+
+/// Returns the number of transforms sent for rendering.
+///
+/// Consecutive prims drawn with the same transform share one.
+size_t vgerXformCount(vgerContext);
+
 #pragma mark - Text
 
 /// Render text.
@@ -136,6 +231,17 @@ void vgerTextBox(vgerContext, const char* str, float breakRowWidth, vector_float
 /// Returns bounds of multi-line text.
 void vgerTextBoxBounds(vgerContext, const char* str, float breakRowWidth, vector_float2* min, vector_float2* max, int align);
 
+/// Renders text with signed distance field glyphs, which are generated
+/// once and drawn at any scale, instead of glyphs rasterized for each
+/// scale. Use when text is zoomed, so the glyph atlas doesn't fill up.
+/// Small text is slightly softer. Off by default.
+void vgerSetSDFGlyphs(vgerContext, bool sdf);
+
+/// Sets how new glyphs are rasterized (see vgerGlyphRasterMode). Use an
+/// async mode so a frame with lots of new text rasterizes it in parallel,
+/// or doesn't wait for it.
+void vgerSetGlyphRasterMode(vgerContext, enum vgerGlyphRasterMode mode);
+
 #pragma mark - Paths
 
 /// Move the pen to a point.
@@ -150,11 +256,45 @@ void vgerQuadTo(vgerContext, vector_float2 b, vector_float2 c);
 /// Crude approximation of cubic bezier with two quadratics.
 void vgerCubicApproxTo(vgerContext vg, vector_float2 b, vector_float2 c, vector_float2 d);
 
+/// Cubic bezier, approximated with as many quadratics as needed to stay
+/// within the cubic tolerance. Nearly flat cubics use one.
+void vgerCubicTo(vgerContext vg, vector_float2 b, vector_float2 c, vector_float2 d);
+
+/// Sets the maximum distance, in pixels, between cubics and their
+/// approximations. Uses the transform when vgerCubicTo is called. Default
+/// is 0.25.
+void vgerSetCubicTolerance(vgerContext vg, float tolerance);
+
 /// Fills the current path (and clears the path).
 ///
-/// Returns false if there were too many primitives to render the fill.
+/// Returns false if the paint is invalid or the path is empty.
 bool vgerFill(vgerContext, vgerPaintIndex paint);
 
+/// Creates a retained path from the current path (and clears the path).
+///
+/// The path is scanned once, so filling it each frame is much cheaper than
+/// rebuilding it. Returns index 0 if the path is empty.
+vgerPathIndex vgerCreatePath(vgerContext);
+
+/// Fills a retained path using the current transform.
+void vgerFillPath(vgerContext, vgerPathIndex path, vgerPaintIndex paint);
+
+/// Deletes a retained path. The index may be reused. Deleting a path
+/// again does nothing until its index is reused.
+void vgerDeletePath(vgerContext, vgerPathIndex path);
+
+/// Fills the current path (and clears the path) using the CPU tile
+/// renderer. Nothing is drawn until vgerEncodeTileRender.
+///
+/// Only color and gradient paints are supported.
+void vgerFillForTile(vgerContext, vgerPaintIndex paint);
+
+/// Sets the width of the tiles path fills are split into, in local coordinates.
+///
+/// Smaller tiles mean fewer segments tested per pixel but more primitives.
+/// Zero disables tiling. Default is 64.
+void vgerSetPathTileWidth(vgerContext, float width);
+
 /// Clear path information.
 ///
 /// This is useful for ensuring scripts don't mess up other rendering.
@@ -207,13 +347,27 @@ void vgerEncodeLayer(vgerContext, id<MTLCommandBuffer> buf, MTLRenderPassDescrip
 /// Encode drawing commands to a metal command buffer for the glow pass.
 void vgerEncodeGlowPass(vgerContext, id<MTLCommandBuffer> buf, MTLRenderPassDescriptor* pass);
 
-/// For debugging.
+/// Encode a scene loaded with vgerLoadScene, using the current window size.
+/// Like vgerEncode, layers after the first load the previous contents.
+void vgerEncodeStaticScene(vgerContext, vgerStaticSceneIndex scene, id<MTLCommandBuffer> buf, MTLRenderPassDescriptor* pass);
+
+/// Renders paths from vgerFillForTile into a RGBA8 or BGRA8 texture,
+/// replacing its contents. Rasterization happens on the CPU; the result is
+/// copied to the texture by a blit encoded to the command buffer.
+void vgerEncodeTileRender(vgerContext, id<MTLCommandBuffer> buf, id<MTLTexture> renderTexture);
+
+/// For debugging. A 2D texture array with a slice per page.
 id<MTLTexture> vgerGetGlyphAtlas(vgerContext);
 
-/// For debugging.
+/// For debugging. Number of segments in each tile from the last
+/// vgerEncodeTileRender (R8).
 id<MTLTexture> vgerGetCoarseDebugTexture(vgerContext);
 #endif
 
+/// Renders the current frame on the CPU into an RGBA8 buffer (top row first),
+/// cleared to opaque black. Doesn't use the GPU. Text isn't rendered.
+void vgerRenderCPU(vgerContext, uint8_t* rgba, int width, int height, int bytesPerRow);
+
 #pragma mark - Paints
 
 /// Create a paint for a constant color. Returns paint index. Paints are cleared each frame.
@@ -248,6 +402,54 @@ vgerPaintIndex vgerImagePattern(vgerContext vg,
 /// Create a paint to render a grid. Reduces the number of primitives required for a big grid.
 vgerPaintIndex vgerGrid(vgerContext, vector_float2 offset, vector_float2 size, float width, vector_float4 color);
 
+/// Makes a copy of a paint which isn't cleared each frame. Returns the
+/// index of the copy, which stays the same until it's released.
+///
+/// Identical paints created within a frame already share an index, so this
+/// is only needed to avoid recreating paints every frame.
+vgerPaintIndex vgerRetainPaint(vgerContext vg, vgerPaintIndex paint);
+
+/// Releases a paint returned by vgerRetainPaint. The index may be reused by
+/// a later call to vgerRetainPaint, so don't release paints which are used
+/// in the current frame.
+void vgerReleasePaint(vgerContext vg, vgerPaintIndex paint);
+
+#pragma mark - Static scenes
+
+/// Saves everything drawn since vgerBegin to a file which vgerLoadScene can
+/// map without parsing. Text isn't saved. Image paints refer to textures by
+/// index, so the loading context needs the same textures.
+bool vgerSaveScene(vgerContext, const char* path);
+
+/// Maps a file written by vgerSaveScene. The scene's buffers use the mapped
+/// file directly. Returns index 0 on failure.
+vgerStaticSceneIndex vgerLoadScene(vgerContext, const char* path);
+
+/// Releases a scene loaded with vgerLoadScene.
+void vgerDeleteStaticScene(vgerContext, vgerStaticSceneIndex scene);
+
+#pragma mark - Recording
+
+/// Starts recording API calls which draw or change drawing state, for
+/// replay with vgerReplay. Typically called before vgerBegin to capture a
+/// frame. Images aren't recorded.
+void vgerBeginRecording(vgerContext);
+
+/// Stops recording and writes the recorded calls to a file. Returns false
+/// if we weren't recording or the file couldn't be written.
+bool vgerEndRecording(vgerContext, const char* path);
+
+/// Maps a file written by vgerEndRecording and replays its calls. Returns
+/// false if the file couldn't be read or is malformed.
+bool vgerReplay(vgerContext, const char* path);
+
+#pragma mark - Tracing
+
+/// Writes the trace zones recorded so far as Chrome trace JSON (open it at
+/// about:tracing), then clears them. Returns false if the file couldn't be
+/// written, or if vger was built without VGER_TRACING.
+bool vgerWriteTrace(const char* path);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,11 +4,13 @@
 
 #ifdef __METAL_VERSION__
 #define DEVICE device
+#define THREAD thread
 
 #else
 #define DEVICE
+#define THREAD
 
-#include <simd/simd.h>
+#include "simd_compat.h"
 using namespace simd;
 
 inline float min(float a, float b) {
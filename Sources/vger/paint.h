@@ -3,6 +3,7 @@
 #pragma once
 
 #include "metal_compat.h"
+#include "affine.h"
 
 enum vgerPaintType {
     vgerPaintTypeLinearGradient,
@@ -14,11 +15,7 @@ struct vgerPaint {
 
     vgerPaintType type;
 
-#ifdef __METAL_VERSION__
-    float3x3 xform;
-#else
-    matrix_float3x3 xform;
-#endif
+    vgerAffine xform;
 
     float4 innerColor;
 
@@ -46,12 +43,12 @@ inline float4 applyPaint(const DEVICE vgerPaint& paint, float2 p) {
     switch (paint.type) {
         case vgerPaintTypeLinearGradient:
         {
-            float d = clamp((paint.xform * float3{p.x, p.y, 1.0}).x, 0.0, 1.0);
+            float d = clamp(affineApply(paint.xform, p).x, 0.0, 1.0);
             return mix(paint.innerColor, paint.outerColor, d);
         }
         case vgerPaintTypeRadialGradient:
         {
-            float d = clamp(length( (paint.xform * float3{p.x, p.y, 1.0}).xy), paint.innerRadius, paint.outerRadius);
+            float d = clamp(length(affineApply(paint.xform, p)), paint.innerRadius, paint.outerRadius);
             return mix(paint.innerColor, paint.outerColor, (d-paint.innerRadius) / (paint.outerRadius - paint.innerRadius));
         }
         default:
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include "metal_compat.h"
+
 /// VGER supports simple primitive types.
 typedef enum {
 
@@ -43,7 +45,8 @@ typedef struct {
     /// Type of primitive.
     vgerPrimType type;
 
-    /// Stroke width.
+    /// Stroke width. For glyphs, the distance field spread in texels, or
+    /// zero for coverage glyphs.
     float width;
 
     /// Radius of circles. Corner radius for rounded rectangles.
@@ -56,12 +59,13 @@ typedef struct {
     uint32_t start;
 
     /// Number of control vertices (vgerCurve and vgerPathFill)
-    uint16_t count;
+    uint32_t count;
 
     /// Index of paint applied to drawing region.
     uint32_t paint;
 
-    /// Glyph region index. (used internally)
+    /// Glyph region index, or its atlas page once decoded from a compact
+    /// prim. (used internally)
     uint32_t glyph;
 
     /// Index of transform applied to drawing region.
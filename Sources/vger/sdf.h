@@ -324,7 +324,7 @@ struct BBox {
     float2 size() const { return max - min; }
 };
 
-inline BBox sdPrimBounds(const DEVICE vgerPrim& prim, const DEVICE float2* cvs) {
+inline BBox sdPrimBounds(const THREAD vgerPrim& prim, const DEVICE float2* cvs) {
     BBox b;
     switch(prim.type) {
         case vgerBezier:
@@ -377,7 +377,7 @@ struct OBB {
     }
 };
 
-inline OBB sdPrimOBB(const DEVICE vgerPrim& prim) {
+inline OBB sdPrimOBB(const THREAD vgerPrim& prim) {
     switch(prim.type) {
         case vgerBezier: {
             auto o = prim.cvs[0];
@@ -481,3 +481,101 @@ inline bool bezierTest(float2 p, float2 A, float2 B, float2 C) {
     return u*u < v;
 
 }
+
+/// Signed distance to a prim. Shared by the fragment function and the
+/// CPU renderer so both produce the same coverage.
+inline float sdPrim(const THREAD vgerPrim& prim, const DEVICE float2* cvs, float2 p, float filterWidth = 0) {
+    float d = FLT_MAX;
+    float s = 1;
+    switch(prim.type) {
+        case vgerBezier:
+            d = udBezierApprox(p, prim.cvs[0], prim.cvs[1], prim.cvs[2]) - prim.width;
+            break;
+        case vgerCircle:
+            d = sdCircle(p - prim.cvs[0], prim.radius);
+            break;
+        case vgerArc:
+            d = sdArc2(p - prim.cvs[0], prim.cvs[1], prim.cvs[2], prim.radius, prim.width/2);
+            break;
+        case vgerRect:
+        case vgerGlyph: {
+            auto center = .5*(prim.cvs[1] + prim.cvs[0]);
+            auto size = prim.cvs[1] - prim.cvs[0];
+            d = sdBox(p - center, .5*size, prim.radius);
+        }
+            break;
+        case vgerRectStroke: {
+            auto center = .5*(prim.cvs[1] + prim.cvs[0]);
+            auto size = prim.cvs[1] - prim.cvs[0];
+            d = abs(sdBox(p - center, .5*size, prim.radius)) - prim.width/2;
+        }
+            break;
+        case vgerSegment:
+            d = sdSegment2(p, prim.cvs[0], prim.cvs[1], prim.width);
+            break;
+        case vgerCurve:
+            for(int i=0; i<prim.count; i++) {
+                int j = prim.start + 3*i;
+                d = min(d, udBezierApprox(p, cvs[j], cvs[j+1], cvs[j+2]));
+            }
+            break;
+        case vgerWire:
+            d = sdWire(p, prim.cvs[0], prim.cvs[1]);
+            break;
+        case vgerPathFill:
+            for(int i=0; i<prim.count; i++) {
+                int j = prim.start + 3*i;
+                auto a = cvs[j];
+                auto b = cvs[j+1];
+                auto c = cvs[j+2];
+
+                bool close = true;
+                auto xmax = p.x + filterWidth;
+                auto xmin = p.x - filterWidth;
+
+                // If the hull is far enough away, don't bother with
+                // a sdf.
+                if(a.x > xmax and b.x > xmax and c.x > xmax) {
+                    close = false;
+                } else if(a.x < xmin and b.x < xmin and c.x < xmin) {
+                    close = false;
+                }
+
+                if(close) {
+                    d = min(d, udBezier(p, a, b, c));
+
+                    // Flip if inside area between curve and line.
+                    if(bezierTest(p, a, b, c)) {
+                        s = -s;
+                    }
+                }
+
+                if(lineTest(p, a, c)) {
+                    s = -s;
+                }
+
+            }
+            d *= s;
+            break;
+        default:
+            break;
+    }
+    return d;
+}
+
+/// Coverage of a pixel from a signed distance glyph. sample is the atlas
+/// value, which is 0.5 on the outline and falls to 0 (outside) or 1
+/// (inside) over spread texels. filterWidth is the size of a pixel in
+/// texels.
+inline float sdfGlyphCoverage(float sample, float spread, float filterWidth) {
+    float d = (0.5 - sample) * 2 * spread;
+    return clamp(0.5 - d / filterWidth, 0.0, 1.0);
+}
+
+/// Size of a pixel in texels for sdfGlyphCoverage, from the texture
+/// coordinate's derivatives. This is the average length of the pixel's
+/// sides, so it doesn't change with rotation. length(fwidth(t)) would be
+/// the diagonal, which blurs glyphs by up to sqrt(2).
+inline float sdfGlyphFilterWidth(float2 dtdx, float2 dtdy) {
+    return 0.5 * (length(dtdx) + length(dtdy));
+}
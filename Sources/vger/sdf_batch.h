@@ -0,0 +1,233 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+// N-wide versions of the distance functions and inside tests in sdf.h, for
+// evaluating a run of pixels per call on the CPU. Points are passed as
+// separate x and y lanes (structure of arrays).
+//
+// V is one of simd_float4, simd_float8 or simd_float16. The compiler lowers
+// these to SSE/AVX/NEON depending on the target, so there's no
+// per-architecture code here. Without Apple's headers, simd_compat.h
+// provides them, along with the masks and simd_select.
+//
+// The scalar functions in sdf.h are the reference. Keep the arithmetic in
+// the same order so results match.
+
+#include "sdf.h"
+
+template<class V> struct vgerLanes;
+
+template<> struct vgerLanes<simd_float4> {
+    using Mask = simd_int4;
+    static constexpr int width = 4;
+};
+
+template<> struct vgerLanes<simd_float8> {
+    using Mask = simd_int8;
+    static constexpr int width = 8;
+};
+
+template<> struct vgerLanes<simd_float16> {
+    using Mask = simd_int16;
+    static constexpr int width = 16;
+};
+
+template<class V>
+inline V splatN(float x) {
+    return V{} + x;
+}
+
+/// Lanes {start, start+step, start+2*step, ...}, e.g. the x coordinates
+/// of a run of pixels.
+template<class V>
+inline V rampN(float start, float step) {
+    V v;
+    for(int i=0;i<vgerLanes<V>::width;++i) {
+        v[i] = start + i * step;
+    }
+    return v;
+}
+
+template<class V>
+inline V selectN(V a, V b, typename vgerLanes<V>::Mask mask) {
+    return simd_select(a, b, mask);
+}
+
+template<class V>
+inline V lengthN(V x, V y) {
+    return simd::sqrt(x*x + y*y);
+}
+
+template<class V>
+inline V sdCircleN(V px, V py, float r) {
+    return lengthN(px, py) - r;
+}
+
+template<class V>
+inline V sdBoxN(V px, V py, float2 b, float r) {
+    V dx = simd_abs(px)-b.x+r;
+    V dy = simd_abs(py)-b.y+r;
+    return lengthN(simd_max(dx, 0.0f), simd_max(dy, 0.0f)) + simd_min(simd_max(dx,dy), 0.0f)-r;
+}
+
+template<class V>
+inline V sdSegmentN(V px, V py, float2 a, float2 b) {
+    V pax = px-a.x, pay = py-a.y;
+    float2 ba = b-a;
+    V h = simd_clamp( (pax*ba.x + pay*ba.y)/dot(ba,ba), 0.0f, 1.0f );
+    return lengthN( pax - ba.x*h, pay - ba.y*h );
+}
+
+template<class V>
+inline V sdSegment2N(V px, V py, float2 a, float2 b, float width) {
+    float2 u = normalize(b-a);
+    float2 v = rot90(u);
+    float2 m = (a+b)/2;
+
+    V x = px - m.x, y = py - m.y;
+    return sdBoxN(x*u.x + y*u.y, x*v.x + y*v.y, float2{length(b-a)/2, width/2}, 0);
+}
+
+template<class V>
+inline V sdArc2N(V px, V py, float2 sca, float2 scb, float radius, float width) {
+    // Rotate point.
+    V x = px*sca.x + py*sca.y;
+    V y = px*(-sca.y) + py*sca.x;
+    V pie = simd_abs(x) * (-scb.y) + y*scb.x;
+    return simd_max(-pie, simd_abs(sdCircleN(x, y, radius)) - width);
+}
+
+template<class V>
+inline V dot2N(V x, V y) {
+    return x*x + y*y;
+}
+
+/// Unsigned distance to quadratic bezier curve.
+template<class V>
+inline V udBezierN(V px, V py, float2 A, float2 B, float2 C) {
+
+    // Are the points collinear?
+    auto M = float2x2{C-A, B-A};
+    if (fabs(determinant(M)) < 0.01) {
+        return sdSegmentN(px, py, A, C);
+    }
+
+    float2 a = B - A;
+    float2 b = A - 2.0*B + C;
+    float2 c = a * 2.0;
+    V dx = A.x - px, dy = A.y - py;
+    float kk = 1.0/dot(b,b);
+    float kx = kk * dot(a,b);
+    V ky = kk * (2.0f*dot(a,a) + (dx*b.x + dy*b.y)) / 3.0f;
+    V kz = kk * (dx*a.x + dy*a.y);
+    V p = ky - kx*kx;
+    V p3 = p*p*p;
+    V q = kx*(2.0f*kx*kx - 3.0f*ky) + kz;
+    V h = q*q + 4.0f*p3;
+
+    auto curveDist = [&](V t) {
+        return dot2N(dx + (c.x + b.x*t)*t, dy + (c.y + b.y*t)*t);
+    };
+
+    // One real root.
+    V hs = simd::sqrt(simd_max(h, 0.0f));
+    V x0 = (hs - q)/2.0f, x1 = (-hs - q)/2.0f;
+    V third = splatN<V>(1.0f/3.0f);
+    V uvx = simd_sign(x0)*simd::pow(simd_abs(x0), third);
+    V uvy = simd_sign(x1)*simd::pow(simd_abs(x1), third);
+    V res1 = curveDist(simd_clamp(uvx+uvy-kx, 0.0f, 1.0f));
+
+    // Three real roots. The third root cannot be the closest.
+    V z = simd::sqrt(simd_max(-p, 0.0f));
+    V v = simd::acos( q/(p*z*2.0f) ) / 3.0f;
+    V m = simd::cos(v);
+    V n = simd::sin(v)*1.732050808f;
+    V t0 = simd_clamp((m+m)*z-kx, 0.0f, 1.0f);
+    V t1 = simd_clamp((-n-m)*z-kx, 0.0f, 1.0f);
+    V res3 = simd_min(curveDist(t0), curveDist(t1));
+
+    return simd::sqrt( selectN(res3, res1, h >= 0.0f) );
+}
+
+template<class V>
+inline V udBezierApproxN(V px, V py, float2 A, float2 B, float2 C) {
+
+    float2 v0 = normalize(B - A), v1 = normalize(C - A);
+    float det = v0.x * v1.y - v1.x * v0.y;
+    if(abs(det) < 0.01) {
+        return udBezierN(px, py, A, B, C);
+    }
+
+    // get_distance_vector(A-p, B-p, C-p), a lane at a time.
+    V b0x = A.x - px, b0y = A.y - py;
+    V b1x = B.x - px, b1y = B.y - py;
+    V b2x = C.x - px, b2y = C.y - py;
+
+    auto detN = [](V ax, V ay, V bx, V by) { return ax*by - bx*ay; };
+
+    V a = detN(b0x, b0y, b2x, b2y), b = 2.0f*detN(b1x, b1y, b0x, b0y), d = 2.0f*detN(b2x, b2y, b1x, b1y);
+
+    V f = b*d - a*a;
+    float2 d21 = C - B, d10 = B - A, d20 = C - A;
+    V gx = 2.0f*(b*d21.x + d*d10.x + a*d20.x);
+    V gy = 2.0f*(b*d21.y + d*d10.y + a*d20.y);
+    V gfx = gy, gfy = -gx;
+    V gg = dot2N(gfx, gfy);
+    V ppx = -f*gfx/gg, ppy = -f*gfy/gg;
+    V d0px = b0x - ppx, d0py = b0y - ppy;
+    V ap = detN(d0px, d0py, splatN<V>(d20.x), splatN<V>(d20.y));
+    V bp = 2.0f*detN(splatN<V>(d10.x), splatN<V>(d10.y), d0px, d0py);
+    V t = simd_clamp((ap+bp)/(2.0f*a+b+d), 0.0f, 1.0f);
+
+    auto mixN = [](V a, V b, V t) { return (1-t)*a + t*b; };
+    V x = mixN(mixN(b0x, b1x, t), mixN(b1x, b2x, t), t);
+    V y = mixN(mixN(b0y, b1y, t), mixN(b1y, b2y, t), t);
+    return lengthN(x, y);
+}
+
+template<class V>
+inline typename vgerLanes<V>::Mask sideN(V px, V py, float2 A, float2 B) {
+
+    auto v = B - A;
+
+    // Intersect line with x axis.
+    V t = (py-A.y)/v.y;
+
+    return (A.x + t*v.x) > px;
+}
+
+/// Lanes are true where lineTest(p, A, B) is.
+template<class V>
+inline typename vgerLanes<V>::Mask lineTestN(V px, V py, float2 A, float2 B) {
+
+    // Trivial reject if both or neither endpoint is below.
+    auto straddles = (A.y < py) ^ (B.y < py);
+
+    return straddles & sideN(px, py, A, B);
+}
+
+/// Lanes are true where bezierTest(p, A, B, C) is.
+template<class V>
+inline typename vgerLanes<V>::Mask bezierTestN(V px, V py, float2 A, float2 B, float2 C) {
+
+    // Compute barycentric coordinates of p.
+    float2 v0 = B - A, v1 = C - A;
+    V v2x = px - A.x, v2y = py - A.y;
+    float det = v0.x * v1.y - v1.x * v0.y;
+    V s = (v2x * v1.y - v1.x * v2y) / det;
+    V t = (v0.x * v2y - v2x * v0.y) / det;
+
+    // Concave or convex?
+    auto pSide = sideN(px, py, A, C);
+    auto sameSide = side(B, A, C) ? pSide : ~pSide;
+
+    // Are we outside edge (A, B) or (B, C)?
+    auto inTriangle = ~((s < 0) | ((1-s-t) < 0));
+
+    // Transform to canonical coordinte space.
+    V u = s * .5f + t;
+    V v = t;
+
+    return sameSide & inTriangle & (u*u < v);
+}
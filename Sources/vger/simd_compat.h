@@ -0,0 +1,312 @@
+//  Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+// The parts of <simd/simd.h> used by vger's portable code (scene recording,
+// path scanning and the distance functions), so it builds where Apple's
+// headers aren't available, for example with GCC on Linux. Types have the
+// same size and alignment as Apple's, so structs shared with the shaders
+// keep their layout.
+//
+// Like Apple's, vectors convert implicitly from scalars. The functions in
+// namespace simd are overloaded for vectors. For scalars, only those which
+// metal_compat.h doesn't define are provided.
+
+#if __has_include(<simd/simd.h>)
+
+#include <simd/simd.h>
+
+#else
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+
+// GCC notes that passing wide vectors by value depends on -mavx. These are
+// all inline, so there's no ABI to keep stable.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+struct alignas(8) simd_float2 {
+    float x, y;
+
+    static constexpr int lanes = 2;
+
+    simd_float2() = default;
+    constexpr simd_float2(float s) : x(s), y(s) { }
+    constexpr simd_float2(float x, float y) : x(x), y(y) { }
+
+    float& operator[](int i) { return i ? y : x; }
+    float operator[](int i) const { return i ? y : x; }
+};
+
+struct alignas(16) simd_float3 {
+    float x, y, z;
+
+    static constexpr int lanes = 3;
+
+    simd_float3() = default;
+    constexpr simd_float3(float s) : x(s), y(s), z(s) { }
+    constexpr simd_float3(float x, float y, float z) : x(x), y(y), z(z) { }
+
+    float& operator[](int i) { return i == 0 ? x : (i == 1 ? y : z); }
+    float operator[](int i) const { return i == 0 ? x : (i == 1 ? y : z); }
+};
+
+struct alignas(16) simd_float4 {
+    float x, y, z, w;
+
+    static constexpr int lanes = 4;
+
+    simd_float4() = default;
+    constexpr simd_float4(float s) : x(s), y(s), z(s), w(s) { }
+    constexpr simd_float4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) { }
+
+    float& operator[](int i) { return i == 0 ? x : (i == 1 ? y : (i == 2 ? z : w)); }
+    float operator[](int i) const { return i == 0 ? x : (i == 1 ? y : (i == 2 ? z : w)); }
+};
+
+struct alignas(8) simd_int2 {
+    int x, y;
+
+    static constexpr int lanes = 2;
+
+    simd_int2() = default;
+    constexpr simd_int2(int s) : x(s), y(s) { }
+    constexpr simd_int2(int x, int y) : x(x), y(y) { }
+
+    int& operator[](int i) { return i ? y : x; }
+    int operator[](int i) const { return i ? y : x; }
+};
+
+/// Matrices are stored as columns.
+struct simd_float2x2 {
+    simd_float2 columns[2];
+};
+
+struct simd_float3x2 {
+    simd_float2 columns[3];
+};
+
+/// Wider vectors and lane masks, for the batched functions in sdf_batch.h.
+/// These use the compiler's vector extension, as Apple's do, so
+/// arithmetic with scalars and lane subscripts work the same. Comparisons
+/// give masks with -1 in true lanes.
+typedef float simd_float8 __attribute__((vector_size(32)));
+typedef float simd_float16 __attribute__((vector_size(64)));
+typedef int simd_int4 __attribute__((vector_size(16)));
+typedef int simd_int8 __attribute__((vector_size(32)));
+typedef int simd_int16 __attribute__((vector_size(64)));
+
+typedef simd_float2 vector_float2;
+typedef simd_float3 vector_float3;
+typedef simd_float4 vector_float4;
+typedef simd_int2 vector_int2;
+typedef simd_float2x2 matrix_float2x2;
+typedef simd_float3x2 matrix_float3x2;
+
+#define VGER_SIMD_BINARY(V, op) \
+    inline V operator op(V a, V b) { \
+        V r; \
+        for(int i=0;i<V::lanes;++i) r[i] = a[i] op b[i]; \
+        return r; \
+    } \
+    inline V& operator op##=(V& a, V b) { return a = a op b; }
+
+#define VGER_SIMD_OPERATORS(V) \
+    VGER_SIMD_BINARY(V, +) \
+    VGER_SIMD_BINARY(V, -) \
+    VGER_SIMD_BINARY(V, *) \
+    VGER_SIMD_BINARY(V, /) \
+    inline V operator-(V a) { \
+        for(int i=0;i<V::lanes;++i) a[i] = -a[i]; \
+        return a; \
+    }
+
+VGER_SIMD_OPERATORS(simd_float2)
+VGER_SIMD_OPERATORS(simd_float3)
+VGER_SIMD_OPERATORS(simd_float4)
+VGER_SIMD_OPERATORS(simd_int2)
+
+#undef VGER_SIMD_OPERATORS
+#undef VGER_SIMD_BINARY
+
+#define VGER_SIMD_COMPARE(op) \
+    inline simd_int4 operator op(simd_float4 a, simd_float4 b) { \
+        simd_int4 r; \
+        for(int i=0;i<4;++i) r[i] = a[i] op b[i] ? -1 : 0; \
+        return r; \
+    }
+
+VGER_SIMD_COMPARE(<)
+VGER_SIMD_COMPARE(>)
+VGER_SIMD_COMPARE(<=)
+VGER_SIMD_COMPARE(>=)
+
+#undef VGER_SIMD_COMPARE
+
+inline simd_float2 operator*(simd_float2x2 m, simd_float2 v) {
+    return m.columns[0] * v.x + m.columns[1] * v.y;
+}
+
+/// v as a row vector, that is, transpose(m) * v.
+inline simd_float2 operator*(simd_float2 v, simd_float2x2 m) {
+    return {v.x * m.columns[0].x + v.y * m.columns[0].y,
+            v.x * m.columns[1].x + v.y * m.columns[1].y};
+}
+
+inline simd_float2x2 operator*(simd_float2x2 a, simd_float2x2 b) {
+    return {a * b.columns[0], a * b.columns[1]};
+}
+
+inline simd_float2x2 operator*(float s, simd_float2x2 m) {
+    return {s * m.columns[0], s * m.columns[1]};
+}
+
+namespace simd {
+
+typedef ::simd_float2 float2;
+typedef ::simd_float3 float3;
+typedef ::simd_float4 float4;
+typedef ::simd_int2 int2;
+typedef ::simd_float2x2 float2x2;
+typedef ::simd_float3x2 float3x2;
+typedef ::simd_float8 float8;
+typedef ::simd_float16 float16;
+typedef ::simd_int4 int4;
+typedef ::simd_int8 int8;
+typedef ::simd_int16 int16;
+
+template<class V> constexpr int lanes = V::lanes;
+template<> constexpr int lanes<float8> = 8;
+template<> constexpr int lanes<float16> = 16;
+
+#define VGER_SIMD_MAP(V, name, expr) \
+    inline V name(V a) { \
+        for(int i=0;i<lanes<V>;++i) { float x = a[i]; a[i] = (expr); } \
+        return a; \
+    }
+
+#define VGER_SIMD_MAP2(V, name, expr) \
+    inline V name(V a, V b) { \
+        for(int i=0;i<lanes<V>;++i) { float x = a[i], y = b[i]; a[i] = (expr); } \
+        return a; \
+    }
+
+#define VGER_SIMD_LANE_FUNCTIONS(V) \
+    VGER_SIMD_MAP(V, acos, acosf(x)) \
+    VGER_SIMD_MAP(V, cos, cosf(x)) \
+    VGER_SIMD_MAP(V, sin, sinf(x))
+
+#define VGER_SIMD_FUNCTIONS(V) \
+    VGER_SIMD_MAP(V, abs, fabsf(x)) \
+    VGER_SIMD_MAP(V, sign, x > 0 ? 1.0f : (x < 0 ? -1.0f : 0.0f)) \
+    VGER_SIMD_MAP(V, floor, floorf(x)) \
+    VGER_SIMD_MAP(V, ceil, ceilf(x)) \
+    VGER_SIMD_MAP(V, sqrt, sqrtf(x)) \
+    VGER_SIMD_MAP2(V, min, y < x ? y : x) \
+    VGER_SIMD_MAP2(V, max, x < y ? y : x) \
+    VGER_SIMD_MAP2(V, step, y < x ? 0.0f : 1.0f) \
+    VGER_SIMD_MAP2(V, pow, powf(x, y)) \
+    inline V clamp(V x, V lo, V hi) { return min(max(x, lo), hi); } \
+    inline V mix(V a, V b, V t) { return a + t * (b - a); } \
+    inline float dot(V a, V b) { \
+        float d = 0; \
+        for(int i=0;i<V::lanes;++i) d += a[i] * b[i]; \
+        return d; \
+    } \
+    inline float length_squared(V v) { return dot(v, v); } \
+    inline float length(V v) { return sqrtf(dot(v, v)); } \
+    inline float distance(V a, V b) { return length(a - b); } \
+    inline V normalize(V v) { return v / length(v); } \
+    inline bool equal(V a, V b) { \
+        for(int i=0;i<V::lanes;++i) if(a[i] != b[i]) return false; \
+        return true; \
+    }
+
+VGER_SIMD_FUNCTIONS(float2)
+VGER_SIMD_FUNCTIONS(float3)
+VGER_SIMD_FUNCTIONS(float4)
+VGER_SIMD_LANE_FUNCTIONS(float4)
+
+// The wide vectors don't convert from scalars implicitly, so min, max and
+// clamp also take scalars, as Apple's do through conversion.
+#define VGER_SIMD_WIDE_FUNCTIONS(V) \
+    VGER_SIMD_MAP(V, abs, fabsf(x)) \
+    VGER_SIMD_MAP(V, sign, x > 0 ? 1.0f : (x < 0 ? -1.0f : 0.0f)) \
+    VGER_SIMD_MAP(V, sqrt, sqrtf(x)) \
+    VGER_SIMD_MAP2(V, pow, powf(x, y)) \
+    VGER_SIMD_LANE_FUNCTIONS(V) \
+    inline V min(V a, V b) { return b < a ? b : a; } \
+    inline V max(V a, V b) { return a < b ? b : a; } \
+    inline V min(V a, float b) { return min(a, V{} + b); } \
+    inline V max(V a, float b) { return max(a, V{} + b); } \
+    inline V clamp(V x, V lo, V hi) { return min(max(x, lo), hi); } \
+    inline V clamp(V x, float lo, float hi) { return min(max(x, lo), hi); }
+
+VGER_SIMD_WIDE_FUNCTIONS(float8)
+VGER_SIMD_WIDE_FUNCTIONS(float16)
+
+#undef VGER_SIMD_WIDE_FUNCTIONS
+#undef VGER_SIMD_LANE_FUNCTIONS
+#undef VGER_SIMD_FUNCTIONS
+#undef VGER_SIMD_MAP2
+#undef VGER_SIMD_MAP
+
+inline float sign(float x) {
+    return x > 0 ? 1.0f : (x < 0 ? -1.0f : 0.0f);
+}
+
+inline float determinant(float2x2 m) {
+    return m.columns[0].x * m.columns[1].y - m.columns[1].x * m.columns[0].y;
+}
+
+}
+
+// The C names, for the functions vger uses.
+#define VGER_SIMD_C_FUNCTIONS(V) \
+    inline V simd_abs(V v) { return simd::abs(v); } \
+    inline V simd_sign(V v) { return simd::sign(v); } \
+    inline V simd_min(V a, V b) { return simd::min(a, b); } \
+    inline V simd_max(V a, V b) { return simd::max(a, b); } \
+    inline V simd_clamp(V x, V lo, V hi) { return simd::clamp(x, lo, hi); } \
+    inline V simd_mix(V a, V b, V t) { return simd::mix(a, b, t); } \
+    inline float simd_dot(V a, V b) { return simd::dot(a, b); } \
+    inline float simd_length(V v) { return simd::length(v); } \
+    inline float simd_length_squared(V v) { return simd::length_squared(v); } \
+    inline float simd_distance(V a, V b) { return simd::distance(a, b); } \
+    inline V simd_normalize(V v) { return simd::normalize(v); } \
+    inline bool simd_equal(V a, V b) { return simd::equal(a, b); }
+
+VGER_SIMD_C_FUNCTIONS(simd_float2)
+VGER_SIMD_C_FUNCTIONS(simd_float3)
+VGER_SIMD_C_FUNCTIONS(simd_float4)
+
+#define VGER_SIMD_C_WIDE_FUNCTIONS(V, M) \
+    inline V simd_abs(V v) { return simd::abs(v); } \
+    inline V simd_sign(V v) { return simd::sign(v); } \
+    inline V simd_min(V a, V b) { return simd::min(a, b); } \
+    inline V simd_max(V a, V b) { return simd::max(a, b); } \
+    inline V simd_min(V a, float b) { return simd::min(a, b); } \
+    inline V simd_max(V a, float b) { return simd::max(a, b); } \
+    inline V simd_clamp(V x, V lo, V hi) { return simd::clamp(x, lo, hi); } \
+    inline V simd_clamp(V x, float lo, float hi) { return simd::clamp(x, lo, hi); } \
+    inline V simd_select(V a, V b, M mask) { return mask < 0 ? b : a; }
+
+VGER_SIMD_C_WIDE_FUNCTIONS(simd_float8, simd_int8)
+VGER_SIMD_C_WIDE_FUNCTIONS(simd_float16, simd_int16)
+
+#undef VGER_SIMD_C_WIDE_FUNCTIONS
+#undef VGER_SIMD_C_FUNCTIONS
+
+/// Lanes of b where mask is set (negative), otherwise lanes of a.
+inline simd_float4 simd_select(simd_float4 a, simd_float4 b, simd_int4 mask) {
+    for(int i=0;i<4;++i) if(mask[i] < 0) a[i] = b[i];
+    return a;
+}
+
+inline simd_float2 simd_make_float2(float x, float y) { return {x, y}; }
+inline simd_float4 simd_make_float4(float x, float y, float z, float w) { return {x, y, z, w}; }
+
+#endif
@@ -5,6 +5,7 @@ using namespace metal;
 
 #include "include/vger.h"
 #include "sdf.h"
+#include "compact_prim.h"
 #include "paint.h"
 
 #define SQRT_2 1.414213562373095
@@ -15,148 +16,29 @@ struct VertexOut {
     int primIndex;
 };
 
-float sdPrim(const DEVICE vgerPrim& prim, const DEVICE float2* cvs, float2 p, float filterWidth = 0) {
-    float d = FLT_MAX;
-    float s = 1;
-    switch(prim.type) {
-        case vgerBezier:
-            d = udBezierApprox(p, prim.cvs[0], prim.cvs[1], prim.cvs[2]) - prim.width;
-            break;
-        case vgerCircle:
-            d = sdCircle(p - prim.cvs[0], prim.radius);
-            break;
-        case vgerArc:
-            d = sdArc2(p - prim.cvs[0], prim.cvs[1], prim.cvs[2], prim.radius, prim.width/2);
-            break;
-        case vgerRect:
-        case vgerGlyph: {
-            auto center = .5*(prim.cvs[1] + prim.cvs[0]);
-            auto size = prim.cvs[1] - prim.cvs[0];
-            d = sdBox(p - center, .5*size, prim.radius);
-        }
-            break;
-        case vgerRectStroke: {
-            auto center = .5*(prim.cvs[1] + prim.cvs[0]);
-            auto size = prim.cvs[1] - prim.cvs[0];
-            d = abs(sdBox(p - center, .5*size, prim.radius)) - prim.width/2;
-        }
-            break;
-        case vgerSegment:
-            d = sdSegment2(p, prim.cvs[0], prim.cvs[1], prim.width);
-            break;
-        case vgerCurve:
-            for(int i=0; i<prim.count; i++) {
-                int j = prim.start + 3*i;
-                d = min(d, udBezierApprox(p, cvs[j], cvs[j+1], cvs[j+2]));
-            }
-            break;
-        case vgerWire:
-            d = sdWire(p, prim.cvs[0], prim.cvs[1]);
-            break;
-        case vgerPathFill:
-            for(int i=0; i<prim.count; i++) {
-                int j = prim.start + 3*i;
-                auto a = cvs[j];
-                auto b = cvs[j+1];
-                auto c = cvs[j+2];
-
-                bool close = true;
-                auto xmax = p.x + filterWidth;
-                auto xmin = p.x - filterWidth;
-
-                // If the hull is far enough away, don't bother with
-                // a sdf.
-                if(a.x > xmax and b.x > xmax and c.x > xmax) {
-                    close = false;
-                } else if(a.x < xmin and b.x < xmin and c.x < xmin) {
-                    close = false;
-                }
-
-                if(close) {
-                    d = min(d, udBezier(p, a, b, c));
-
-                    // Flip if inside area between curve and line.
-                    if(bezierTest(p, a, b, c)) {
-                        s = -s;
-                    }
-                }
-
-                if(lineTest(p, a, c)) {
-                    s = -s;
-                }
-
-            }
-            d *= s;
-            break;
-        default:
-            break;
-    }
-    return d;
-}
-
-/// Calculates bounds for prims.
-kernel void vger_bounds(uint gid [[thread_position_in_grid]],
-                        device vgerPrim* prims,
-                        const device float2* cvs,
-                        constant uint& primCount) {
-
-    if(gid < primCount) {
-        device auto& p = prims[gid];
-
-        if(p.type != vgerRectStroke and p.type != vgerGlyph and p.type != vgerPathFill) {
-
-            auto bounds = sdPrimBounds(p, cvs).inset(-1);
-            p.quadBounds[0] = p.texBounds[0] = bounds.min;
-            p.quadBounds[1] = p.texBounds[1] = bounds.max;
-
-        }
-    }
-}
-
-/// Removes a prim if its texture region is outside the rendered geometry.
-kernel void vger_prune(uint gid [[thread_position_in_grid]],
-                       device vgerPrim* prims,
-                       const device float2* cvs,
-                       constant uint& primCount) {
-
-    if(gid < primCount) {
-        device auto& prim = prims[gid];
-
-        auto center = 0.5 * (prim.texBounds[0] + prim.texBounds[1]);
-        auto tile_size = prim.texBounds[1] - prim.texBounds[0];
-
-        if(sdPrim(prim, cvs, center) > max(tile_size.x, tile_size.y) * 0.5 * SQRT_2) {
-            float2 big = {FLT_MAX, FLT_MAX};
-            prim.quadBounds[0] = big;
-            prim.quadBounds[1] = big;
-        }
-
-    }
-}
-
 vertex VertexOut vger_vertex(uint vid [[vertex_id]],
                              uint iid [[instance_id]],
-                             const device vgerPrim* prims,
-                             const device float3x3* xforms,
-                             constant float2& viewSize) {
+                             const device vgerCompactPrim* prims,
+                             const device vgerAffine* xforms,
+                             constant float2& viewSize,
+                             const device float2* cvs) {
     
-    device auto& prim = prims[iid];
+    device auto& cp = prims[iid];
+    auto prim = decodePrim(cp, cvs);
+    decodePrimBounds(cp, prim, cvs);
     
     VertexOut out;
     out.primIndex = iid;
     out.t = float2(prim.texBounds[vid & 1].x, prim.texBounds[vid >> 1].y);
 
-    auto q = xforms[prim.xform] * float3(float2(prim.quadBounds[vid & 1].x,
-                                                prim.quadBounds[vid >> 1].y),
-                                         1.0);
-
-    auto p = float2{q.x/q.z, q.y/q.z};
+    auto p = affineApply(xforms[prim.xform], float2(prim.quadBounds[vid & 1].x,
+                                                    prim.quadBounds[vid >> 1].y));
     out.position = float4(2.0 * p / viewSize - 1.0, 0, 1);
     
     return out;
 }
 
-float gridAlpha(float3 pos) {
+float gridAlpha(float2 pos) {
     float aa = length(fwidth(pos));
     auto toGrid = abs(pos - round(pos));
     auto dist = min(toGrid.x, toGrid.y);
@@ -166,7 +48,7 @@ float gridAlpha(float3 pos) {
 // Adapted from https://www.shadertoy.com/view/MtlcWX
 inline float4 applyGrid(const device vgerPaint& paint, float2 p) {
 
-    auto pos = paint.xform * float3{p.x, p.y, 1.0};
+    auto pos = affineApply(paint.xform, p);
     float alpha = gridAlpha(pos);
 
     auto color = paint.innerColor;
@@ -176,24 +58,28 @@ inline float4 applyGrid(const device vgerPaint& paint, float2 p) {
 }
 
 fragment float4 vger_fragment(VertexOut in [[ stage_in ]],
-                              const device vgerPrim* prims,
+                              const device vgerCompactPrim* prims,
                               const device float2* cvs,
                               const device vgerPaint* paints,
                               constant bool& glow,
                               texture2d<float, access::sample> tex,
-                              texture2d<float, access::sample> glyphs) {
+                              texture2d_array<float, access::sample> glyphs) {
 
-    device auto& prim = prims[in.primIndex];
-    device auto& paint = paints[prim.paint];
+    device auto& cp = prims[in.primIndex];
+    device auto& paint = paints[primPaint(cp)];
 
-    if(prim.type == vgerGlyph) {
+    if(primType(cp) == vgerGlyph) {
 
         constexpr sampler glyphSampler (mag_filter::linear,
                                           min_filter::linear,
                                           coord::pixel);
 
         auto c = paint.innerColor;
-        auto color = float4(c.rgb, c.a * glyphs.sample(glyphSampler, in.t).a);
+        float a = glyphs.sample(glyphSampler, in.t, primGlyphPage(cp)).a;
+        if(auto spread = primAux(cp)) {
+            a = sdfGlyphCoverage(a, spread, sdfGlyphFilterWidth(dfdx(in.t), dfdy(in.t)));
+        }
+        auto color = float4(c.rgb, c.a * a);
 
         if(glow) {
             color.a *= paint.glow;
@@ -202,6 +88,7 @@ fragment float4 vger_fragment(VertexOut in [[ stage_in ]],
         return color;
     }
 
+    auto prim = decodePrim(cp, cvs);
     float fw = length(fwidth(in.t));
     float d = sdPrim(prim, cvs, in.t, fw);
 
@@ -220,7 +107,7 @@ fragment float4 vger_fragment(VertexOut in [[ stage_in ]],
         constexpr sampler textureSampler (mag_filter::linear,
                                           min_filter::linear);
 
-        auto t = (paint.xform * float3(in.t,1)).xy;
+        auto t = affineApply(paint.xform, in.t);
         if(!paint.flipY) {
             t.y = 1.0 - t.y;
         }
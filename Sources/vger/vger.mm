@@ -14,6 +14,7 @@
 #import "vgerRenderer.h"
 #import "vgerTextureManager.h"
 #import "vgerGlyphCache.h"
+#import "vgerCPURenderer.h"
 
 using namespace simd;
 #import "sdf.h"
@@ -25,6 +26,7 @@ vger::vger(uint32_t flags, MTLPixelFormat pixelFormat) {
     renderer = [[vgerRenderer alloc] initWithDevice:device pixelFormat:pixelFormat];
     glowRenderer = [[vgerRenderer alloc] initWithDevice:device pixelFormat:MTLPixelFormatRGBA16Unorm];
     glyphCache = [[vgerGlyphCache alloc] initWithDevice:device];
+    setupGlyphCache();
 
     if(flags & VGER_DOUBLE_BUFFER) {
         maxBuffers = 2;
@@ -36,23 +38,17 @@ vger::vger(uint32_t flags, MTLPixelFormat pixelFormat) {
 
         vgerScene scene;
         for(int layer=0;layer<VGER_MAX_LAYERS;++layer) {
-            auto vec = GPUVec<vgerPrim>(device);
-            vec.buffer.label = [NSString stringWithFormat:@"prim buffer scene %d, layer %d", i, layer];
-            scene.prims[layer] = vec;
+            auto label = [NSString stringWithFormat:@"prim buffer scene %d, layer %d", i, layer];
+            scene.prims[layer] = GPUChunkedVec<vgerCompactPrim>(vgerMetalStorage(device, label));
         }
 
-        scene.cvs = GPUVec<float2>(device);
-        scene.cvs.buffer.label = [NSString stringWithFormat:@"cv buffer scene %d", i];
-
-        scene.xforms = GPUVec<float3x3>(device);
-        scene.xforms.buffer.label = [NSString stringWithFormat:@"xform buffer scene %d", i];
-
-        scene.paints = GPUVec<vgerPaint>(device);
-        scene.paints.buffer.label = [NSString stringWithFormat:@"paints buffer scene %d", i];
+        scene.cvs = GPUVec<float2>(vgerMetalStorage(device, [NSString stringWithFormat:@"cv buffer scene %d", i]));
+        scene.xforms = GPUVec<vgerAffine>(vgerMetalStorage(device, [NSString stringWithFormat:@"xform buffer scene %d", i]));
+        scene.paints = GPUVec<vgerPaint>(vgerMetalStorage(device, [NSString stringWithFormat:@"paints buffer scene %d", i]));
 
         scenes[i] = scene;
     }
-    txStack.push_back(matrix_identity_float3x3);
+    txStack.push_back(affineIdentity());
 
     auto desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA8Unorm width:1 height:1 mipmapped:NO];
     nullTexture = [device newTextureWithDescriptor:desc];
@@ -73,14 +69,37 @@ void vgerDelete(vgerContext vg) {
 }
 
 void vger::begin(float windowWidth, float windowHeight, float devicePxRatio) {
+
+    VGER_TRACE_ZONE("vger::begin");
+
+    // Size this frame's buffers like the last, so they don't grow again.
+    // Drops are reported by vgerDroppedCount and vgerStats.
+    auto sizes = scenes[currentScene].sizes();
+
     currentScene = (currentScene+1) % maxBuffers;
     scenes[currentScene].clear();
+    scenes[currentScene].reserve(sizes);
+    stats = {};
     currentLayer = 0;
+    xformIndex = NoXform;
+    std::fill(xformIndexStack.begin(), xformIndexStack.end(), NoXform);
     windowSize = {windowWidth, windowHeight};
     this->devicePxRatio = devicePxRatio;
     for(int layer=0; layer<VGER_MAX_LAYERS; ++layer) {
         computedGlyphBounds[layer] = false;
     }
+    tileFills.clear();
+    tileFillCVs.clear();
+
+    // Retained paints go first, with some room for more to be retained
+    // during the frame.
+    paintTable.clear();
+    auto& paints = scenes[currentScene].paints;
+    retainedPaintSlots = uint32_t(std::max<size_t>(16, 2 * retainedPaints.size()));
+    paints.append(retainedPaints.data(), retainedPaints.size());
+    for(size_t i=retainedPaints.size(); i<retainedPaintSlots; ++i) {
+        paints.append(vgerPaint{});
+    }
 
     // Prune the text cache.
     for(auto it = std::begin(textCache); it != std::end(textCache);) {
@@ -93,14 +112,25 @@ void vger::begin(float windowWidth, float windowHeight, float devicePxRatio) {
 
     currentFrame++;
 
-    // Do we need to create a new glyph cache?
-    if(glyphCache.usage > 0.8f) {
+    // Unused glyphs are evicted to make room, so only create a new glyph
+    // cache if that wasn't enough.
+    if(glyphCache.full) {
         glyphCache = [[vgerGlyphCache alloc] initWithDevice:device];
+        setupGlyphCache();
         textCache.clear();
+        stats.glyphAtlasResets++;
     }
+    [glyphCache beginFrame];
+}
+
+void vger::setupGlyphCache() {
+    glyphCache.async = glyphRasterMode != VGER_GLYPHS_SYNC;
+    glyphCache.waitForGlyphs = glyphRasterMode != VGER_GLYPHS_ASYNC_PLACEHOLDER;
 }
 
 void vgerBegin(vgerContext vg, float windowWidth, float windowHeight, float devicePxRatio) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpBegin, windowWidth, windowHeight, devicePxRatio);
 
     vg->begin(windowWidth, windowHeight, devicePxRatio);
 
@@ -198,6 +228,8 @@ vector_int2 vgerTextureSize(vgerContext vg, vgerImageIndex texID) {
 }
 
 void vgerFillCircle(vgerContext vg, vector_float2 center, float radius, vgerPaintIndex paint) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpFillCircle, center, radius, paint);
 
     if(!vg->checkPaint(paint)) return;
 
@@ -207,13 +239,15 @@ void vgerFillCircle(vgerContext vg, vector_float2 center, float radius, vgerPain
         .radius = radius,
         .cvs = { center },
         .paint = paint.index,
-        .xform = vg->addxform(vg->txStack.back())
+        .xform = vg->currentXform()
     };
 
     vg->addPrim(prim);
 }
 
 void vgerStrokeArc(vgerContext vg, vector_float2 center, float radius, float width, float rotation, float aperture, vgerPaintIndex paint) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpStrokeArc, center, radius, width, rotation, aperture, paint);
 
     if(!vg->checkPaint(paint)) return;
 
@@ -223,13 +257,15 @@ void vgerStrokeArc(vgerContext vg, vector_float2 center, float radius, float wid
         .radius = radius,
         .cvs = { center, {sin(rotation), cos(rotation)}, {sin(aperture), cos(aperture)} },
         .paint = paint.index,
-        .xform = vg->addxform(vg->txStack.back())
+        .xform = vg->currentXform()
     };
 
     vg->addPrim(prim);
 }
 
 void vgerFillRect(vgerContext vg, vector_float2 min, vector_float2 max, float radius, vgerPaintIndex paint) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpFillRect, min, max, radius, paint);
 
     if(!vg->checkPaint(paint)) return;
 
@@ -238,20 +274,25 @@ void vgerFillRect(vgerContext vg, vector_float2 min, vector_float2 max, float ra
         .radius = radius,
         .cvs = { min, max },
         .paint = paint.index,
-        .xform = vg->addxform(vg->txStack.back())
+        .xform = vg->currentXform()
     };
 
     vg->addPrim(prim);
 }
 
 void vgerStrokeRect(vgerContext vg, vector_float2 min, vector_float2 max, float radius, float width, vgerPaintIndex paint) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpStrokeRect, min, max, radius, width, paint);
 
     if(!vg->checkPaint(paint)) return;
 
     const float pad = width + 1.0f;
     const float corner = radius > pad ? radius : pad;
-    const uint32_t xform = vg->addxform(vg->txStack.back());
+    const uint32_t xform = vg->currentXform();
 
+    // The compact encoding only stores the piece index, so the order
+    // here must match decodePrimBounds.
+    uint32_t piece = 0;
     auto addStrokePrim = [&](float2 boundsMin, float2 boundsMax) {
         vgerPrim prim {
             .type = vgerRectStroke,
@@ -263,7 +304,7 @@ void vgerStrokeRect(vgerContext vg, vector_float2 min, vector_float2 max, float
             .quadBounds = { boundsMin, boundsMax },
             .texBounds = { boundsMin, boundsMax }
         };
-        vg->addPrim(prim);
+        vg->addPrim(prim, piece++);
     };
 
     addStrokePrim(float2{min.x + corner, min.y - pad},
@@ -286,40 +327,9 @@ void vgerStrokeRect(vgerContext vg, vector_float2 min, vector_float2 max, float
 
 }
 
-// Helper function to subdivide a bezier curve and collect segments
-static void subdivideBezierForStroke(vgerBezierSegment s, float width, std::vector<vgerBezierSegment>& segments) {
-    const float min_length = 0.001f;
-    
-    // Check if this curve needs subdivision
-    float2 chord = s.c - s.a;
-    float chord_length = simd_length(chord);
-    
-    if (chord_length < min_length) {
-        return; // Skip degenerate curves
-    }
-    
-    // Calculate curve deviation from its chord
-    float2 mid_point = 0.25f * s.a + 0.5f * s.b + 0.25f * s.c; // Approximate curve midpoint
-    float2 chord_mid = 0.5f * (s.a + s.c);
-    float deviation = simd_length(mid_point - chord_mid);
-    
-    // Subdivide if deviation is too high relative to stroke width
-    if (deviation > width * 1.5f && chord_length > width * 2.0f) {
-        // Subdivide using De Casteljau's algorithm
-        float2 ab = 0.5f * (s.a + s.b);
-        float2 bc = 0.5f * (s.b + s.c);
-        float2 mid = 0.5f * (ab + bc);
-        
-        // Recursively subdivide both halves
-        subdivideBezierForStroke({s.a, ab, mid}, width, segments);
-        subdivideBezierForStroke({mid, bc, s.c}, width, segments);
-    } else {
-        // Curve is acceptable, add to segments
-        segments.push_back(s);
-    }
-}
-
 void vgerStrokeBezier(vgerContext vg, vgerBezierSegment s, float width, vgerPaintIndex paint) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpStrokeBezier, s, width, paint);
 
     if(!vg->checkPaint(paint)) return;
 
@@ -421,7 +431,7 @@ void vgerStrokeBezier(vgerContext vg, vgerBezierSegment s, float width, vgerPain
             .width = 2.0f * width,
             .cvs = { s.a, s.c },
             .paint = paint.index,
-            .xform = vg->addxform(vg->txStack.back())
+            .xform = vg->currentXform()
         };
 
         vg->addPrim(prim);
@@ -432,7 +442,7 @@ void vgerStrokeBezier(vgerContext vg, vgerBezierSegment s, float width, vgerPain
             .width = width,
             .cvs = { s.a, s.b, s.c },
             .paint = paint.index,
-            .xform = vg->addxform(vg->txStack.back())
+            .xform = vg->currentXform()
         };
 
         vg->addPrim(prim);
@@ -441,6 +451,8 @@ void vgerStrokeBezier(vgerContext vg, vgerBezierSegment s, float width, vgerPain
 }
 
 void vgerStrokeSegment(vgerContext vg, vector_float2 a, vector_float2 b, float width, vgerPaintIndex paint) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpStrokeSegment, a, b, width, paint);
 
     if(!vg->checkPaint(paint)) return;
 
@@ -449,13 +461,15 @@ void vgerStrokeSegment(vgerContext vg, vector_float2 a, vector_float2 b, float w
         .width = width,
         .cvs = { a, b },
         .paint = paint.index,
-        .xform = vg->addxform(vg->txStack.back())
+        .xform = vg->currentXform()
     };
 
     vg->addPrim(prim);
 }
 
 void vgerStrokeWire(vgerContext vg, vector_float2 a, vector_float2 b, float width, vgerPaintIndex paint) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpStrokeWire, a, b, width, paint);
 
     if(!vg->checkPaint(paint)) return;
 
@@ -464,19 +478,35 @@ void vgerStrokeWire(vgerContext vg, vector_float2 a, vector_float2 b, float widt
         .width = width,
         .cvs = { a, b },
         .paint = paint.index,
-        .xform = vg->addxform(vg->txStack.back())
+        .xform = vg->currentXform()
     };
 
     vg->addPrim(prim);
 }
 
+static_assert(VGER_STATS_LAYERS == VGER_MAX_LAYERS);
+static_assert(VGER_STATS_PRIM_TYPES == vgerPathFill + 1);
+
+void vgerGetStats(vgerContext vg, vgerStats* stats) {
+    assert(stats);
+    *stats = vg->stats;
+}
+
+size_t vgerDroppedCount(vgerContext vg) {
+    return vg->scenes[vg->currentScene].dropped();
+}
+
 size_t vgerPrimCount(vgerContext vg) {
     return vg->primCount();
 }
 
-static float averageScale(const float3x3& M)
+size_t vgerXformCount(vgerContext vg) {
+    return vg->scenes[vg->currentScene].xforms.count;
+}
+
+static float averageScale(const vgerAffine& M)
 {
-    return 0.5f * (length(M.columns[0].xy) + length(M.columns[1].xy));
+    return 0.5f * (length(M.columns[0]) + length(M.columns[1]));
 }
 
 static float2 alignOffset(CTLineRef line, int align) {
@@ -504,6 +534,9 @@ static float2 alignOffset(CTLineRef line, int align) {
 }
 
 void vgerText(vgerContext vg, const char* str, float4 color, int align) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpText, vgerRecordedString{str}, color, align);
+
     vg->renderText(str, color, align);
 }
 
@@ -515,9 +548,11 @@ bool vger::renderCachedText(const TextLayoutKey& key, vgerPaintIndex paint, uint
         // Copy prims to output.
         auto& info = iter->second;
         info.lastFrame = currentFrame;
+        stats.textCacheHits++;
         for(auto prim : info.prims) {
             prim.paint = paint.index;
             prim.xform = xform;
+            [glyphCache useRegion:prim.glyph];
             addPrim(prim);
         }
         return true;
@@ -528,6 +563,8 @@ bool vger::renderCachedText(const TextLayoutKey& key, vgerPaintIndex paint, uint
 
 void vger::renderTextLine(CTLineRef line, TextLayoutInfo& textInfo, vgerPaintIndex paint, float2 offset, float scale, uint32_t xform) {
 
+    VGER_TRACE_ZONE("vger::renderTextLine");
+
     assert(!isnan(scale));
     CFRange entire = CFRangeMake(0, 0);
 
@@ -541,7 +578,7 @@ void vger::renderTextLine(CTLineRef line, TextLayoutInfo& textInfo, vgerPaintInd
 
         for(int i=0;i<glyphCount;++i) {
 
-            auto info = [glyphCache getGlyph:glyphs[i] scale:scale];
+            auto info = sdfGlyphs ? [glyphCache getSDFGlyph:glyphs[i]] : [glyphCache getGlyph:glyphs[i] scale:scale];
             if(info.regionIndex != -1) {
 
                 CGRect r = CTRunGetImageBounds(run, nil, CFRangeMake(i, 1));
@@ -557,6 +594,7 @@ void vger::renderTextLine(CTLineRef line, TextLayoutInfo& textInfo, vgerPaintInd
 
                 vgerPrim prim = {
                     .type = vgerGlyph,
+                    .width = info.sdf ? float(GLYPH_MARGIN) : 0.0f,
                     .paint = paint.index,
                     .xform = xform,
                     .quadBounds = { a, b },
@@ -584,17 +622,8 @@ void vger::renderGlyphPath(CGGlyph glyph, vgerPaintIndex paint, float2 position,
     vgerSave(this);
     vgerTranslate(this, position);
     
-    for(auto prim : info.prims) {
-        prim.xform = xform;
-        prim.paint = paint.index;
-        prim.start += scenes[currentScene].cvs.count;
-        addPrim(prim);
-    }
-    
-    for(auto cv : info.cvs) {
-        addCV(cv);
-    }
-    
+    addPathPrims(info.prims, info.cvs, paint, xform);
+
     vgerRestore(this);
 }
 
@@ -618,6 +647,8 @@ bool glyphPaths = false;
 
 void vger::renderText(const char* str, float4 color, int align) {
 
+    VGER_TRACE_ZONE("vger::renderText");
+
     assert(str);
 
     if(str[0] == 0) {
@@ -627,7 +658,7 @@ void vger::renderText(const char* str, float4 color, int align) {
     auto paint = vgerColorPaint(this, color);
 
     assert(!txStack.empty());
-    auto xform = addxform(txStack.back());
+    auto xform = currentXform();
     
     if(glyphPaths) {
 
@@ -657,13 +688,16 @@ void vger::renderText(const char* str, float4 color, int align) {
     } else {
 
         auto scale = averageScale(txStack.back()) * devicePxRatio;
-        auto key = TextLayoutKey{std::string(str), scale, align};
+        // Distance field glyphs work at any scale, so share their layouts.
+        auto key = TextLayoutKey{std::string(str), sdfGlyphs ? 0.0f : scale, align, -1, sdfGlyphs};
         
         if(renderCachedText(key, paint, xform)) {
             return;
         }
 
         // Text cache miss, do more expensive typesetting.
+        vgerStatTimer timer(stats.textLayoutTime);
+        stats.textCacheMisses++;
         auto line = createCTLine(str);
 
         auto& textInfo = textCache[key];
@@ -705,6 +739,9 @@ void vgerTextBounds(vgerContext vg, const char* str, float2* min, float2* max, i
 }
 
 void vgerTextBox(vgerContext vg, const char* str, float breakRowWidth, float4 color, int align) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpTextBox, vgerRecordedString{str}, breakRowWidth, color, align);
+
     vg->renderTextBox(str, breakRowWidth, color, align);
 }
 
@@ -748,13 +785,15 @@ void vger::renderTextBox(const char* str, float breakRowWidth, float4 color, int
 
     auto paint = vgerColorPaint(this, color);
     auto scale = averageScale(txStack.back()) * devicePxRatio;
-    auto key = TextLayoutKey{std::string(str), scale, align, breakRowWidth};
-    auto xform = addxform(txStack.back());
+    auto key = TextLayoutKey{std::string(str), sdfGlyphs ? 0.0f : scale, align, breakRowWidth, sdfGlyphs};
+    auto xform = currentXform();
 
     if(renderCachedText(key, paint, xform)) {
         return;
     }
 
+    vgerStatTimer timer(stats.textLayoutTime);
+    stats.textCacheMisses++;
     auto frame = createCTFrame(str, align, breakRowWidth);
 
     NSArray *lines = (__bridge id)CTFrameGetLines(frame);
@@ -825,6 +864,8 @@ void vgerTextBoxBounds(vgerContext vg, const char* str, float breakRowWidth, flo
 
 bool vger::fill(vgerPaintIndex paint) {
 
+    VGER_TRACE_ZONE("vger::fill");
+
     if(!checkPaint(paint)) {
         return false;
     }
@@ -833,82 +874,237 @@ bool vger::fill(vgerPaintIndex paint) {
         return false;
     }
 
-    auto xform = addxform(txStack.back());
+    vgerStatTimer timer(stats.fillTime);
 
-    yScanner._init();
+    fillPrims.clear();
+    fillCVs.clear();
+    float fw = filterWidth();
+    yScanner._init(fw);
+    yScanner.scanPrims(pathTileWidth, fw, fillPrims, fillCVs);
+    yScanner.segments.clear();
+    stats.pathFillSlabs += yScanner.slabCount;
 
-    size_t fillPrimCount = 0;
-    constexpr size_t MaxFillPrims = 2048;
-    while(yScanner.next()) {
+    addPathPrims(fillPrims, fillCVs, paint, currentXform());
 
-        int n = yScanner.activeCount;
+    return true;
+}
 
-        vgerPrim prim = {
-            .type = vgerPathFill,
-            .start = static_cast<uint32_t>(scenes[currentScene].cvs.count),
-            .count = uint16_t(n),
-            .paint = paint.index,
-            .xform = xform,
-        };
+void vger::addPathPrims(const std::vector<vgerPrim>& prims, const std::vector<float2>& cvs, vgerPaintIndex paint, uint32_t xform) {
+
+    auto& scene = scenes[currentScene];
+    auto start = uint32_t(scene.cvs.count);
+    scene.cvs.append(cvs.data(), cvs.size());
+
+    for(auto prim : prims) {
+        prim.xform = xform;
+        prim.paint = paint.index;
+        prim.start += start;
+        addPrim(prim);
+    }
+}
 
-        Interval xInt{FLT_MAX, -FLT_MAX};
+vgerPathIndex vger::createPath() {
 
-        for(int a = yScanner.first; a != -1; a = yScanner.segments[a].next) {
+    if(yScanner.segments.empty()) {
+        return {0};
+    }
+
+    // Slot 0 indicates errors.
+    if(retainedPaths.empty()) {
+        retainedPaths.emplace_back();
+    }
 
-            assert(a < yScanner.segments.size());
+    uint32_t index;
+    if(freePaths.size()) {
+        index = freePaths.back();
+        freePaths.pop_back();
+    } else {
+        index = uint32_t(retainedPaths.size());
+        retainedPaths.emplace_back();
+    }
+
+    auto& path = retainedPaths[index];
+    path.freed = false;
+    path.segments.clear();
+    std::swap(path.segments, yScanner.segments);
+    scanPath(path, filterWidth());
+
+    return {index};
+}
+
+void vger::scanPath(RetainedPath& path, float filterWidth) {
+
+    vgerStatTimer timer(stats.fillTime);
+
+    // Scan the path's own segments, leaving any path being built alone.
+    std::swap(path.segments, yScanner.segments);
+    path.prims.clear();
+    path.cvs.clear();
+    yScanner._init(filterWidth);
+    yScanner.scanPrims(pathTileWidth, filterWidth, path.prims, path.cvs);
+    std::swap(path.segments, yScanner.segments);
+
+    path.filterWidth = filterWidth;
+    stats.pathFillSlabs += yScanner.slabCount;
+}
+
+float vger::filterWidth() {
+
+    // As fwidth gives for local coordinates in the fragment function.
+    auto inv = affineInverse(txStack.back());
+    auto fw = length(abs(inv.columns[0]) + abs(inv.columns[1])) / devicePxRatio;
+
+    // Nothing is visible under a degenerate transform.
+    return isfinite(fw) ? fw : 1;
+}
+
+void vger::fillPath(vgerPathIndex path, vgerPaintIndex paint) {
+
+    if(path.index == 0 or path.index >= retainedPaths.size() or !checkPaint(paint)) {
+        return;
+    }
+
+    auto& info = retainedPaths[path.index];
+
+    // Filled smaller than when scanned, so pixels reach further.
+    float fw = filterWidth();
+    if(fw > info.filterWidth and info.segments.size()) {
+        scanPath(info, fw);
+    }
+
+    if(info.prims.size()) {
+        addPathPrims(info.prims, info.cvs, paint, currentXform());
+    }
+}
+
+void vger::deletePath(vgerPathIndex path) {
+
+    if(path.index == 0 or path.index >= retainedPaths.size()) {
+        return;
+    }
+
+    auto& info = retainedPaths[path.index];
+    if(info.freed) {
+        return;
+    }
+
+    info.prims = {};
+    info.cvs = {};
+    info.segments = {};
+    info.freed = true;
+    freePaths.push_back(path.index);
+}
+
+void vger::fillForTile(vgerPaintIndex paint) {
+
+    if(checkPaint(paint) and yScanner.segments.size()) {
+
+        tileFills.push_back({paint, txStack.back(), int(tileFillCVs.size() / 3), int(yScanner.segments.size())});
+
+        for(auto& seg : yScanner.segments) {
             for(int i=0;i<3;++i) {
-                auto p = yScanner.segments[a].cvs[i];
-                addCV(p);
-                xInt.a = std::min(xInt.a, p.x);
-                xInt.b = std::max(xInt.b, p.x);
+                tileFillCVs.push_back(seg.cvs[i]);
             }
-
         }
+    }
 
-        BBox bounds;
-        bounds.min.x = xInt.a;
-        bounds.max.x = xInt.b;
-        bounds.min.y = yScanner.interval.a;
-        bounds.max.y = yScanner.interval.b;
+    yScanner.segments.clear();
+}
 
-        // Calculate the prim vertices at this stage,
-        // as we do for glyphs.
-        prim.quadBounds[0] = prim.texBounds[0] = bounds.min;
-        prim.quadBounds[1] = prim.texBounds[1] = bounds.max;
+void vger::encodeTileRender(id<MTLCommandBuffer> buf, id<MTLTexture> renderTexture) {
 
-        addPrim(prim);
+    assert(renderTexture.pixelFormat == MTLPixelFormatRGBA8Unorm or
+           renderTexture.pixelFormat == MTLPixelFormatBGRA8Unorm);
 
-        // Bad fill.
-        if (++fillPrimCount >= MaxFillPrims) {
-            yScanner = vgerPathScanner();
-            return false;
+    int w = int(renderTexture.width);
+    int h = int(renderTexture.height);
+    tileRasterizer.clear(w, h);
+
+    // Window coordinates (y up) to pixels (y down).
+    float2 scale = float2{float(w), float(h)} / windowSize;
+    vgerAffine windowToPixel = {
+        float2{scale.x, 0},
+        float2{0, -scale.y},
+        float2{0, windowSize.y * scale.y}
+    };
+
+    auto& scene = scenes[currentScene];
+
+    for(auto& fill : tileFills) {
+        auto M = affineCompose(windowToPixel, fill.xform);
+        tilePixelCVs.clear();
+        for(int i=fill.start*3;i<(fill.start+fill.count)*3;++i) {
+            tilePixelCVs.push_back(affineApply(M, tileFillCVs[i]));
         }
+        tileRasterizer.addPath(tilePixelCVs.data(), fill.count, scene.paints.ptr[fill.paint.index], affineInverse(M));
     }
 
-    assert(yScanner.activeCount == 0);
+    tileRasterizer.render();
 
-    yScanner.segments.clear();
+    auto bytesPerRow = size_t(w) * 4;
+    auto& staging = tileStagingBuffers[currentScene];
+    if(staging == nil or staging.length < bytesPerRow * h) {
+        staging = [device newBufferWithLength:bytesPerRow * h options:MTLResourceStorageModeShared];
+        staging.label = @"tile staging buffer";
+    }
 
-    return true;
+    tileRasterizer.getPixels((uint8_t*) staging.contents, int(bytesPerRow),
+                             renderTexture.pixelFormat == MTLPixelFormatBGRA8Unorm);
+
+    auto blit = [buf blitCommandEncoder];
+    blit.label = @"tile render";
+    [blit copyFromBuffer:staging
+            sourceOffset:0
+       sourceBytesPerRow:bytesPerRow
+     sourceBytesPerImage:bytesPerRow * h
+              sourceSize:MTLSizeMake(w, h, 1)
+               toTexture:renderTexture
+        destinationSlice:0
+        destinationLevel:0
+       destinationOrigin:MTLOriginMake(0, 0, 0)];
+    [blit endEncoding];
+
+    // Update the debug texture.
+    int tw = tileRasterizer.tilesX, th = tileRasterizer.tilesY;
+    if(coarseDebugTexture == nil or coarseDebugTexture.width != tw or coarseDebugTexture.height != th) {
+        auto desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatR8Unorm width:tw height:th mipmapped:NO];
+        coarseDebugTexture = [device newTextureWithDescriptor:desc];
+        coarseDebugTexture.label = @"coarse debug texture";
+    }
+
+    tileCounts.resize(tileRasterizer.tileSegmentCounts.size());
+    for(size_t i=0;i<tileCounts.size();++i) {
+        tileCounts[i] = uint8_t(std::min(tileRasterizer.tileSegmentCounts[i], 255u));
+    }
+    [coarseDebugTexture replaceRegion:MTLRegionMake2D(0, 0, tw, th) mipmapLevel:0 withBytes:tileCounts.data() bytesPerRow:tw];
 }
 
 void vgerMoveTo(vgerContext vg, float2 pt) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpMoveTo, pt);
+
     vg->pen = pt;
 }
 
 void vgerLineTo(vgerContext vg, vector_float2 b) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpLineTo, b);
+
     vgerQuadTo(vg, (vg->pen + b)/2, b);
 }
 
 void vgerQuadTo(vgerContext vg, float2 b, float2 c) {
-    constexpr size_t MaxSegments = 1024;
-    if (vg->yScanner.segments.size() < MaxSegments) {
-        vg->yScanner.segments.push_back({vg->pen, b, c});
-    }
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpQuadTo, b, c);
+
+    vg->yScanner.segments.push_back({vg->pen, b, c});
     vg->pen = c;
 }
 
 void vgerCubicApproxTo(vgerContext vg, float2 b, float2 c, float2 d) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpCubicApproxTo, b, c, d);
+
     float2 cubic[4] = {vg->pen, b, c, d};
     float2 q[6];
     approx_cubic(cubic, q);
@@ -916,11 +1112,92 @@ void vgerCubicApproxTo(vgerContext vg, float2 b, float2 c, float2 d) {
     vgerQuadTo(vg, q[4], q[5]);
 }
 
+void vgerCubicTo(vgerContext vg, float2 b, float2 c, float2 d) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpCubicTo, b, c, d);
+
+    // The path is in local coordinates, so convert the tolerance.
+    auto scale = averageScale(vg->txStack.back()) * vg->devicePxRatio;
+    auto tolerance = vg->cubicTolerance / std::max(scale, 1e-6f);
+
+    float2 cubic[4] = {vg->pen, b, c, d};
+    approx_cubic_adaptive(cubic, tolerance, [vg](float2 q, float2 end) {
+        vgerQuadTo(vg, q, end);
+    });
+}
+
+void vgerSetCubicTolerance(vgerContext vg, float tolerance) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpSetCubicTolerance, tolerance);
+
+    vg->cubicTolerance = tolerance;
+}
+
 bool vgerFill(vgerContext vg, vgerPaintIndex paint) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpFill, paint);
+
     return vg->fill(paint);
 }
 
+void vgerFillForTile(vgerContext vg, vgerPaintIndex paint) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpFillForTile, paint);
+
+    vg->fillForTile(paint);
+}
+
+void vgerEncodeTileRender(vgerContext vg, id<MTLCommandBuffer> buf, id<MTLTexture> renderTexture) {
+    vg->encodeTileRender(buf, renderTexture);
+}
+
+void vgerSetSDFGlyphs(vgerContext vg, bool sdf) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpSetSDFGlyphs, sdf);
+
+    vg->sdfGlyphs = sdf;
+}
+
+void vgerSetGlyphRasterMode(vgerContext vg, vgerGlyphRasterMode mode) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpSetGlyphRasterMode, int(mode));
+
+    vg->glyphRasterMode = mode;
+    vg->setupGlyphCache();
+}
+
+void vgerSetPathTileWidth(vgerContext vg, float width) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpSetPathTileWidth, width);
+
+    vg->pathTileWidth = std::max(width, 0.0f);
+}
+
+vgerPathIndex vgerCreatePath(vgerContext vg) {
+    vgerRecordScope scope(vg);
+    auto path = vg->createPath();
+    scope.record(vgerOpCreatePath, path);
+    return path;
+}
+
+void vgerFillPath(vgerContext vg, vgerPathIndex path, vgerPaintIndex paint) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpFillPath, path, paint);
+
+    vg->fillPath(path, paint);
+}
+
+void vgerDeletePath(vgerContext vg, vgerPathIndex path) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpDeletePath, path);
+
+    vg->deletePath(path);
+}
+
 void vgerCancelPath(vgerContext vg) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpCancelPath);
+
     vg->yScanner.segments.clear();
 }
 
@@ -952,20 +1229,35 @@ void vger::encode(id<MTLCommandBuffer> buf, MTLRenderPassDescriptor* pass, bool
 
 void vger::encodeLayer(id<MTLCommandBuffer> buf, MTLRenderPassDescriptor* pass, int layer, bool glow) {
 
+    VGER_TRACE_ZONE("vger::encodeLayer");
+    vgerStatTimer timer(stats.encodeTime);
+
     [glyphCache update:buf];
+    stats.glyphEvictions += glyphCache.evictedCount;
 
     auto glyphRects = [glyphCache getRects];
     auto& scene = scenes[currentScene];
     auto count = scene.prims[layer].count;
 
     if(!computedGlyphBounds[layer]) {
-        auto primp = scene.prims[layer].ptr;
-        for(int i=0;i<count;++i) {
-            auto& prim = primp[i];
-            if(prim.type == vgerGlyph) {
-                auto r = glyphRects[prim.glyph-1];
-                for(int i=0;i<2;++i) {
-                    prim.texBounds[i] += float2{float(r.x), float(r.y)};
+        for(auto& chunk : scene.prims[layer].chunks) {
+            for(size_t i=0;i<chunk.count;++i) {
+                auto& prim = chunk.ptr[i];
+                if(primType(prim) == vgerGlyph) {
+                    // Replace the region index with the texture origin
+                    // and page.
+                    auto region = prim.data[4] & 0xffff;
+                    auto originY = prim.data[4] >> 16;
+                    auto r = glyphRects[region-1];
+                    prim.data[4] = uint32_t(GLYPH_MARGIN + r.x) | uint32_t(r.id) << 12 | uint32_t(originY + r.y) << 16;
+
+                    // Glyphs still rasterizing (or which didn't fit) have
+                    // empty rects. Collapse their quads so they're blank.
+                    if(r.w == 0) {
+                        prim.data[2] = prim.data[0];
+                        prim.data[3] = prim.data[1];
+                        stats.glyphPlaceholders++;
+                    }
                 }
             }
         }
@@ -973,6 +1265,14 @@ void vger::encodeLayer(id<MTLCommandBuffer> buf, MTLRenderPassDescriptor* pass,
         computedGlyphBounds[layer] = true;
     }
 
+    stats.cvs = uint32_t(scene.cvs.count);
+    stats.xforms = uint32_t(scene.xforms.count);
+    stats.paints = uint32_t(scene.paints.count);
+    stats.glyphAtlasUsage = glyphCache.usage;
+    stats.glyphAtlasPages = glyphCache.pageCount;
+    stats.bufferReallocations = uint32_t(scene.allocations());
+    stats.dropped = uint32_t(scene.dropped());
+
     [(glow ? glowRenderer : renderer) encodeTo:buf
                                           pass:pass
                                          scene:scene
@@ -988,6 +1288,81 @@ void vgerEncodeGlowPass(vgerContext vg, id<MTLCommandBuffer> buf, MTLRenderPassD
     vg->encode(buf, pass, true);
 }
 
+bool vgerSaveScene(vgerContext vg, const char* path) {
+    return vgerWriteSceneFile(vg->scenes[vg->currentScene], vg->layerCount, path);
+}
+
+vgerStaticSceneIndex vgerLoadScene(vgerContext vg, const char* path) {
+
+    vgerStaticScene scene;
+    if(!vgerMapSceneFile(vg->device, path, scene)) {
+        return {0};
+    }
+
+    if(vg->staticScenes.empty()) {
+        vg->staticScenes.emplace_back();
+    }
+
+    uint32_t index;
+    if(vg->freeStaticScenes.size()) {
+        index = vg->freeStaticScenes.back();
+        vg->freeStaticScenes.pop_back();
+    } else {
+        index = uint32_t(vg->staticScenes.size());
+        vg->staticScenes.emplace_back();
+    }
+
+    vg->staticScenes[index] = scene;
+    return {index};
+}
+
+void vgerDeleteStaticScene(vgerContext vg, vgerStaticSceneIndex scene) {
+    if(scene.index == 0 or scene.index >= vg->staticScenes.size()) {
+        return;
+    }
+
+    // Releases the buffers, and with them the mapping.
+    vg->staticScenes[scene.index] = vgerStaticScene();
+    vg->freeStaticScenes.push_back(scene.index);
+}
+
+void vgerEncodeStaticScene(vgerContext vg, vgerStaticSceneIndex scene, id<MTLCommandBuffer> buf, MTLRenderPassDescriptor* pass) {
+    if(scene.index == 0 or scene.index >= vg->staticScenes.size()) {
+        return;
+    }
+
+    auto& s = vg->staticScenes[scene.index];
+    for(int layer = 0; layer < s.layerCount; ++layer) {
+        if(layer) {
+            pass.colorAttachments[0].loadAction = MTLLoadActionLoad;
+        }
+
+        [vg->renderer encodeTo:buf
+                          pass:pass
+                         scene:s.scene
+                         count:int(s.scene.prims[layer].count)
+                         layer:layer
+                      textures:vg->textures
+                  glyphTexture:[vg->glyphCache getAltas]
+                    windowSize:vg->windowSize
+                          glow:false];
+    }
+}
+
+void vgerRenderCPU(vgerContext vg, uint8_t* rgba, int width, int height, int bytesPerRow) {
+    assert(vg);
+    assert(rgba);
+
+    vgerCPURenderer cpu;
+    cpu.clear(width, height);
+
+    for(int layer = 0; layer < vg->layerCount; ++layer) {
+        cpu.render(vg->scenes[vg->currentScene], layer, vg->windowSize);
+    }
+
+    cpu.getPixels(rgba, bytesPerRow);
+}
+
 static bool isValid(float x) {
     return !(isnan(x) || isinf(x));
 }
@@ -1004,26 +1379,27 @@ static bool isValid(float4 v) {
     return isValid(v.xyz) && isValid(v.w);
 }
 
-static bool isValid(matrix_float3x3 M) {
+static bool isValid(const vgerAffine& M) {
     return isValid(M.columns[0]) &&
            isValid(M.columns[1]) &&
            isValid(M.columns[2]);
 }
 
 void vgerTranslate(vgerContext vg, float2 t) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpTranslate, t);
+
     if(!isValid(t)) {
         fprintf(stderr, "vgerTranslate: bad translation: (%f, %f)\n", t.x, t.y);
         return;
     }
-    auto M = matrix_identity_float3x3;
-    M.columns[2] = vector3(t, 1);
-
     assert(!vg->txStack.empty());
     auto A = vg->txStack.back();
-    A = matrix_multiply(A, M);
+    A.columns[2] = affineApply(A, t);
 
     if(isValid(A)) {
         vg->txStack.back() = A;
+        vg->xformIndex = vger::NoXform;
     } else {
         fprintf(stderr, "vgerTranslate: translation of: (%f, %f) cannot be concatenated with current transformation matrix\n", t.x, t.y);
     }
@@ -1031,58 +1407,66 @@ void vgerTranslate(vgerContext vg, float2 t) {
 
 /// Scales current coordinate system.
 void vgerScale(vgerContext vg, float2 s) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpScale, s);
+
     if(!isValid(s)) {
         fprintf(stderr, "vgerScale: bad scale: (%f, %f)\n", s.x, s.y);
         return;
     }
-    auto M = matrix_identity_float3x3;
-    M.columns[0].x = s.x;
-    M.columns[1].y = s.y;
-
     assert(!vg->txStack.empty());
     auto A = vg->txStack.back();
-    A = matrix_multiply(A, M);
+    A.columns[0] *= s.x;
+    A.columns[1] *= s.y;
 
     if(isValid(A)) {
         vg->txStack.back() = A;
+        vg->xformIndex = vger::NoXform;
     } else {
         fprintf(stderr, "vgerScale: scale of: (%f, %f) cannot be concatenated with current transformation matrix\n", s.x, s.y);
     }
 }
 
 void vgerRotate(vgerContext vg, float theta) {
-    auto M = matrix_identity_float3x3;
-    M.columns[0].x = cosf(theta);
-    M.columns[0].y = sinf(theta);
-    M.columns[1].x = - M.columns[0].y;
-    M.columns[1].y = M.columns[0].x;
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpRotate, theta);
+
+    float c = cosf(theta), s = sinf(theta);
 
     auto& A = vg->txStack.back();
-    A = matrix_multiply(A, M);
+    auto c0 = A.columns[0], c1 = A.columns[1];
+    A.columns[0] = c * c0 + s * c1;
+    A.columns[1] = c * c1 - s * c0;
+    vg->xformIndex = vger::NoXform;
 }
 
 /// Transforms a point according to the current transformation.
 float2 vgerTransform(vgerContext vg, float2 p) {
-    auto& M = vg->txStack.back();
-    auto q = matrix_multiply(M, float3{p.x,p.y,1.0});
-    return {q.x/q.z, q.y/q.z};
+    return affineApply(vg->txStack.back(), p);
 }
 
 simd_float3x2 vgerCurrentTransform(vgerContext vg) {
-    auto& M = vg->txStack.back();
-    return {
-        M.columns[0].xy, M.columns[1].xy, M.columns[2].xy
-    };
+    return vg->txStack.back();
 }
 
 void vgerSave(vgerContext vg) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpSave);
+
     assert(!vg->txStack.empty());
     vg->txStack.push_back(vg->txStack.back());
+    vg->xformIndexStack.push_back(vg->xformIndex);
 }
 
 void vgerRestore(vgerContext vg) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpRestore);
+
     vg->txStack.pop_back();
     assert(!vg->txStack.empty());
+    assert(!vg->xformIndexStack.empty());
+    vg->xformIndex = vg->xformIndexStack.back();
+    vg->xformIndexStack.pop_back();
 }
 
 size_t vgerStackDepth(vgerContext vg) {
@@ -1090,12 +1474,18 @@ size_t vgerStackDepth(vgerContext vg) {
 }
 
 void vgerSetLayerCount(vgerContext vg, int layerCount) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpSetLayerCount, layerCount);
+
     assert(layerCount > 0);
     assert(layerCount <= VGER_MAX_LAYERS);
     vg->layerCount = layerCount;
 }
 
 void vgerSetLayer(vgerContext vg, int layer) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpSetLayer, layer);
+
     assert(layer < VGER_MAX_LAYERS);
     assert(layer >= 0);
     vg->currentLayer = layer;
@@ -1105,17 +1495,99 @@ id<MTLTexture> vgerGetGlyphAtlas(vgerContext vg) {
     return [vg->glyphCache getAltas];
 }
 
+id<MTLTexture> vgerGetCoarseDebugTexture(vgerContext vg) {
+    return vg->coarseDebugTexture;
+}
+
+vgerPaintIndex vger::retainPaint(vgerPaintIndex paint) {
+
+    auto& paints = scenes[currentScene].paints;
+    auto value = paints.ptr[paint.index];
+
+    // Free slots past the reserved ones hold this frame's paints until the
+    // next begin.
+    auto freeSlot = std::find_if(freePaints.begin(), freePaints.end(),
+                                 [&](uint32_t slot) { return slot < retainedPaintSlots; });
+
+    uint32_t slot;
+    if(freeSlot != freePaints.end()) {
+        slot = *freeSlot;
+        freePaints.erase(freeSlot);
+    } else if(retainedPaints.size() < retainedPaintSlots or paints.count == retainedPaintSlots) {
+        slot = uint32_t(retainedPaints.size());
+    } else {
+        // The reserved slots are full and this frame's paints follow them,
+        // so take the slot after this frame's paints. begin reserves up to
+        // it from the next frame, and frees the slots in between.
+        slot = uint32_t(paints.count);
+        for(auto i = uint32_t(retainedPaints.size()); i < slot; ++i) {
+            freePaints.push_back(i);
+        }
+    }
+
+    if(slot >= retainedPaints.size()) {
+        retainedPaints.resize(slot + 1);
+        paintFreed.resize(slot + 1, true);
+    }
+    retainedPaints[slot] = value;
+    paintFreed[slot] = false;
+
+    if(slot < retainedPaintSlots) {
+        paints.ptr[slot] = value;
+    } else {
+        assert(slot == paints.count);
+        paints.append(value);
+        if(slot == retainedPaintSlots) {
+            // No paints added yet this frame, so we can grow the reserved slots.
+            retainedPaintSlots++;
+        }
+    }
+
+    return {slot};
+}
+
+void vger::releasePaint(vgerPaintIndex paint) {
+
+    // Releasing twice, or releasing a paint which wasn't retained, would
+    // let two retained paints share a slot.
+    if(!isRetainedPaint(paint)) {
+        return;
+    }
+
+    paintFreed[paint.index] = true;
+    freePaints.push_back(paint.index);
+}
+
+vgerPaintIndex vgerRetainPaint(vgerContext vg, vgerPaintIndex paint) {
+    vgerRecordScope scope(vg);
+    assert(vg->checkPaint(paint));
+    auto result = vg->retainPaint(paint);
+    scope.record(vgerOpRetainPaint, paint, result);
+    return result;
+}
+
+void vgerReleasePaint(vgerContext vg, vgerPaintIndex paint) {
+    vgerRecordScope scope(vg);
+    scope.record(vgerOpReleasePaint, paint);
+
+    vg->releasePaint(paint);
+}
+
 vgerPaintIndex vgerColorPaint(vgerContext vg, float4 color) {
 
-    vgerPaint p;
+    vgerRecordScope scope(vg);
+
+    vgerPaint p = {};
     p.type = vgerPaintTypeLinearGradient;
-    p.xform = matrix_identity_float3x3;
+    p.xform = affineIdentity();
     p.innerColor = color;
     p.outerColor = color;
     p.image = -1;
     p.glow = 0;
 
-    return vg->addPaint(p);
+    auto result = vg->addPaint(p);
+    scope.record(vgerOpColorPaint, color, result);
+    return result;
 }
 
 vgerPaintIndex vgerLinearGradient(vgerContext vg,
@@ -1125,7 +1597,10 @@ vgerPaintIndex vgerLinearGradient(vgerContext vg,
                                   float4 outerColor,
                                   float glow) {
 
-    return vg->addPaint(makeLinearGradient(start, end, innerColor, outerColor, glow));
+    vgerRecordScope scope(vg);
+    auto result = vg->addPaint(makeLinearGradient(start, end, innerColor, outerColor, glow));
+    scope.record(vgerOpLinearGradient, start, end, innerColor, outerColor, glow, result);
+    return result;
 
 }
 
@@ -1136,7 +1611,10 @@ vgerPaintIndex vgerRadialGradient(vgerContext vg,
                                   vector_float4 innerColor,
                                   vector_float4 outerColor,
                                   float glow) {
-    return vg->addPaint(makeRadialGradient(center, innerRadius, outerRadius, innerColor, outerColor, glow));
+    vgerRecordScope scope(vg);
+    auto result = vg->addPaint(makeRadialGradient(center, innerRadius, outerRadius, innerColor, outerColor, glow));
+    scope.record(vgerOpRadialGradient, center, innerRadius, outerRadius, innerColor, outerColor, glow, result);
+    return result;
 }
 
 vgerPaintIndex vgerImagePattern(vgerContext vg,
@@ -1145,22 +1623,29 @@ vgerPaintIndex vgerImagePattern(vgerContext vg,
                                 float angle,
                                 bool flipY,
                                 vgerImageIndex image, float alpha) {
+    vgerRecordScope scope(vg);
     assert(image.index < vg->textures.count);
-    return vg->addPaint(makeImagePattern(origin, size, angle, flipY, image, alpha));
+    auto result = vg->addPaint(makeImagePattern(origin, size, angle, flipY, image, alpha));
+    scope.record(vgerOpImagePattern, origin, size, angle, flipY, image, alpha, result);
+    return result;
 }
 
 vgerPaintIndex vgerGrid(vgerContext vg, vector_float2 origin, vector_float2 size,
                         float width, vector_float4 color) {
 
-    vgerPaint p;
+    vgerRecordScope scope(vg);
+
+    vgerPaint p = {};
     p.image = -2;
     p.innerColor = color;
     p.xform = {
-        float3{ 1/size.x, 0, 0},
-        float3{ 0, 1/size.y, 0},
-        float3{ -origin.x, -origin.y, 1}
+        float2{ 1/size.x, 0 },
+        float2{ 0, 1/size.y },
+        float2{ -origin.x, -origin.y }
     };
     p.glow = 0;
 
-    return vg->addPaint(p);
+    auto result = vg->addPaint(p);
+    scope.record(vgerOpGrid, origin, size, width, color, result);
+    return result;
 }
@@ -0,0 +1,358 @@
+//  Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#define VGER_MAX_LAYERS 4
+
+#include "prim.h"
+#include "compact_prim.h"
+#include "paint.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <sys/mman.h>
+
+/// Growable array of scene data. Storage decides where the bytes live, so
+/// scenes can be recorded without Metal. A Storage type provides:
+///
+///     void* contents() const;
+///     size_t length() const;
+///     Storage reallocate(size_t length) const; // new storage of the same kind
+///
+/// reallocate returns storage with null contents on failure. Storage is
+/// copied along with the vector, so it should be reference counted.
+///
+/// Growing copies the contents, so use reserve when the size is known.
+/// Elements which don't fit are counted in dropped.
+template<class T, class Storage>
+struct vgerVec {
+    Storage storage;
+    T* ptr = nullptr;
+    size_t count = 0;
+    size_t capacity = 0;
+
+    /// Elements which didn't fit since the last clear.
+    size_t dropped = 0;
+
+    /// Buffers allocated since the last clear.
+    size_t allocations = 0;
+
+    static constexpr size_t InitialCapacity = 1024;
+    static constexpr size_t MaxBufferSizeBytes = 1024 * 1024 * 256;
+
+    vgerVec() { }
+
+    /// Uses storage holding count elements, or allocates from it if it's
+    /// empty.
+    explicit vgerVec(const Storage& storage, size_t count = 0)
+    : storage(storage), count(count) {
+        if(storage.contents()) {
+            ptr = static_cast<T*>(storage.contents());
+            capacity = storage.length() / sizeof(T);
+        } else {
+            allocate(InitialCapacity);
+        }
+    }
+
+    void allocate(size_t cap) {
+        auto newStorage = storage.reallocate(cap * sizeof(T));
+        if(!newStorage.contents()) {
+            return;
+        }
+        if(count) {
+            memcpy(newStorage.contents(), ptr, count * sizeof(T));
+        }
+        storage = newStorage;
+        ptr = static_cast<T*>(storage.contents());
+        capacity = cap;
+        ++allocations;
+    }
+
+    void append(const T& value) {
+
+        if(count >= capacity && std::max(capacity*2, InitialCapacity)*sizeof(T) <= MaxBufferSizeBytes) {
+            allocate(std::max(capacity*2, InitialCapacity));
+        }
+
+        if(count < capacity) {
+            ptr[count++] = value;
+        } else {
+            ++dropped;
+        }
+    }
+
+    void append(const T* values, size_t n) {
+
+        auto needed = count + n;
+        if(needed > capacity) {
+            auto cap = std::max(capacity, InitialCapacity);
+            while(cap < needed && cap*2*sizeof(T) <= MaxBufferSizeBytes) {
+                cap *= 2;
+            }
+            if(cap != capacity) {
+                allocate(cap);
+            }
+        }
+
+        auto m = std::min(n, capacity - count);
+        if(m) {
+            memcpy(ptr + count, values, m * sizeof(T));
+            count += m;
+        }
+        dropped += n - m;
+    }
+
+    /// Makes room for n elements.
+    void reserve(size_t n) {
+        n = std::min(n, MaxBufferSizeBytes / sizeof(T));
+        if(n > capacity) {
+            allocate(n);
+        }
+    }
+
+    void clear() {
+        count = 0;
+        dropped = 0;
+        allocations = 0;
+    }
+};
+
+/// Growable array stored in chunks, so growing never copies. Each chunk is
+/// a full vgerVec, so it can be bound as a single buffer. clear merges the
+/// chunks into one with the combined capacity, so once a frame's size is
+/// known, later frames use a single chunk.
+template<class T, class Storage>
+struct vgerChunkedVec {
+    typedef vgerVec<T, Storage> Chunk;
+
+    /// Prototype for allocating chunks.
+    Storage storage;
+
+    std::vector<Chunk> chunks;
+    size_t count = 0;
+
+    /// Elements which didn't fit since the last clear.
+    size_t dropped = 0;
+
+    /// Chunks allocated since the last clear.
+    size_t allocations = 0;
+
+    vgerChunkedVec() { }
+
+    /// Allocates chunks from storage when needed.
+    explicit vgerChunkedVec(const Storage& storage) : storage(storage) { }
+
+    /// Uses an existing chunk.
+    explicit vgerChunkedVec(const Chunk& chunk)
+    : storage(chunk.storage), chunks{chunk}, count(chunk.count) { }
+
+    size_t capacity() const {
+        size_t cap = 0;
+        for(auto& chunk : chunks) {
+            cap += chunk.capacity;
+        }
+        return cap;
+    }
+
+    void append(const T& value) {
+        if(chunks.empty() or chunks.back().count == chunks.back().capacity) {
+            if(!addChunk(capacity())) {
+                ++dropped;
+                return;
+            }
+        }
+        auto& chunk = chunks.back();
+        chunk.ptr[chunk.count++] = value;
+        ++count;
+    }
+
+    /// Walks the chunks, so prefer iterating chunks in loops.
+    T& operator[](size_t i) {
+        for(auto& chunk : chunks) {
+            if(i < chunk.count) {
+                return chunk.ptr[i];
+            }
+            i -= chunk.count;
+        }
+        assert(false);
+        return chunks.back().ptr[0];
+    }
+
+    /// Makes room for n elements in a single chunk. Only takes effect when
+    /// empty, to avoid copying.
+    void reserve(size_t n) {
+        if(count == 0 and (chunks.empty() or chunks.front().capacity < n)) {
+            chunks.clear();
+            addChunk(n);
+        }
+    }
+
+    void clear() {
+        auto cap = capacity();
+        if(chunks.size() > 1) {
+            chunks.clear();
+            addChunk(cap);
+        }
+        for(auto& chunk : chunks) {
+            chunk.clear();
+        }
+        count = 0;
+        dropped = 0;
+        allocations = 0;
+    }
+
+private:
+
+    bool addChunk(size_t cap) {
+        cap = std::clamp(cap, Chunk::InitialCapacity, Chunk::MaxBufferSizeBytes / sizeof(T));
+        Chunk chunk;
+        chunk.storage = storage;
+        chunk.allocate(cap);
+        if(chunk.capacity == 0) {
+            return false;
+        }
+        chunks.push_back(chunk);
+        ++allocations;
+        return true;
+    }
+};
+
+/// Page aligned heap memory, for recording scenes without a GPU.
+struct vgerHeapStorage {
+    std::shared_ptr<void> data;
+    size_t size = 0;
+
+    /// Matches the page size on Apple silicon.
+    static constexpr size_t Alignment = 16384;
+
+    /// Allocations at least this big ask for transparent huge pages, where
+    /// the OS supports them.
+    static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+    void* contents() const { return data.get(); }
+    size_t length() const { return size; }
+
+    vgerHeapStorage reallocate(size_t length) const {
+        length = (length + Alignment - 1) / Alignment * Alignment;
+        void* p = nullptr;
+        if(posix_memalign(&p, Alignment, length) != 0) {
+            return {};
+        }
+#ifdef MADV_HUGEPAGE
+        if(length >= HugePageSize) {
+            madvise(p, length, MADV_HUGEPAGE);
+        }
+#endif
+        return {std::shared_ptr<void>(p, free), length};
+    }
+};
+
+/// Element counts of a scene, used to size the next frame's buffers.
+struct vgerSceneSizes {
+    size_t prims[VGER_MAX_LAYERS] = {};
+    size_t cvs = 0;
+    size_t xforms = 0;
+    size_t paints = 0;
+};
+
+/// Everything drawn in a frame, independent of where it's stored.
+///
+/// Prims are chunked. cvs, xforms and paints are indexed by prims, so
+/// they're contiguous.
+template<class Storage>
+struct vgerBasicScene {
+    vgerChunkedVec<vgerCompactPrim, Storage> prims[VGER_MAX_LAYERS];
+    vgerVec<float2, Storage> cvs;
+    vgerVec<vgerAffine, Storage> xforms;
+    vgerVec<vgerPaint, Storage> paints;
+
+    /// Encodes a prim into a layer. Bezier cvs are moved to the cv buffer.
+    /// aux is the piece index for vgerRectStroke.
+    void addPrim(int layer, const vgerPrim& prim, uint32_t aux = 0) {
+        auto cvStart = uint32_t(cvs.count);
+        if(prim.type == vgerBezier) {
+            cvs.append(prim.cvs, 3);
+
+            // Without all its cvs, the prim would read past the buffer.
+            if(cvs.count != cvStart + 3) {
+                cvs.dropped += cvs.count - cvStart;
+                cvs.count = cvStart;
+                ++prims[layer].dropped;
+                return;
+            }
+        }
+        prims[layer].append(encodePrim(prim, cvStart, aux));
+    }
+
+    void clear() {
+        for(int layer=0;layer<VGER_MAX_LAYERS;++layer) {
+            prims[layer].clear();
+        }
+        cvs.clear();
+        xforms.clear();
+        paints.clear();
+    }
+
+    vgerSceneSizes sizes() const {
+        vgerSceneSizes s;
+        for(int layer=0;layer<VGER_MAX_LAYERS;++layer) {
+            s.prims[layer] = prims[layer].count;
+        }
+        s.cvs = cvs.count;
+        s.xforms = xforms.count;
+        s.paints = paints.count;
+        return s;
+    }
+
+    /// Makes room for a frame of the given size. Call after clear.
+    void reserve(const vgerSceneSizes& s) {
+        for(int layer=0;layer<VGER_MAX_LAYERS;++layer) {
+            prims[layer].reserve(s.prims[layer]);
+        }
+        cvs.reserve(s.cvs);
+        xforms.reserve(s.xforms);
+        paints.reserve(s.paints);
+    }
+
+    /// Buffers allocated since the last clear.
+    size_t allocations() const {
+        size_t n = cvs.allocations + xforms.allocations + paints.allocations;
+        for(int layer=0;layer<VGER_MAX_LAYERS;++layer) {
+            n += prims[layer].allocations;
+        }
+        return n;
+    }
+
+    /// Elements which didn't fit since the last clear.
+    size_t dropped() const {
+        size_t n = cvs.dropped + xforms.dropped + paints.dropped;
+        for(int layer=0;layer<VGER_MAX_LAYERS;++layer) {
+            n += prims[layer].dropped;
+        }
+        return n;
+    }
+
+    /// Average number of segments each pixel covered by a path fill prim
+    /// in a layer tests against. scale converts prim units to pixels.
+    double segmentTestsPerPixel(int layer, float scale) const {
+        double tests = 0, area = 0;
+        for(auto& chunk : prims[layer].chunks) {
+            for(size_t i=0;i<chunk.count;++i) {
+                // Only path fills decode without cvs.
+                if(primType(chunk.ptr[i]) == vgerPathFill) {
+                    auto prim = decodePrim(chunk.ptr[i], nullptr);
+                    auto sz = (prim.quadBounds[1] - prim.quadBounds[0]) * scale;
+                    tests += double(prim.count) * sz.x * sz.y;
+                    area += sz.x * sz.y;
+                }
+            }
+        }
+        return area > 0 ? tests / area : 0;
+    }
+};
+
+/// A scene which doesn't need Metal.
+typedef vgerBasicScene<vgerHeapStorage> vgerHeapScene;
@@ -0,0 +1,82 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include <vector>
+#include "vgerBasicScene.h"
+
+/// Pixels for the CPU renderer to read from. Glyph atlases are one byte per
+/// pixel (A8), images are four (RGBA8).
+struct vgerCPUTexture {
+    const uint8_t* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int bytesPerRow = 0;
+};
+
+/// One layer of a scene, as the CPU renderer reads it. Lets render take
+/// scenes with any storage without templating the rasterizer.
+struct vgerCPULayer {
+    struct Chunk {
+        const vgerCompactPrim* ptr;
+        size_t count;
+    };
+
+    std::vector<Chunk> prims;
+    size_t primCount = 0;
+    const float2* cvs = nullptr;
+    const vgerAffine* xforms = nullptr;
+    size_t xformCount = 0;
+    const vgerPaint* paints = nullptr;
+    size_t paintCount = 0;
+};
+
+/// Headless renderer which evaluates prims on the CPU the same way
+/// vger.metal does (same quad bounds, sdPrim, paints and AA). Useful
+/// for thumbnails and golden-image tests on machines without a GPU.
+struct vgerCPURenderer {
+
+    /// Color the target is cleared to by clear().
+    simd_float4 clearColor = {0,0,0,1};
+
+    /// Textures referenced by image paints, indexed by vgerImageIndex.
+    /// Prims with image paints missing from this list aren't drawn.
+    std::vector<vgerCPUTexture> textures;
+
+    /// Glyph atlas pages (A8). Glyph prims on missing pages aren't drawn.
+    std::vector<vgerCPUTexture> glyphPages;
+
+    /// Resize and clear the framebuffer.
+    void clear(int width, int height);
+
+    /// Render a layer of a scene into the framebuffer, blending over what's
+    /// already there. windowSize is the size passed to vgerBegin.
+    /// Works with vgerHeapScene, so it doesn't need a Metal device.
+    template<class Storage>
+    void render(const vgerBasicScene<Storage>& scene, int layer, simd_float2 windowSize) {
+        vgerCPULayer l;
+        for(auto& chunk : scene.prims[layer].chunks) {
+            l.prims.push_back({chunk.ptr, chunk.count});
+        }
+        l.primCount = scene.prims[layer].count;
+        l.cvs = scene.cvs.ptr;
+        l.xforms = scene.xforms.ptr;
+        l.xformCount = scene.xforms.count;
+        l.paints = scene.paints.ptr;
+        l.paintCount = scene.paints.count;
+        render(l, windowSize);
+    }
+
+    void render(const vgerCPULayer& layer, simd_float2 windowSize);
+
+    /// Copy the framebuffer out as RGBA8, top row first.
+    void getPixels(uint8_t* rgba, int bytesPerRow) const;
+
+    int width = 0;
+    int height = 0;
+
+    /// Linear RGBA, top row first. Kept in float so repeated blending
+    /// doesn't accumulate rounding.
+    std::vector<simd_float4> pixels;
+
+};
@@ -0,0 +1,107 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/// Point in a glyph outline.
+struct vgerFontPoint {
+    float x = 0;
+    float y = 0;
+};
+
+/// Quadratic segment of a glyph outline. Lines have their control point
+/// at the midpoint.
+struct vgerFontQuad {
+    vgerFontPoint cvs[3];
+};
+
+/// Glyph bounds, in font units, with y up.
+struct vgerGlyphBox {
+    int xMin = 0;
+    int yMin = 0;
+    int xMax = 0;
+    int yMax = 0;
+};
+
+/// Limits on the components and points of one glyph's outline, counting
+/// repeats. Real fonts need a few of each, so these only stop malformed
+/// composites from expanding exponentially.
+constexpr int vgerFontMaxComponents = 1024;
+constexpr int vgerFontMaxPoints = 65536;
+
+/// Reads glyph outlines from a TrueType font (glyf outlines only), without
+/// platform font APIs. Glyph indices are the same as CoreText's CGGlyph.
+///
+/// Malformed tables give empty outlines rather than reading out of bounds.
+struct vgerFont {
+
+    /// Copies the font data. Returns false if it isn't a TrueType font.
+    bool load(const void* data, size_t size);
+
+    /// Loads a font file.
+    bool loadFile(const char* path);
+
+    int unitsPerEm() const { return _unitsPerEm; }
+    int glyphCount() const { return _glyphCount; }
+
+    /// Glyph for a unicode code point, or 0 (the missing glyph).
+    uint32_t glyphIndex(uint32_t codepoint) const;
+
+    /// Horizontal advance, in font units.
+    int advance(uint32_t glyph) const;
+
+    /// Gets the bounds from the glyph's header. Returns false for glyphs
+    /// without outlines.
+    bool glyphBox(uint32_t glyph, vgerGlyphBox* box) const;
+
+    /// Appends the glyph's outline, in font units, to quads. Contours are
+    /// closed. Returns false for glyphs without outlines, and for
+    /// composites with more than vgerFontMaxComponents components or
+    /// vgerFontMaxPoints points in all, which append nothing.
+    bool glyphOutline(uint32_t glyph, std::vector<vgerFontQuad>& quads) const;
+
+private:
+
+    std::vector<uint8_t> _data;
+    int _unitsPerEm = 0;
+    int _glyphCount = 0;
+    int _longLocaFormat = 0;
+    int _hmetricCount = 0;
+
+    // Table offsets, or 0 if missing.
+    uint32_t _loca = 0, _glyf = 0, _hmtx = 0;
+    uint32_t _glyfLength = 0;
+
+    /// Offset of the best cmap subtable.
+    uint32_t _cmap = 0;
+
+    /// Work left for a glyph's outline. Components can be used many times
+    /// at each level of a composite, so depth alone doesn't bound it.
+    struct _Budget {
+        int components;
+        int points;
+    };
+
+    uint32_t _findTable(const char* tag, uint32_t* length = nullptr) const;
+    bool _glyphRange(uint32_t glyph, uint32_t* offset, uint32_t* length) const;
+    bool _outline(uint32_t glyph, const float m[6], int depth, _Budget& budget, std::vector<vgerFontQuad>& quads) const;
+
+    bool _has(uint32_t offset, uint32_t size) const {
+        return offset <= _data.size() and size <= _data.size() - offset;
+    }
+    uint8_t _u8(uint32_t offset) const {
+        return _has(offset, 1) ? _data[offset] : 0;
+    }
+    uint16_t _u16(uint32_t offset) const {
+        return _has(offset, 2) ? uint16_t(_data[offset] << 8 | _data[offset+1]) : 0;
+    }
+    int16_t _i16(uint32_t offset) const {
+        return int16_t(_u16(offset));
+    }
+    uint32_t _u32(uint32_t offset) const {
+        return uint32_t(_u16(offset)) << 16 | _u16(offset+2);
+    }
+};
@@ -11,8 +11,13 @@ NS_ASSUME_NONNULL_BEGIN
 
 #define GLYPH_MARGIN 4
 
+/// Scale distance field glyphs are generated at. Their spread is
+/// GLYPH_MARGIN texels.
+#define GLYPH_SDF_SCALE 4
+
 struct GlyphInfo {
     float size = 0.0;
+    bool sdf = false;
     int regionIndex = -1;
     int textureWidth = 0;
     int textureHeight = 0;
@@ -23,15 +28,54 @@ struct GlyphInfo {
 
 @property (nonatomic, readonly) float usage;
 
+/// Number of glyph images added to the atlas.
+@property (nonatomic, readonly) int count;
+
+/// Glyphs evicted by the last update. They're rasterized again if needed.
+@property (nonatomic, readonly) int evictedCount;
+
+/// Number of atlas pages.
+@property (nonatomic, readonly) int pageCount;
+
+/// Rasterize glyphs from the font's TrueType outlines with
+/// vgerGlyphRasterizer instead of CoreGraphics. Off by default.
+@property (nonatomic) bool portableRasterizer;
+
+/// Rasterize new glyphs on worker threads, in parallel. They're added to
+/// the atlas by update. Off by default.
+@property (nonatomic) bool async;
+
+/// Whether update waits for glyphs still rasterizing on worker threads.
+/// If not, their rects stay empty until a later update. On by default.
+@property (nonatomic) bool waitForGlyphs;
+
+/// Glyphs rasterizing on worker threads, which update hasn't added yet.
+@property (nonatomic, readonly) int pendingCount;
+
+/// Glyphs didn't fit in the atlas, even after evicting unused ones and
+/// adding pages.
+@property (nonatomic, readonly) bool full;
+
 - (instancetype)initWithDevice:(id<MTLDevice>) device;
 
 - (GlyphInfo) getGlyph:(CGGlyph)glyph scale:(float)scale;
 
+/// Gets a signed distance glyph, which can be drawn at any scale. It's
+/// generated from the outline once, at GLYPH_SDF_SCALE.
+- (GlyphInfo) getSDFGlyph:(CGGlyph)glyph;
+
 - (void) update:(id<MTLCommandBuffer>) buffer;
 
+/// Marks a glyph's region as used, for glyphs drawn without getGlyph.
+- (void) useRegion:(int)region;
+
+/// Starts a new frame. Glyphs unused for a frame may be evicted.
+- (void) beginFrame;
+
+/// A 2D texture array with a slice per page.
 - (id<MTLTexture>) getAltas;
 
-/// Get a pointer to the first rectangle.
+/// Get a pointer to the first rectangle. Each rect's id is its page.
 - (stbrp_rect*) getRects;
 
 - (CTFontRef) getFont;
@@ -2,15 +2,63 @@
 
 #import "vgerGlyphCache.h"
 #import "vgerTextureManager.h"
+#include "vgerPathScanner.h"
+#include "vgerFont.h"
+#include "vgerGlyphRasterizer.h"
+#include "vgerTrace.h"
+#include "sdf.h"
 #include <vector>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <atomic>
+
+/// Writes a glyph's image, a byte per pixel with rows top down. May run on
+/// a worker thread, so it only uses what it captures.
+typedef std::function<void(uint8_t* image)> RasterizeGlyph;
+
+/// A glyph being rasterized on a worker thread.
+struct PendingGlyph {
+    int region = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> image;
+    std::atomic<bool> ready{false};
+};
 
 @interface vgerGlyphCache() {
     vgerTextureManager* mgr;
     std::vector< std::vector<GlyphInfo> > glyphs;
     CTFontRef ctFont;
+
+    /// For converting outlines to segments for distance fields.
+    vgerPathScanner scan;
+
+    /// Glyph in each region, for eviction.
+    std::vector<CGGlyph> regionGlyphs;
+
+    /// For rasterizing without CoreGraphics.
+    vgerFont font;
+
+    /// Glyphs rasterizing asynchronously, in order.
+    std::vector< std::shared_ptr<PendingGlyph> > pending;
+    dispatch_group_t group;
+    dispatch_queue_t queue;
 }
 @end
 
+/// Creates the glyph's outline, translated so its bounds start at the
+/// origin. Returns null for glyphs without outlines.
+static CGPathRef createGlyphPath(CTFontRef ctFont, CGGlyph glyph, CGRect* boundingRect) {
+
+    CTFontGetBoundingRectsForGlyphs(ctFont, kCTFontOrientationHorizontal, &glyph, boundingRect, 1);
+
+    auto glyphTransform = CGAffineTransformMake(1, 0, 0, 1,
+                                                -boundingRect->origin.x,
+                                                -boundingRect->origin.y);
+    return CTFontCreatePathForGlyph(ctFont, glyph, &glyphTransform);
+}
+
 @implementation vgerGlyphCache
 
 - (instancetype) initWithDevice:(id<MTLDevice>)device {
@@ -26,17 +74,61 @@
         ctFont = CTFontCreateWithFontDescriptor( (CTFontDescriptorRef) CFArrayGetValueAtIndex(fd, 0), 12.0, nil);
         assert(ctFont);
         CFRelease(fd);
+
+        if(!font.loadFile(fontURL.fileSystemRepresentation)) {
+            NSLog(@"vgerGlyphCache: couldn't load %@ for the portable rasterizer", fontURL);
+        }
         //ctFont = CTFontCreateWithName((__bridge CFStringRef)@"Avenir-light", /*fontPointSize*/24, NULL);
+
+        group = dispatch_group_create();
+        queue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+        _waitForGlyphs = true;
     }
     return self;
 }
 
 - (void) dealloc {
+    // Workers use the font.
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
     CFRelease(ctFont);
 }
 
+/// Adds a glyph's image to the atlas, rasterizing it now, or on a worker
+/// thread if async is set. Returns the region.
+- (int) addGlyph:(CGGlyph)glyph width:(int)width height:(int)height rasterize:(const RasterizeGlyph&)rasterize {
+
+    int region;
+
+    if(_async) {
+        region = [mgr reserveRegion];
+
+        auto p = std::make_shared<PendingGlyph>();
+        p->region = region;
+        p->width = width;
+        p->height = height;
+        p->image.resize(width*height);
+        pending.push_back(p);
+
+        RasterizeGlyph fn = rasterize;
+        dispatch_group_async(group, queue, ^{
+            fn(p->image.data());
+            p->ready.store(true, std::memory_order_release);
+        });
+    } else {
+        std::vector<uint8_t> image(width*height);
+        rasterize(image.data());
+        region = [mgr addRegion:image.data() width:width height:height bytesPerRow:width];
+    }
+
+    _count++;
+    [self setGlyph:glyph forRegion:region];
+    return region;
+}
+
 - (GlyphInfo) getGlyph:(CGGlyph)glyph scale:(float) scale {
 
+    VGER_TRACE_ZONE("vgerGlyphCache getGlyph");
+
     if(glyph >= glyphs.size()) {
         glyphs.resize(glyph+1);
     }
@@ -44,19 +136,19 @@
     auto& v = glyphs[glyph];
 
     for(auto& info : v) {
-        if(info.size == scale) {
+        if(!info.sdf and info.size == scale) {
+            [mgr useRegion:info.regionIndex];
             return info;
         }
     }
 
+    if(_portableRasterizer) {
+        return [self addPortableGlyph:glyph scale:scale];
+    }
+
     // Render the glyph with CoreText.
     CGRect boundingRect;
-    CTFontGetBoundingRectsForGlyphs(ctFont, kCTFontOrientationHorizontal, &glyph, &boundingRect, 1);
-
-    auto glyphTransform = CGAffineTransformMake(1, 0, 0, 1,
-                                                -boundingRect.origin.x,
-                                                -boundingRect.origin.y);
-    auto path = CTFontCreatePathForGlyph(ctFont, glyph, &glyphTransform);
+    auto path = createGlyphPath(ctFont, glyph, &boundingRect);
 
     if(path == 0) {
         //NSLog(@"no path for glyph index %d\n", (int)glyph);
@@ -71,35 +163,40 @@
 
     //NSLog(@"glyph size: %d %d\n", width, height);
 
-    std::vector<uint8_t> imageData(width*height);
+    // Paths are immutable, so workers can use them.
+    auto sharedPath = std::shared_ptr<const CGPath>(path, CGPathRelease);
+
+    auto region = [self addGlyph:glyph width:width height:height rasterize:[=](uint8_t* imageData) {
 
-    auto colorSpace = CGColorSpaceCreateDeviceGray();
-    auto bitmapInfo = (kCGBitmapAlphaInfoMask & kCGImageAlphaNone);
-    auto context = CGBitmapContextCreate(imageData.data(),
-                                                 width,
-                                                 height,
-                                                 8,
-                                                 width,
-                                                 colorSpace,
-                                                 bitmapInfo);
+        auto colorSpace = CGColorSpaceCreateDeviceGray();
+        auto bitmapInfo = (kCGBitmapAlphaInfoMask & kCGImageAlphaNone);
+        auto context = CGBitmapContextCreate(imageData,
+                                             width,
+                                             height,
+                                             8,
+                                             width,
+                                             colorSpace,
+                                             bitmapInfo);
 
-    CGContextTranslateCTM(context, GLYPH_MARGIN, GLYPH_MARGIN);
-    CGContextScaleCTM(context, scale, scale);
+        CGContextTranslateCTM(context, GLYPH_MARGIN, GLYPH_MARGIN);
+        CGContextScaleCTM(context, scale, scale);
 
-    // Fill the context with an opaque black color
-    CGContextSetRGBFillColor(context, 0, 0, 0, 1);
-    CGContextFillRect(context, CGRectMake(0, 0, width, height));
+        // Fill the context with an opaque black color
+        CGContextSetRGBFillColor(context, 0, 0, 0, 1);
+        CGContextFillRect(context, CGRectMake(0, 0, width, height));
 
-    // Set fill color so that glyphs are solid white
-    CGContextSetRGBFillColor(context, 1, 1, 1, 1);
+        // Set fill color so that glyphs are solid white
+        CGContextSetRGBFillColor(context, 1, 1, 1, 1);
 
-    CGContextAddPath(context, path);
-    CGContextFillPath(context);
-    
-    //CGPoint p = {-boundingRect.origin.x, -boundingRect.origin.y};
-    //CTFontDrawGlyphs(ctFont, &glyph, &p, 1, context);
+        CGContextAddPath(context, sharedPath.get());
+        CGContextFillPath(context);
 
-    auto region = [mgr addRegion:imageData.data() width:width height:height bytesPerRow:width];
+        //CGPoint p = {-boundingRect.origin.x, -boundingRect.origin.y};
+        //CTFontDrawGlyphs(ctFont, &glyph, &p, 1, context);
+
+        CGContextRelease(context);
+        CGColorSpaceRelease(colorSpace);
+    }];
 
     GlyphInfo info = {
         .size=scale,
@@ -111,16 +208,206 @@
 
     v.push_back(info);
 
+    return info;
+
+}
+
+/// Rasterizes a glyph from the font's outline with vgerGlyphRasterizer,
+/// with the same bounds and placement as CoreGraphics.
+- (GlyphInfo) addPortableGlyph:(CGGlyph)glyph scale:(float)scale {
+
+    vgerGlyphBox box;
+    std::vector<vgerFontQuad> quads;
+    if(!font.glyphBox(glyph, &box) or !font.glyphOutline(glyph, quads)) {
+        return GlyphInfo();
+    }
+
+    // Font units to points, as CTFontCreatePathForGlyph.
+    float fontScale = CTFontGetSize(ctFont) / font.unitsPerEm();
+
+    auto boundingRect = CGRectMake(box.xMin * fontScale,
+                                   box.yMin * fontScale,
+                                   (box.xMax - box.xMin) * fontScale * scale,
+                                   (box.yMax - box.yMin) * fontScale * scale);
+
+    int width = ceilf(boundingRect.size.width) + 2*GLYPH_MARGIN;
+    int height = ceilf(boundingRect.size.height) + 2*GLYPH_MARGIN;
+
+    float s = fontScale * scale;
+    vgerFontPoint offset = {GLYPH_MARGIN - box.xMin * s, GLYPH_MARGIN - box.yMin * s};
+
+    auto region = [self addGlyph:glyph width:width height:height rasterize:[=](uint8_t* imageData) {
+        // Reuses the accumulation buffer.
+        static thread_local vgerGlyphRasterizer rasterizer;
+        rasterizer.rasterize(quads, s, offset, width, height, imageData, width);
+    }];
+
+    GlyphInfo info = {
+        .size=scale,
+        .regionIndex=region,
+        .textureWidth=width,
+        .textureHeight=height,
+        .glyphBounds=boundingRect
+    };
+
+    glyphs[glyph].push_back(info);
+
+    return info;
+}
+
+- (GlyphInfo) getSDFGlyph:(CGGlyph)glyph {
+
+    VGER_TRACE_ZONE("vgerGlyphCache getSDFGlyph");
+
+    if(glyph >= glyphs.size()) {
+        glyphs.resize(glyph+1);
+    }
+
+    auto& v = glyphs[glyph];
+
+    for(auto& info : v) {
+        if(info.sdf) {
+            [mgr useRegion:info.regionIndex];
+            return info;
+        }
+    }
+
+    CGRect boundingRect;
+    auto path = createGlyphPath(ctFont, glyph, &boundingRect);
+
+    if(path == 0) {
+        return GlyphInfo();
+    }
+
+    float scale = GLYPH_SDF_SCALE;
+    float spread = GLYPH_MARGIN;
+
+    boundingRect.size.width *= scale;
+    boundingRect.size.height *= scale;
+
+    int width = ceilf(boundingRect.size.width) + 2*GLYPH_MARGIN;
+    int height = ceilf(boundingRect.size.height) + 2*GLYPH_MARGIN;
+
+    // Segments in texels, with y up as in the coverage glyphs.
+    vgerPathScannerBegin(scan, path);
     CGPathRelease(path);
-    CGContextRelease(context);
-    CGColorSpaceRelease(colorSpace);
+
+    std::vector<float2> cvs;
+    for(auto& seg : scan.segments) {
+        for(int i=0;i<3;++i) {
+            cvs.push_back(seg.cvs[i] * scale + GLYPH_MARGIN);
+        }
+    }
+
+    auto region = [self addGlyph:glyph width:width height:height rasterize:[=](uint8_t* imageData) {
+
+        std::vector<float2> rowCVs;
+
+        for(int y=0;y<height;++y) {
+
+            // Only segments within the spread of the row affect distances,
+            // and segments the row doesn't cross don't affect the sign.
+            float py = height - y - 0.5f;
+            rowCVs.clear();
+            for(size_t i=0;i<cvs.size();i+=3) {
+                auto lo = std::min({cvs[i].y, cvs[i+1].y, cvs[i+2].y});
+                auto hi = std::max({cvs[i].y, cvs[i+1].y, cvs[i+2].y});
+                if(lo <= py + spread and hi >= py - spread) {
+                    rowCVs.insert(rowCVs.end(), &cvs[i], &cvs[i+3]);
+                }
+            }
+
+            vgerPrim prim = {
+                .type = vgerPathFill,
+                .start = 0,
+                .count = uint32_t(rowCVs.size() / 3)
+            };
+
+            for(int x=0;x<width;++x) {
+                float d = sdPrim(prim, rowCVs.data(), float2{x + 0.5f, py}, spread);
+                float value = clamp(0.5f - d / (2*spread), 0.0f, 1.0f);
+                imageData[y*width + x] = uint8_t(value * 255 + 0.5f);
+            }
+        }
+    }];
+
+    GlyphInfo info = {
+        .size=scale,
+        .sdf=true,
+        .regionIndex=region,
+        .textureWidth=width,
+        .textureHeight=height,
+        .glyphBounds=boundingRect
+    };
+
+    v.push_back(info);
 
     return info;
+}
 
+- (void) setGlyph:(CGGlyph)glyph forRegion:(int)region {
+    if(size_t(region) > regionGlyphs.size()) {
+        regionGlyphs.resize(region);
+    }
+    regionGlyphs[region-1] = glyph;
 }
 
 - (void) update:(id<MTLCommandBuffer>) buffer {
+
+    if(pending.size()) {
+        VGER_TRACE_ZONE("vgerGlyphCache add pending glyphs");
+
+        if(_waitForGlyphs) {
+            dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+        }
+
+        // Add finished glyphs in a batch. The rest keep empty rects.
+        size_t kept = 0;
+        for(auto& p : pending) {
+            if(p->ready.load(std::memory_order_acquire)) {
+                [mgr setRegion:p->region data:p->image.data() width:p->width height:p->height bytesPerRow:p->width];
+            } else {
+                pending[kept++] = p;
+            }
+        }
+        pending.resize(kept);
+    }
+
     [mgr update:buffer];
+
+    // Forget evicted glyphs. Their regions will be reused.
+    auto evicted = [mgr getEvictedRegions];
+    for(int i=0;i<mgr.evictedCount;++i) {
+        auto region = evicted[i];
+        auto& v = glyphs[regionGlyphs[region-1]];
+        v.erase(std::remove_if(v.begin(), v.end(), [region](const GlyphInfo& info) {
+            return info.regionIndex == region;
+        }), v.end());
+    }
+}
+
+- (void) useRegion:(int)region {
+    [mgr useRegion:region];
+}
+
+- (void) beginFrame {
+    [mgr beginFrame];
+}
+
+- (int) evictedCount {
+    return mgr.evictedCount;
+}
+
+- (int) pendingCount {
+    return int(pending.size());
+}
+
+- (int) pageCount {
+    return mgr.pageCount;
+}
+
+- (bool) full {
+    return mgr.failedCount > 0;
 }
 
 - (id<MTLTexture>) getAltas {
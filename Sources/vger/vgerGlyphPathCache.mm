@@ -41,53 +41,18 @@ vgerGlyphPathCache::Info& vgerGlyphPathCache::getInfo(CGGlyph glyph) {
     auto path = CTFontCreatePathForGlyph(ctFont, glyph, &glyphTransform);
     
     auto& info = _cache[glyph];
-    scan.begin(path);
+    vgerPathScannerBegin(scan, path);
     
     if(scanGlyphs) {
     
-        while(scan.next()) {
-            int n = scan.activeCount;
-            
-            vgerPrim prim = {
-                .type = vgerPathFill,
-                .start = (uint32_t) info.cvs.size(),
-                .count = uint16_t(n)
-            };
-            
-            Interval xInt{FLT_MAX, -FLT_MAX};
-            
-            for(int a = scan.first; a != -1; a = scan.segments[a].next) {
-                
-                assert(a < scan.segments.size());
-                for(int i=0;i<3;++i) {
-                    auto p = scan.segments[a].cvs[i];
-                    info.cvs.push_back(p);
-                    xInt.a = std::min(xInt.a, p.x);
-                    xInt.b = std::max(xInt.b, p.x);
-                }
-                
-            }
-            
-            BBox bounds;
-            bounds.min.x = xInt.a;
-            bounds.max.x = xInt.b;
-            bounds.min.y = scan.interval.a;
-            bounds.max.y = scan.interval.b;
-            
-            // Calculate the prim vertices at this stage,
-            // as we do for glyphs.
-            prim.quadBounds[0] = prim.texBounds[0] = bounds.min;
-            prim.quadBounds[1] = prim.texBounds[1] = bounds.max;
-            
-            info.prims.push_back(prim);
-        }
+        scan.scanPrims(0, 1, info.prims, info.cvs);
         
     } else {
         
         vgerPrim prim = {
             .type = vgerPathFill,
             .start = (uint32_t) info.cvs.size(),
-            .count = (uint16_t) scan.segments.size()
+            .count = (uint32_t) scan.segments.size()
         };
         
         for(auto& seg : scan.segments) {
@@ -0,0 +1,43 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include "vgerFont.h"
+#include <stdint.h>
+#include <vector>
+
+/// Coverage rasterizer for glyph outlines, without platform APIs.
+///
+/// Each line adds its signed area and coverage to an accumulation buffer,
+/// and a running sum over the buffer gives the coverage of each pixel, so
+/// there's no supersampling. Overlapping contours use the nonzero rule,
+/// clamped to full coverage.
+struct vgerGlyphRasterizer {
+
+    /// Maximum distance from a curve to its line segments, in pixels.
+    float tolerance = 0.1f;
+
+    /// Starts an image. Points are in pixels with y down, and are clamped
+    /// to the image horizontally.
+    void begin(int width, int height);
+
+    void addLine(vgerFontPoint a, vgerFontPoint b);
+
+    void addQuad(const vgerFontQuad& quad);
+
+    /// Writes A8 coverage, top row first.
+    void end(uint8_t* image, int bytesPerRow);
+
+    /// Rasterizes an outline with y up, as from vgerFont. Points are
+    /// scaled, then offset, and then flipped so y up fits the image.
+    void rasterize(const std::vector<vgerFontQuad>& quads,
+                   float scale, vgerFontPoint offset,
+                   int width, int height,
+                   uint8_t* image, int bytesPerRow);
+
+private:
+    int _width = 0;
+    int _height = 0;
+    int _stride = 0;
+    std::vector<float> _accum;
+};
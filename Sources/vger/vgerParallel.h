@@ -0,0 +1,12 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+
+/// Calls body(i) for i in [0, count) across a pool of worker threads and
+/// returns when all calls have finished. The calling thread helps. Nested
+/// or concurrent calls run on the calling thread instead of waiting for
+/// the pool. Portable replacement for dispatch_apply.
+void vgerParallelFor(size_t count, const std::function<void(size_t)>& body);
@@ -2,44 +2,80 @@
 
 #pragma once
 
-#include <simd/simd.h>
+#include "simd_compat.h"
 #include <vector>
 #include <set>
 #include "Interval.h"
+#include "prim.h"
+
+#ifdef __OBJC__
 #import <CoreGraphics/CoreGraphics.h>
+#endif
 
 struct vgerPathScanner {
 
+    /// Tiles with more segments than this are split in half (see tile()).
+    static constexpr int MaxTileSegments = 64;
+
+    /// Smallest tile produced by splitting.
+    static constexpr float MinTileWidth = 1;
+
     struct Segment {
         vector_float2 cvs[3];
         int next = -1;
         int previous = -1;
 
-        Interval yInterval() const {
+        /// The interval is fattened by pad so a band includes the curves
+        /// within a pixel of it, which affect its antialiasing.
+        Interval yInterval(float pad = 1) const {
             return {
-                // Fatten the interval slightly to prevent artifacts by
-                // slightly missing a curve in a band.
-                std::min(cvs[0].y, std::min(cvs[1].y, cvs[2].y)) - 1,
-                std::max(cvs[0].y, std::max(cvs[1].y, cvs[2].y)) + 1
+                std::min(cvs[0].y, std::min(cvs[1].y, cvs[2].y)) - pad,
+                std::max(cvs[0].y, std::max(cvs[1].y, cvs[2].y)) + pad
             };
         }
 
-        Interval xInterval() const {
+        Interval xInterval(float pad = 1) const {
             return {
-                // Fatten the interval slightly to prevent artifacts by
-                // slightly missing a curve in a band.
-                std::min(cvs[0].x, std::min(cvs[1].x, cvs[2].x)) - 1,
-                std::max(cvs[0].x, std::max(cvs[1].x, cvs[2].x)) + 1
+                std::min(cvs[0].x, std::min(cvs[1].x, cvs[2].x)) - pad,
+                std::max(cvs[0].x, std::max(cvs[1].x, cvs[2].x)) + pad
             };
         }
     };
 
+    /// A piece of the current slab produced by tile().
+    struct Tile {
+        Interval xInterval;
+
+        /// Range of segments in tileSegments.
+        int start;
+        int count;
+    };
+
     struct Node {
         float coord;
         int seg;
         bool end;
     };
 
+    /// How _init orders nodes by (coord, seg, end).
+    enum SortMode {
+        /// std::sort.
+        SortModeStd,
+
+        /// Stable LSD radix sort on coord.
+        SortModeRadix,
+
+        /// Merge the start and end nodes if each is already in order, as
+        /// for paths built in y-monotone order. Otherwise radix sort for
+        /// large paths and std::sort for small ones.
+        SortModeAuto
+    };
+
+    SortMode sortMode = SortModeAuto;
+
+    /// Number of slabs visited by the last scanPrims.
+    int slabCount = 0;
+
     std::vector<Segment> segments;
     std::vector<Node> nodes;
     int index = 0; // current node index
@@ -49,12 +85,85 @@ struct vgerPathScanner {
     vector_float2 start{0,0};
     vector_float2 p{0,0};
 
-    void _init();
-    void begin(vector_float2* cvs, int count);
+    /// Output of tile().
+    std::vector<Tile> tiles;
+    std::vector<Segment> tileSegments;
+
+    /// Scratch space for _init().
+    std::vector<Node> sortNodes;
+    std::vector<uint32_t> sortKeys, sortKeysTmp;
 
-    // In case we want to render glphs with paths.
-    void begin(CGPathRef path);
+    /// An active segment and its fattened x interval, for tile().
+    struct SweepSegment {
+        Interval x;
+        int seg;
+    };
+
+    /// Scratch space for tile(). tileActive holds the active segments
+    /// sorted by the start of their x intervals, and tileEnds the same
+    /// sorted by the end. Slabs only add or remove a few segments, so both
+    /// are kept between calls and updated rather than sorted again.
+    /// Tiles are swept from left to right. tileEntered of tileActive start
+    /// left of the current tile's right edge. Of those, tileLive are the
+    /// ones still touching it, and the rest are to its left.
+    std::vector<SweepSegment> tileActive;
+    std::vector<SweepSegment> tileEnds;
+    std::vector<SweepSegment> tileAdded;
+    std::vector<SweepSegment> tileLive;
+    size_t tileEntered = 0;
+
+    /// Per segment, the last tile() call which found it active.
+    std::vector<uint32_t> tileStamps;
+    uint32_t tileCall = 0;
+
+    /// Fattening of the intervals in tileActive. Zero until tile() is
+    /// first called after _init.
+    float tilePad = 0;
+
+    /// Endpoint y's of the segments right of the current tile which don't
+    /// cancel out, sorted. Endpoints occurring an even number of times
+    /// don't change the parity.
+    std::vector<float> tileCrossings;
+
+    /// Sorts the segments into nodes. filterWidth is the size of a pixel
+    /// in path coordinates; slabs include segments within that of them.
+    void _init(float filterWidth = 1);
+    void _radixSort();
+    bool _mergeSorted();
+    void begin(vector_float2* cvs, int count);
     
     bool next();
 
+    /// Splits the current slab into tiles of the given width, so each tile
+    /// only carries the segments that touch it. Segments to the right of a
+    /// tile are replaced by a few vertical proxy segments which give the
+    /// same inside/outside parity. Tiles with more than MaxTileSegments
+    /// are split further, unless the halves would share most of them.
+    /// A width of zero starts from the whole slab.
+    /// Tiles include the segments within filterWidth (the size of a pixel
+    /// in path coordinates) and cover the antialiased edge of the slab.
+    void tile(float width, float filterWidth = 1);
+
+    /// Splits tileX as needed and sweeps its tiles. Tiles must be visited
+    /// from left to right.
+    void _tile(Interval tileX, Interval slabX, float proxyOffset);
+
+    /// Number of active segments touching tileX.
+    size_t _tileCount(Interval tileX) const;
+
+    /// Toggles a segment's endpoints in tileCrossings.
+    void _toggleCrossings(const Segment& seg);
+
+    /// Scans all slabs (after begin or _init), appending a vgerPathFill
+    /// prim per slab (or per tile if tileWidth > 0 or the slab is dense)
+    /// and its cvs. Prim starts index into cvs. Paint and xform are left
+    /// for the caller. Pass the same filterWidth as to _init.
+    void scanPrims(float tileWidth, float filterWidth, std::vector<vgerPrim>& prims, std::vector<vector_float2>& cvs);
+
 };
+
+#ifdef __OBJC__
+/// Begins scanning a CoreGraphics path, in case we want to render glyphs
+/// with paths. Cubic curves aren't supported.
+void vgerPathScannerBegin(vgerPathScanner& scan, CGPathRef path);
+#endif
@@ -0,0 +1,65 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#include "vgerPathScanner.h"
+
+using namespace simd;
+
+static float2 tof2(CGPoint p) {
+    return float2{(float)p.x, (float)p.y};
+}
+
+static void pathElement(void *info, const CGPathElement *element) {
+
+    auto scan = (vgerPathScanner*) info;
+
+    float2& p = scan->p;
+    float2& start = scan->start;
+
+    switch(element->type) {
+        case kCGPathElementMoveToPoint:
+            p = start = tof2(element->points[0]);
+            break;
+
+        case kCGPathElementAddLineToPoint: {
+            float2 b = tof2(element->points[0]);
+            scan->segments.push_back({p, (p+b)/2, b});
+            p = b;
+        }
+            break;
+
+        case kCGPathElementAddQuadCurveToPoint:
+            scan->segments.push_back({
+                p, tof2(element->points[0]), tof2(element->points[1])
+            });
+
+            p = tof2(element->points[1]);
+            break;
+
+        case kCGPathElementAddCurveToPoint:
+            assert(false); // can't handle cubic curves yet.
+            break;
+
+        case kCGPathElementCloseSubpath:
+            if(!equal(p, start)) {
+                scan->segments.push_back({p, (p+start)/2, start});
+            }
+            p = start;
+            break;
+
+        default:
+            break;
+    }
+
+}
+
+void vgerPathScannerBegin(vgerPathScanner& scan, CGPathRef path) {
+
+    scan.segments.clear();
+    scan.p = float2{0,0};
+    scan.start = float2{0,0};
+
+    CGPathApply(path, &scan, pathElement);
+
+    scan._init();
+
+}
@@ -0,0 +1,143 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+/// Recorded vger API calls. Don't reorder: the values are stored in files.
+enum vgerOp : uint32_t {
+    vgerOpBegin,
+    vgerOpFillCircle,
+    vgerOpStrokeArc,
+    vgerOpFillRect,
+    vgerOpStrokeRect,
+    vgerOpStrokeBezier,
+    vgerOpStrokeSegment,
+    vgerOpStrokeWire,
+    vgerOpText,
+    vgerOpTextBox,
+    vgerOpMoveTo,
+    vgerOpLineTo,
+    vgerOpQuadTo,
+    vgerOpCubicApproxTo,
+    vgerOpFill,
+    vgerOpFillForTile,
+    vgerOpSetPathTileWidth,
+    vgerOpCreatePath,
+    vgerOpFillPath,
+    vgerOpDeletePath,
+    vgerOpCancelPath,
+    vgerOpTranslate,
+    vgerOpScale,
+    vgerOpRotate,
+    vgerOpSave,
+    vgerOpRestore,
+    vgerOpSetLayerCount,
+    vgerOpSetLayer,
+    vgerOpColorPaint,
+    vgerOpLinearGradient,
+    vgerOpRadialGradient,
+    vgerOpImagePattern,
+    vgerOpGrid,
+    vgerOpRetainPaint,
+    vgerOpReleasePaint,
+    vgerOpCubicTo,
+    vgerOpSetCubicTolerance,
+    vgerOpSetSDFGlyphs,
+    vgerOpSetGlyphRasterMode,
+    vgerOpCount
+};
+
+/// Header of a recording file. Followed by size bytes of ops, each of
+/// which is a vgerOp followed by its arguments, unaligned.
+struct vgerRecordingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+};
+
+/// "vgrc" in little endian.
+constexpr uint32_t vgerRecordingMagic = 0x63726776;
+constexpr uint32_t vgerRecordingVersion = 1;
+
+/// Strings are stored with their length and a terminating zero, so they
+/// can be used in place when replaying from a mapped file.
+struct vgerRecordedString {
+    const char* str;
+};
+
+/// Records vger API calls (see vgerBeginRecording).
+///
+/// Paint and path indices are recorded as they were returned, along with
+/// the calls which created them, so replay can map them to new indices.
+struct vgerRecorder {
+
+    std::vector<uint8_t> bytes;
+
+    template<class T>
+    void write(const T& value) {
+        auto p = (const uint8_t*) &value;
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+    }
+
+    void write(vgerRecordedString s) {
+        auto n = uint32_t(strlen(s.str));
+        write(n);
+        bytes.insert(bytes.end(), s.str, s.str + n + 1);
+    }
+
+    template<class... Args>
+    void record(vgerOp op, const Args&... args) {
+        write(op);
+        (write(args), ...);
+    }
+
+    /// Writes the header and ops. Returns false on failure.
+    bool save(const char* path) const;
+};
+
+/// Reads ops from a recording, typically mapped from a file.
+struct vgerRecordingReader {
+
+    const uint8_t* ptr;
+    const uint8_t* end;
+
+    /// Set to false if we run off the end.
+    bool ok = true;
+
+    bool atEnd() const { return ptr == end; }
+
+    template<class T>
+    T read() {
+        T value = {};
+        if(end - ptr < ptrdiff_t(sizeof(T))) {
+            ok = false;
+            ptr = end;
+            return value;
+        }
+        memcpy(&value, ptr, sizeof(T));
+        ptr += sizeof(T);
+        return value;
+    }
+
+    /// Bools are recorded as a byte. Reading other values than 0 and 1 as
+    /// bool is undefined, so any nonzero byte is true.
+    bool readBool() {
+        static_assert(sizeof(bool) == 1);
+        return read<uint8_t>() != 0;
+    }
+
+    const char* readString() {
+        auto n = read<uint32_t>();
+        if(!ok or end - ptr < ptrdiff_t(n) + 1 or ptr[n] != 0) {
+            ok = false;
+            ptr = end;
+            return "";
+        }
+        auto str = (const char*) ptr;
+        ptr += n + 1;
+        return str;
+    }
+};
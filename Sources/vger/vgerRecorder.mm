@@ -0,0 +1,352 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#import "vger.h"
+#import "vger_private.h"
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace simd;
+
+bool vgerRecorder::save(const char* path) const {
+
+    auto file = fopen(path, "wb");
+    if(!file) {
+        return false;
+    }
+
+    vgerRecordingHeader header = {vgerRecordingMagic, vgerRecordingVersion, bytes.size()};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok and fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = (fclose(file) == 0) and ok;
+    return ok;
+}
+
+void vgerBeginRecording(vgerContext vg) {
+    vg->recorder = std::make_unique<vgerRecorder>();
+}
+
+bool vgerEndRecording(vgerContext vg, const char* path) {
+    if(!vg->recorder) {
+        return false;
+    }
+    bool ok = vg->recorder->save(path);
+    vg->recorder.reset();
+    return ok;
+}
+
+namespace {
+
+/// Maps indices from the recording to indices in the replaying context.
+/// Indices which weren't created in the recording map to themselves.
+struct IndexMap {
+    std::unordered_map<uint32_t, uint32_t> map;
+
+    uint32_t operator()(uint32_t index) const {
+        auto iter = map.find(index);
+        return iter == map.end() ? index : iter->second;
+    }
+};
+
+bool replay(vgerContext vg, vgerRecordingReader& r) {
+
+    IndexMap paints, paths;
+
+    auto readPaint = [&] { return vgerPaintIndex{paints(r.read<vgerPaintIndex>().index)}; };
+    auto readPath = [&] { return vgerPathIndex{paths(r.read<vgerPathIndex>().index)}; };
+
+    while(r.ok and !r.atEnd()) {
+
+        auto op = r.read<vgerOp>();
+
+        switch(op) {
+            case vgerOpBegin: {
+                auto w = r.read<float>();
+                auto h = r.read<float>();
+                auto ratio = r.read<float>();
+                vgerBegin(vg, w, h, ratio);
+                break;
+            }
+            case vgerOpFillCircle: {
+                auto center = r.read<float2>();
+                auto radius = r.read<float>();
+                vgerFillCircle(vg, center, radius, readPaint());
+                break;
+            }
+            case vgerOpStrokeArc: {
+                auto center = r.read<float2>();
+                auto radius = r.read<float>();
+                auto width = r.read<float>();
+                auto rotation = r.read<float>();
+                auto aperture = r.read<float>();
+                vgerStrokeArc(vg, center, radius, width, rotation, aperture, readPaint());
+                break;
+            }
+            case vgerOpFillRect: {
+                auto min = r.read<float2>();
+                auto max = r.read<float2>();
+                auto radius = r.read<float>();
+                vgerFillRect(vg, min, max, radius, readPaint());
+                break;
+            }
+            case vgerOpStrokeRect: {
+                auto min = r.read<float2>();
+                auto max = r.read<float2>();
+                auto radius = r.read<float>();
+                auto width = r.read<float>();
+                vgerStrokeRect(vg, min, max, radius, width, readPaint());
+                break;
+            }
+            case vgerOpStrokeBezier: {
+                auto s = r.read<vgerBezierSegment>();
+                auto width = r.read<float>();
+                vgerStrokeBezier(vg, s, width, readPaint());
+                break;
+            }
+            case vgerOpStrokeSegment:
+            case vgerOpStrokeWire: {
+                auto a = r.read<float2>();
+                auto b = r.read<float2>();
+                auto width = r.read<float>();
+                auto paint = readPaint();
+                if(op == vgerOpStrokeSegment) {
+                    vgerStrokeSegment(vg, a, b, width, paint);
+                } else {
+                    vgerStrokeWire(vg, a, b, width, paint);
+                }
+                break;
+            }
+            case vgerOpText: {
+                auto str = r.readString();
+                auto color = r.read<float4>();
+                auto align = r.read<int>();
+                vgerText(vg, str, color, align);
+                break;
+            }
+            case vgerOpTextBox: {
+                auto str = r.readString();
+                auto breakRowWidth = r.read<float>();
+                auto color = r.read<float4>();
+                auto align = r.read<int>();
+                vgerTextBox(vg, str, breakRowWidth, color, align);
+                break;
+            }
+            case vgerOpMoveTo:
+                vgerMoveTo(vg, r.read<float2>());
+                break;
+            case vgerOpLineTo:
+                vgerLineTo(vg, r.read<float2>());
+                break;
+            case vgerOpQuadTo: {
+                auto b = r.read<float2>();
+                auto c = r.read<float2>();
+                vgerQuadTo(vg, b, c);
+                break;
+            }
+            case vgerOpCubicApproxTo: {
+                auto b = r.read<float2>();
+                auto c = r.read<float2>();
+                auto d = r.read<float2>();
+                vgerCubicApproxTo(vg, b, c, d);
+                break;
+            }
+            case vgerOpCubicTo: {
+                auto b = r.read<float2>();
+                auto c = r.read<float2>();
+                auto d = r.read<float2>();
+                vgerCubicTo(vg, b, c, d);
+                break;
+            }
+            case vgerOpSetCubicTolerance:
+                vgerSetCubicTolerance(vg, r.read<float>());
+                break;
+            case vgerOpSetSDFGlyphs:
+                vgerSetSDFGlyphs(vg, r.readBool());
+                break;
+            case vgerOpSetGlyphRasterMode: {
+                auto mode = r.read<int>();
+                if(mode < VGER_GLYPHS_SYNC or mode > VGER_GLYPHS_ASYNC_PLACEHOLDER) {
+                    r.ok = false;
+                    break;
+                }
+                vgerSetGlyphRasterMode(vg, vgerGlyphRasterMode(mode));
+                break;
+            }
+            case vgerOpFill:
+                vgerFill(vg, readPaint());
+                break;
+            case vgerOpFillForTile:
+                vgerFillForTile(vg, readPaint());
+                break;
+            case vgerOpSetPathTileWidth:
+                vgerSetPathTileWidth(vg, r.read<float>());
+                break;
+            case vgerOpCreatePath: {
+                auto recorded = r.read<vgerPathIndex>();
+                paths.map[recorded.index] = vgerCreatePath(vg).index;
+                break;
+            }
+            case vgerOpFillPath: {
+                auto path = readPath();
+                vgerFillPath(vg, path, readPaint());
+                break;
+            }
+            case vgerOpDeletePath:
+                vgerDeletePath(vg, readPath());
+                break;
+            case vgerOpCancelPath:
+                vgerCancelPath(vg);
+                break;
+            case vgerOpTranslate:
+                vgerTranslate(vg, r.read<float2>());
+                break;
+            case vgerOpScale:
+                vgerScale(vg, r.read<float2>());
+                break;
+            case vgerOpRotate:
+                vgerRotate(vg, r.read<float>());
+                break;
+            case vgerOpSave:
+                vgerSave(vg);
+                break;
+            case vgerOpRestore:
+                // Don't pop the last transform if the recording is unbalanced.
+                if(vgerStackDepth(vg) > 1) {
+                    vgerRestore(vg);
+                }
+                break;
+            case vgerOpSetLayerCount: {
+                auto count = r.read<int>();
+                if(count > 0 and count <= VGER_MAX_LAYERS) {
+                    vgerSetLayerCount(vg, count);
+                }
+                break;
+            }
+            case vgerOpSetLayer: {
+                auto layer = r.read<int>();
+                if(layer >= 0 and layer < vg->layerCount) {
+                    vgerSetLayer(vg, layer);
+                }
+                break;
+            }
+            case vgerOpColorPaint: {
+                auto color = r.read<float4>();
+                auto recorded = r.read<vgerPaintIndex>();
+                paints.map[recorded.index] = vgerColorPaint(vg, color).index;
+                break;
+            }
+            case vgerOpLinearGradient: {
+                auto start = r.read<float2>();
+                auto end = r.read<float2>();
+                auto innerColor = r.read<float4>();
+                auto outerColor = r.read<float4>();
+                auto glow = r.read<float>();
+                auto recorded = r.read<vgerPaintIndex>();
+                paints.map[recorded.index] = vgerLinearGradient(vg, start, end, innerColor, outerColor, glow).index;
+                break;
+            }
+            case vgerOpRadialGradient: {
+                auto center = r.read<float2>();
+                auto innerRadius = r.read<float>();
+                auto outerRadius = r.read<float>();
+                auto innerColor = r.read<float4>();
+                auto outerColor = r.read<float4>();
+                auto glow = r.read<float>();
+                auto recorded = r.read<vgerPaintIndex>();
+                paints.map[recorded.index] = vgerRadialGradient(vg, center, innerRadius, outerRadius, innerColor, outerColor, glow).index;
+                break;
+            }
+            case vgerOpImagePattern: {
+                auto origin = r.read<float2>();
+                auto size = r.read<float2>();
+                auto angle = r.read<float>();
+                auto flipY = r.readBool();
+                auto image = r.read<vgerImageIndex>();
+                auto alpha = r.read<float>();
+                auto recorded = r.read<vgerPaintIndex>();
+                // Images aren't recorded. Use white if the replaying
+                // context doesn't have one at the same index.
+                if(image.index < vg->textures.count) {
+                    paints.map[recorded.index] = vgerImagePattern(vg, origin, size, angle, flipY, image, alpha).index;
+                } else {
+                    paints.map[recorded.index] = vgerColorPaint(vg, float4{1,1,1,alpha}).index;
+                }
+                break;
+            }
+            case vgerOpGrid: {
+                auto origin = r.read<float2>();
+                auto size = r.read<float2>();
+                auto width = r.read<float>();
+                auto color = r.read<float4>();
+                auto recorded = r.read<vgerPaintIndex>();
+                paints.map[recorded.index] = vgerGrid(vg, origin, size, width, color).index;
+                break;
+            }
+            case vgerOpRetainPaint: {
+                auto paint = readPaint();
+                auto recorded = r.read<vgerPaintIndex>();
+                if(!vg->checkPaint(paint)) {
+                    r.ok = false;
+                    break;
+                }
+                paints.map[recorded.index] = vgerRetainPaint(vg, paint).index;
+                break;
+            }
+            case vgerOpReleasePaint: {
+                auto paint = readPaint();
+                if(!vg->isRetainedPaint(paint)) {
+                    r.ok = false;
+                    break;
+                }
+                vgerReleasePaint(vg, paint);
+                break;
+            }
+            default:
+                r.ok = false;
+                break;
+        }
+    }
+
+    return r.ok;
+}
+
+}
+
+bool vgerReplay(vgerContext vg, const char* path) {
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 or size_t(st.st_size) < sizeof(vgerRecordingHeader)) {
+        close(fd);
+        return false;
+    }
+
+    auto length = size_t(st.st_size);
+    auto data = (const uint8_t*) mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(data == MAP_FAILED) {
+        return false;
+    }
+
+    vgerRecordingHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    bool ok = header.magic == vgerRecordingMagic and
+              header.version == vgerRecordingVersion and
+              header.size <= length - sizeof(header);
+
+    if(ok) {
+        vgerRecordingReader reader{data + sizeof(header), data + sizeof(header) + header.size};
+        ok = replay(vg, reader);
+    }
+
+    munmap((void*) data, length);
+    return ok;
+}
@@ -23,7 +23,6 @@ static id<MTLLibrary> GetMetalLibrary(id<MTLDevice> device) {
 
 @interface vgerRenderer() {
     id<MTLRenderPipelineState> pipeline;
-    id<MTLComputePipelineState> boundsPipeline;
 }
 @end
 
@@ -53,13 +52,6 @@ static id<MTLLibrary> GetMetalLibrary(id<MTLDevice> device) {
             NSLog(@"error creating pipline state: %@", error);
             abort();
         }
-
-        auto boundsFunc = [lib newFunctionWithName:@"vger_bounds"];
-        boundsPipeline = [device newComputePipelineStateWithFunction:boundsFunc error:&error];
-        if(error) {
-            NSLog(@"error creating pipline state: %@", error);
-            abort();
-        }
     }
     return self;
 }
@@ -78,69 +70,74 @@ static id<MTLLibrary> GetMetalLibrary(id<MTLDevice> device) {
         return;
     }
 
-    auto bounds = [buffer computeCommandEncoder];
-    bounds.label = @"bounds encoder";
-    [bounds setComputePipelineState:boundsPipeline];
-    [bounds setBuffer:scene.prims[layer].buffer offset:0 atIndex:0];
-    [bounds setBuffer:scene.cvs.buffer offset:0 atIndex:1];
-    [bounds setBytes:&n length:sizeof(uint) atIndex:2];
-    [bounds dispatchThreadgroups:MTLSizeMake(n/128+1, 1, 1)
-          threadsPerThreadgroup:MTLSizeMake(128, 1, 1)];
-    [bounds endEncoding];
-
     auto enc = [buffer renderCommandEncoderWithDescriptor:pass];
     enc.label = @"render encoder";
     
     [enc setRenderPipelineState:pipeline];
     [enc setFragmentTexture:glyphTexture atIndex:1];
-    [enc setVertexBuffer:scene.prims[layer].buffer offset:0 atIndex:0];
-    [enc setVertexBuffer:scene.xforms.buffer offset:0 atIndex:1];
+    [enc setVertexBuffer:scene.xforms.storage.buffer offset:0 atIndex:1];
     [enc setVertexBytes:&windowSize length:sizeof(windowSize) atIndex:2];
-    [enc setFragmentBuffer:scene.prims[layer].buffer offset:0 atIndex:0];
-    [enc setFragmentBuffer:scene.cvs.buffer offset:0 atIndex:1];
-    [enc setFragmentBuffer:scene.paints.buffer offset:0 atIndex:2];
+    [enc setVertexBuffer:scene.cvs.storage.buffer offset:0 atIndex:3];
+    [enc setFragmentBuffer:scene.cvs.storage.buffer offset:0 atIndex:1];
+    [enc setFragmentBuffer:scene.paints.storage.buffer offset:0 atIndex:2];
     [enc setFragmentBytes:&glow length:sizeof(bool) atIndex:3];
 
-    vgerPrim* p = scene.prims[layer].ptr;
     vgerPaint* paints = (vgerPaint*) scene.paints.ptr;
     int currentTexture = -1;
-    int m = 0;
-    int offset = 0;
-    for(int i=0;i<n;++i) {
-
-        assert(p->paint < scene.paints.count);
-        int imageID = paints[p->paint].image;
-
-        // Texture ID changed, render.
-        if(imageID >= 0 and imageID != currentTexture) {
-
-            if(m) {
-                [enc setVertexBufferOffset:offset atIndex:0];
-                [enc setFragmentBufferOffset:offset atIndex:0];
-                [enc drawPrimitives:MTLPrimitiveTypeTriangleStrip
-                        vertexStart:0
-                        vertexCount:4
-                      instanceCount:m];
-            }
+    int remaining = n;
+
+    // Each chunk of prims is a separate buffer.
+    for(auto& chunk : scene.prims[layer].chunks) {
 
-            assert(imageID < textures.count);
-            [enc setFragmentTexture:[textures objectAtIndex:imageID] atIndex:0];
-            
-            currentTexture = imageID;
-            offset = i*sizeof(vgerPrim);
-            m = 0;
+        int chunkCount = std::min(remaining, int(chunk.count));
+        if(chunkCount == 0) {
+            break;
         }
+        remaining -= chunkCount;
+
+        [enc setVertexBuffer:chunk.storage.buffer offset:0 atIndex:0];
+        [enc setFragmentBuffer:chunk.storage.buffer offset:0 atIndex:0];
+
+        vgerCompactPrim* p = chunk.ptr;
+        int m = 0;
+        int offset = 0;
+        for(int i=0;i<chunkCount;++i) {
+
+            auto paint = primPaint(*p);
+            assert(paint < scene.paints.count);
+            int imageID = paints[paint].image;
+
+            // Texture ID changed, render.
+            if(imageID >= 0 and imageID != currentTexture) {
+
+                if(m) {
+                    [enc setVertexBufferOffset:offset atIndex:0];
+                    [enc setFragmentBufferOffset:offset atIndex:0];
+                    [enc drawPrimitives:MTLPrimitiveTypeTriangleStrip
+                            vertexStart:0
+                            vertexCount:4
+                          instanceCount:m];
+                }
+
+                assert(imageID < textures.count);
+                [enc setFragmentTexture:[textures objectAtIndex:imageID] atIndex:0];
+
+                currentTexture = imageID;
+                offset = i*sizeof(vgerCompactPrim);
+                m = 0;
+            }
 
-        p++; m++;
-    }
+            p++; m++;
+        }
 
-    if(m) {
-        [enc setVertexBufferOffset:offset atIndex:0];
-        [enc setFragmentBufferOffset:offset atIndex:0];
-        [enc drawPrimitives:MTLPrimitiveTypeTriangleStrip
-                vertexStart:0
-                vertexCount:4
-              instanceCount:m];
+        if(m) {
+            [enc setVertexBufferOffset:offset atIndex:0];
+            [enc setFragmentBufferOffset:offset atIndex:0];
+            [enc drawPrimitives:MTLPrimitiveTypeTriangleStrip
+                    vertexStart:0
+                    vertexCount:4
+                  instanceCount:m];
+        }
     }
 
     [enc endEncoding];
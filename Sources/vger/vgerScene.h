@@ -3,67 +3,51 @@
 #pragma once
 
 #import <Metal/Metal.h>
-#define VGER_MAX_LAYERS 4
-
-#import "prim.h"
-#import "paint.h"
 #import <simd/simd.h>
+#include "vgerBasicScene.h"
+#include <stdio.h>
 
 using namespace simd;
 
-template<class T>
-struct GPUVec {
+/// Shared Metal buffers, which the renderer reads directly.
+struct vgerMetalStorage {
+    id<MTLDevice> device;
     id<MTLBuffer> buffer;
-    T* ptr = nullptr;
-    size_t count = 0;
-    size_t capacity = 1024;
-    static constexpr size_t MaxBufferSizeBytes = 1024 * 1024 * 256;
 
-    GPUVec() { }
+    /// Label for buffers allocated from this storage.
+    NSString* label;
 
-    GPUVec(id<MTLDevice> device) {
-        buffer = [device newBufferWithLength:capacity * sizeof(T)
-                                     options:MTLResourceStorageModeShared];
-        ptr = static_cast<T*>(buffer.contents);
-    }
+    vgerMetalStorage() { }
 
-    void allocate(id<MTLDevice> device, size_t cap) {
-        capacity = cap;
-        auto oldBuffer = buffer;
-        buffer = [device newBufferWithLength:capacity * sizeof(T)
-                                     options:MTLResourceStorageModeShared];
-        memcpy(buffer.contents, oldBuffer.contents, count * sizeof(T));
-        ptr = static_cast<T*>(buffer.contents);
-    }
+    /// Allocates buffers from device when first used.
+    explicit vgerMetalStorage(id<MTLDevice> device, NSString* label = nil) : device(device), label(label) { }
 
-    void append(const T& value) {
+    /// Wraps an existing buffer.
+    explicit vgerMetalStorage(id<MTLBuffer> buffer) : device(buffer.device), buffer(buffer) { }
 
-        if(count >= capacity && capacity*2*sizeof(T) <= MaxBufferSizeBytes) {
-            allocate(buffer.device, capacity*2);
-        }
+    void* contents() const { return buffer.contents; }
+    size_t length() const { return buffer.length; }
 
-        if(count < capacity) {
-            ptr[count++] = value;
+    /// A default constructed storage has no device to allocate from, which
+    /// is a bug: it would otherwise look like running out of memory.
+    vgerMetalStorage reallocate(size_t length) const {
+        assert(device);
+        if(!device) {
+            fprintf(stderr, "vgerMetalStorage: no device to allocate %zu bytes from\n", length);
+            return {};
         }
-    }
-
-    void clear() {
-        count = 0;
+        vgerMetalStorage result{device, label};
+        result.buffer = [device newBufferWithLength:length
+                                            options:MTLResourceStorageModeShared];
+        result.buffer.label = label;
+        return result;
     }
 };
 
-struct vgerScene {
-    GPUVec<vgerPrim>  prims[VGER_MAX_LAYERS];
-    GPUVec<float2>    cvs;
-    GPUVec<float3x3>  xforms;
-    GPUVec<vgerPaint> paints;
+template<class T>
+using GPUVec = vgerVec<T, vgerMetalStorage>;
 
-    void clear() {
-        for(int layer=0;layer<VGER_MAX_LAYERS;++layer) {
-            prims[layer].clear();
-        }
-        cvs.clear();
-        xforms.clear();
-        paints.clear();
-    }
-};
+template<class T>
+using GPUChunkedVec = vgerChunkedVec<T, vgerMetalStorage>;
+
+typedef vgerBasicScene<vgerMetalStorage> vgerScene;
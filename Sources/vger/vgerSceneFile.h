@@ -0,0 +1,57 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include "vgerScene.h"
+
+/// Sections are aligned and padded to this, so they can be wrapped by
+/// newBufferWithBytesNoCopy on any Apple device.
+constexpr size_t vgerSceneFilePageSize = 16384;
+
+/// "vgsc" in little endian.
+constexpr uint32_t vgerSceneFileMagic = 0x63736776;
+
+/// Version 2 stores arcs as sines and cosines rather than angles.
+constexpr uint32_t vgerSceneFileVersion = 2;
+
+struct vgerSceneFileSection {
+    /// Byte offset from the start of the file. A multiple of the page size.
+    uint64_t offset;
+
+    /// Number of elements.
+    uint64_t count;
+};
+
+/// Header at the start of a scene file, padded to a page. The sections
+/// hold the contents of the vgerScene buffers.
+struct vgerSceneFileHeader {
+    uint32_t magic;
+    uint32_t version;
+
+    /// Element sizes, to reject files written with different layouts.
+    uint32_t primSize;
+    uint32_t paintSize;
+
+    uint32_t layerCount;
+    uint32_t reserved;
+
+    vgerSceneFileSection prims[VGER_MAX_LAYERS];
+    vgerSceneFileSection cvs;
+    vgerSceneFileSection xforms;
+    vgerSceneFileSection paints;
+};
+
+/// A scene loaded from a file. Its buffers point into the mapped file, which
+/// is unmapped once they've all been released.
+struct vgerStaticScene {
+    vgerScene scene;
+    int layerCount = 0;
+};
+
+/// Writes the scene's buffers to a file. Glyph prims are left out, since
+/// they refer to the glyph cache.
+bool vgerWriteSceneFile(const vgerScene& scene, int layerCount, const char* path);
+
+/// Maps a scene file and wraps its sections in Metal buffers without
+/// copying.
+bool vgerMapSceneFile(id<MTLDevice> device, const char* path, vgerStaticScene& out);
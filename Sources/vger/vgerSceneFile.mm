@@ -0,0 +1,226 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#import "vgerSceneFile.h"
+#include <stdio.h>
+#include <memory>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+size_t roundUpToPage(size_t n) {
+    n = std::max(n, size_t(1));
+    return (n + vgerSceneFilePageSize - 1) / vgerSceneFilePageSize * vgerSceneFilePageSize;
+}
+
+/// Checks that a loaded prim only refers to elements within the scene.
+/// Glyph prims aren't saved, since they refer to the glyph cache.
+bool validPrim(const vgerCompactPrim& cp, const vgerSceneFileHeader& header) {
+
+    if(cp.xform >= header.xforms.count or primPaint(cp) >= header.paints.count) {
+        return false;
+    }
+
+    auto cvsCount = header.cvs.count;
+    auto fits = [&](uint64_t start, uint64_t count) {
+        return start <= cvsCount and count <= (cvsCount - start) / 3;
+    };
+
+    switch(primType(cp)) {
+        case vgerCircle:
+        case vgerArc:
+        case vgerRect:
+        case vgerRectStroke:
+        case vgerSegment:
+        case vgerWire:
+            return true;
+        case vgerBezier:
+            return fits(cp.data[0], 1);
+        case vgerCurve:
+        case vgerPathFill:
+            return fits(cp.data[0], cp.data[1]);
+        default:
+            return false;
+    }
+}
+
+/// Unmaps the file when the last buffer referring to it is released.
+struct Mapping {
+    void* data;
+    size_t length;
+
+    ~Mapping() {
+        munmap(data, length);
+    }
+};
+
+}
+
+bool vgerWriteSceneFile(const vgerScene& scene, int layerCount, const char* path) {
+
+    assert(layerCount > 0 and layerCount <= VGER_MAX_LAYERS);
+
+    vgerSceneFileHeader header = {};
+    header.magic = vgerSceneFileMagic;
+    header.version = vgerSceneFileVersion;
+    header.primSize = sizeof(vgerCompactPrim);
+    header.paintSize = sizeof(vgerPaint);
+    header.layerCount = layerCount;
+
+    // Glyph prims depend on the glyph cache, so leave them out.
+    std::vector<vgerCompactPrim> prims[VGER_MAX_LAYERS];
+    for(int layer=0;layer<layerCount;++layer) {
+        for(auto& chunk : scene.prims[layer].chunks) {
+            for(size_t i=0;i<chunk.count;++i) {
+                if(primType(chunk.ptr[i]) != vgerGlyph) {
+                    prims[layer].push_back(chunk.ptr[i]);
+                }
+            }
+        }
+    }
+
+    struct Section {
+        vgerSceneFileSection* section;
+        const void* data;
+        size_t count;
+        size_t elementSize;
+    };
+
+    std::vector<Section> sections;
+    for(int layer=0;layer<layerCount;++layer) {
+        sections.push_back({&header.prims[layer], prims[layer].data(), prims[layer].size(), sizeof(vgerCompactPrim)});
+    }
+    sections.push_back({&header.cvs, scene.cvs.ptr, scene.cvs.count, sizeof(float2)});
+    sections.push_back({&header.xforms, scene.xforms.ptr, scene.xforms.count, sizeof(vgerAffine)});
+    sections.push_back({&header.paints, scene.paints.ptr, scene.paints.count, sizeof(vgerPaint)});
+
+    size_t offset = roundUpToPage(sizeof(header));
+    for(auto& s : sections) {
+        s.section->offset = offset;
+        s.section->count = s.count;
+        offset += roundUpToPage(s.count * s.elementSize);
+    }
+
+    auto file = fopen(path, "wb");
+    if(!file) {
+        return false;
+    }
+
+    std::vector<uint8_t> page(vgerSceneFilePageSize);
+
+    auto writePadded = [&](const void* data, size_t size) {
+        bool ok = size == 0 or fwrite(data, 1, size, file) == size;
+        auto padding = roundUpToPage(size) - size;
+        while(ok and padding) {
+            auto n = std::min(padding, page.size());
+            ok = fwrite(page.data(), 1, n, file) == n;
+            padding -= n;
+        }
+        return ok;
+    };
+
+    bool ok = writePadded(&header, sizeof(header));
+    for(auto& s : sections) {
+        ok = ok and writePadded(s.data, s.count * s.elementSize);
+    }
+
+    ok = (fclose(file) == 0) and ok;
+    return ok;
+}
+
+bool vgerMapSceneFile(id<MTLDevice> device, const char* path, vgerStaticScene& out) {
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 or size_t(st.st_size) < sizeof(vgerSceneFileHeader)) {
+        close(fd);
+        return false;
+    }
+
+    auto length = size_t(st.st_size);
+
+    // Private and writable, so the scene can be appended to (which copies
+    // the buffer) without touching the file.
+    auto data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(data == MAP_FAILED) {
+        return false;
+    }
+
+    auto mapping = std::shared_ptr<Mapping>(new Mapping{data, length});
+    auto& header = *(const vgerSceneFileHeader*) data;
+
+    if(header.magic != vgerSceneFileMagic or
+       header.version != vgerSceneFileVersion or
+       header.primSize != sizeof(vgerCompactPrim) or
+       header.paintSize != sizeof(vgerPaint) or
+       header.layerCount < 1 or header.layerCount > VGER_MAX_LAYERS) {
+        return false;
+    }
+
+    bool ok = true;
+
+    auto wrap = [&](const vgerSceneFileSection& section, size_t elementSize) -> id<MTLBuffer> {
+        // Check the count before multiplying, so the size can't overflow.
+        if(section.offset % vgerSceneFilePageSize or section.offset > length or
+           section.count > (length - section.offset) / elementSize) {
+            ok = false;
+            return nil;
+        }
+        auto size = roundUpToPage(section.count * elementSize);
+        if(size > length - section.offset) {
+            ok = false;
+            return nil;
+        }
+        id<MTLBuffer> buffer = [device newBufferWithBytesNoCopy:(uint8_t*) data + section.offset
+                                                         length:size
+                                                        options:MTLResourceStorageModeShared
+                                                    deallocator:^(void*, NSUInteger) {
+            // Keeps the mapping alive until the buffer is released.
+            (void) mapping;
+        }];
+        ok = ok and buffer != nil;
+        return buffer;
+    };
+
+    vgerStaticScene result;
+    result.layerCount = int(header.layerCount);
+
+    for(int layer=0;layer<result.layerCount;++layer) {
+        auto buffer = wrap(header.prims[layer], sizeof(vgerCompactPrim));
+        if(buffer) {
+            auto prims = (const vgerCompactPrim*) buffer.contents;
+            for(uint64_t i=0;ok and i<header.prims[layer].count;++i) {
+                ok = validPrim(prims[i], header);
+            }
+            result.scene.prims[layer] = GPUChunkedVec<vgerCompactPrim>(GPUVec<vgerCompactPrim>(vgerMetalStorage(buffer), header.prims[layer].count));
+        }
+    }
+
+    if(auto buffer = wrap(header.cvs, sizeof(float2))) {
+        result.scene.cvs = GPUVec<float2>(vgerMetalStorage(buffer), header.cvs.count);
+    }
+
+    if(auto buffer = wrap(header.xforms, sizeof(vgerAffine))) {
+        result.scene.xforms = GPUVec<vgerAffine>(vgerMetalStorage(buffer), header.xforms.count);
+    }
+
+    if(auto buffer = wrap(header.paints, sizeof(vgerPaint))) {
+        result.scene.paints = GPUVec<vgerPaint>(vgerMetalStorage(buffer), header.paints.count);
+    }
+
+    if(!ok) {
+        return false;
+    }
+
+    out = result;
+    return true;
+}
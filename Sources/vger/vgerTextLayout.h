@@ -0,0 +1,34 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "simd_compat.h"
+#include "prim.h"
+#include "hash.h"
+
+/// For caching the layout of strings.
+struct TextLayoutInfo {
+    /// The frame in which the string was last rendered. If not the current frame,
+    /// then the string is pruned from the cache.
+    uint64_t lastFrame = 0;
+
+    /// Prims are copied to output.
+    std::vector<vgerPrim> prims;
+};
+
+struct TextLayoutKey {
+    std::string str;
+    float size;
+    int align;
+    float breakRowWidth = -1;
+
+    /// Distance field glyphs. Their layouts don't depend on size.
+    bool sdf = false;
+
+    friend bool operator==(const TextLayoutKey&, const TextLayoutKey&) = default;
+    friend bool operator!=(const TextLayoutKey&, const TextLayoutKey&) = default;
+};
+
+MAKE_HASHABLE(TextLayoutKey, t.str, t.size, t.align, t.breakRowWidth, t.sdf);
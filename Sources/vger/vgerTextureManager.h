@@ -6,10 +6,26 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/// Packs textures into an atlas, which is a 2D texture array with a page
+/// per slice.
+///
+/// When the atlas is full, regions which haven't been used in the current
+/// or previous frame are evicted, least recently used first, and their
+/// rects are reused. Evicted region indices are reused too. If evicting
+/// can't make room, nothing is evicted and a page is added.
 @interface vgerTextureManager : NSObject
 
+/// Replaced when pages are added.
 @property (nonatomic, retain, readonly) id<MTLTexture> atlas;
 @property (nonatomic, readonly) float usage;
+@property (nonatomic, readonly) int pageCount;
+
+/// Regions evicted by the last update.
+@property (nonatomic, readonly) int evictedCount;
+
+/// Regions which didn't fit, even after evicting and adding pages. Their
+/// rects are empty.
+@property (nonatomic, readonly) int failedCount;
 
 - (instancetype)initWithDevice:(id<MTLDevice>) device pixelFormat:(MTLPixelFormat)format;
 
@@ -23,13 +39,29 @@ NS_ASSUME_NONNULL_BEGIN
 /// Add region for an already loaded texture.
 - (int) addRegion:(id<MTLTexture>)texture;
 
+/// Creates a region whose image isn't ready yet. Its rect is empty, and it
+/// isn't evicted, until the image is set and the atlas is updated.
+- (int) reserveRegion;
+
+/// Sets the image of a reserved region.
+- (void) setRegion:(int)region data:(const uint8_t*)data width:(int)width height:(int)height bytesPerRow:(NSUInteger)bytesPerRow;
+
 /// Updates the atlas texture.
 /// @param buffer to encode blit commands
 - (void) update:(id<MTLCommandBuffer>) buffer;
 
-/// Get a pointer to the first rectangle.
+/// Get a pointer to the first rectangle. Each rect's id is its page.
 - (stbrp_rect*) getRects;
 
+/// Marks a region as used in the current frame, so it isn't evicted.
+- (void) useRegion:(int)region;
+
+/// Starts a new frame for tracking region use.
+- (void) beginFrame;
+
+/// Get a pointer to the regions evicted by the last update.
+- (const int*) getEvictedRegions;
+
 @end
 
 NS_ASSUME_NONNULL_END
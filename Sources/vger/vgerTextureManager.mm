@@ -2,21 +2,104 @@
 
 #import "vgerTextureManager.h"
 #include "stb_rect_pack.h"
+#include "vgerTrace.h"
 #include <vector>
+#include <memory>
+#include <algorithm>
 
 #define ATLAS_SIZE 2048
 
+/// Glyph prims have 4 bits for the page.
+#define ATLAS_MAX_PAGES 16
+
+namespace {
+
+/// Skyline packer for a page. Not movable, since the context points to
+/// itself.
+struct Page {
+    stbrp_context ctx;
+    std::vector<stbrp_node> nodes;
+
+    Page() : nodes(2*ATLAS_SIZE) {
+        stbrp_init_target(&ctx, ATLAS_SIZE, ATLAS_SIZE, nodes.data(), 2*ATLAS_SIZE);
+    }
+
+    Page(const Page&) = delete;
+};
+
+}
+
 @interface vgerTextureManager() {
     id<MTLDevice> _device;
     MTLTextureDescriptor* atlasDesc;
-    std::vector<stbrp_node> nodes;
+    std::vector< std::unique_ptr<Page> > pages;
     std::vector<stbrp_rect> regions;
-    stbrp_context ctx;
     NSMutableArray< id<MTLTexture> >* newTextures;
     size_t areaUsed;
+
+    /// Region indices of newTextures.
+    std::vector<int> newRegions;
+
+    /// Frame each region was last used in.
+    std::vector<uint64_t> lastUse;
+    uint64_t frame;
+
+    /// Indices of evicted regions.
+    std::vector<int> freeRegions;
+
+    /// Rects of evicted regions, which aren't in the skyline packer.
+    std::vector<stbrp_rect> freeRects;
+
+    std::vector<int> evicted;
 }
 @end
 
+/// Rect ids are pages.
+static bool adjacent(const stbrp_rect& a, const stbrp_rect& b) {
+    return a.id == b.id and
+          ((a.y == b.y and a.h == b.h and (a.x + a.w == b.x or b.x + b.w == a.x)) or
+           (a.x == b.x and a.w == b.w and (a.y + a.h == b.y or b.y + b.h == a.y)));
+}
+
+/// Frees a rect, merging it with neighbors where they line up.
+static void freeRect(std::vector<stbrp_rect>& freeRects, stbrp_rect r) {
+
+    for(bool merged = true; merged;) {
+        merged = false;
+        for(auto it = freeRects.begin(); it != freeRects.end(); ++it) {
+            if(adjacent(r, *it)) {
+                auto x = std::min(r.x, it->x), y = std::min(r.y, it->y);
+                r.w = std::max(r.x + r.w, it->x + it->w) - x;
+                r.h = std::max(r.y + r.h, it->y + it->h) - y;
+                r.x = x;
+                r.y = y;
+                freeRects.erase(it);
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    freeRects.push_back(r);
+}
+
+/// The smallest free rect a rect fits in.
+static auto bestFreeRect(std::vector<stbrp_rect>& freeRects, const stbrp_rect& r) {
+    auto best = freeRects.end();
+    for(auto it = freeRects.begin(); it != freeRects.end(); ++it) {
+        if(it->w >= r.w and it->h >= r.h and
+           (best == freeRects.end() or it->w * it->h < best->w * best->h)) {
+            best = it;
+        }
+    }
+    return best;
+}
+
+static bool contains(const stbrp_rect& a, const stbrp_rect& b) {
+    return a.id == b.id and a.x <= b.x and a.y <= b.y and
+           b.x + b.w <= a.x + a.w and b.y + b.h <= a.y + a.h;
+}
+
 @implementation vgerTextureManager
 
 - (instancetype) initWithDevice:(id<MTLDevice>)device pixelFormat:(MTLPixelFormat)format {
@@ -28,8 +111,9 @@
                             width:ATLAS_SIZE
                             height:ATLAS_SIZE
                             mipmapped:NO];
-        nodes.resize(2*ATLAS_SIZE);
-        stbrp_init_target(&ctx, ATLAS_SIZE, ATLAS_SIZE, nodes.data(), 2*ATLAS_SIZE);
+        atlasDesc.textureType = MTLTextureType2DArray;
+        atlasDesc.arrayLength = 1;
+        pages.push_back(std::make_unique<Page>());
 
         atlasDesc.usage = MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead | MTLTextureUsageShaderWrite;
 #if TARGET_OS_OSX || TARGET_OS_MACCATALYST
@@ -42,11 +126,18 @@
         assert(self.atlas);
 
         newTextures = [NSMutableArray new];
+        frame = 1;
     }
     return self;
 }
 
 - (int) addRegion:(const uint8_t *)data width:(int)width height:(int)height bytesPerRow:(NSUInteger)bytesPerRow {
+    auto region = [self reserveRegion];
+    [self setRegion:region data:data width:width height:height bytesPerRow:bytesPerRow];
+    return region;
+}
+
+- (void) setRegion:(int)region data:(const uint8_t *)data width:(int)width height:(int)height bytesPerRow:(NSUInteger)bytesPerRow {
 
     auto desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:atlasDesc.pixelFormat width:width height:height mipmapped:NO];
     desc.usage = MTLTextureUsageShaderRead;
@@ -59,57 +150,243 @@
     assert(tex);
 
     [tex replaceRegion:MTLRegionMake2D(0, 0, width, height) mipmapLevel:0 withBytes:data bytesPerRow:bytesPerRow];
-    return [self addRegion:tex];
 
+    [newTextures addObject:tex];
+    newRegions.push_back(region);
 }
 
 /// Add region for an already loaded texture.
 - (int) addRegion:(id<MTLTexture>)texture {
-
+    auto region = [self reserveRegion];
     [newTextures addObject:texture];
-    return int(regions.size() + newTextures.count);
+    newRegions.push_back(region);
+    return region;
+}
+
+- (int) reserveRegion {
+
+    int region;
+    if(freeRegions.size()) {
+        region = freeRegions.back();
+        freeRegions.pop_back();
+    } else {
+        regions.push_back({});
+        lastUse.push_back(0);
+        region = int(regions.size());
+    }
+
+    // Empty until update.
+    regions[region-1] = stbrp_rect{};
+    lastUse[region-1] = frame;
+
+    return region;
+
+}
+
+- (void) useRegion:(int)region {
+    assert(region > 0 and region <= lastUse.size());
+    lastUse[region-1] = frame;
+}
+
+- (void) beginFrame {
+    frame++;
+}
 
+/// Places a rect in the smallest free rect it fits, splitting off the
+/// remainder.
+- (bool) placeInFreeRect:(stbrp_rect&)r {
+
+    auto best = bestFreeRect(freeRects, r);
+    if(best == freeRects.end()) {
+        return false;
+    }
+
+    auto f = *best;
+    freeRects.erase(best);
+
+    r.x = f.x;
+    r.y = f.y;
+    r.was_packed = 1;
+
+    r.id = f.id;
+
+    if(f.w > r.w) {
+        freeRects.push_back({f.id, f.w - r.w, r.h, f.x + r.w, f.y, 0});
+    }
+    if(f.h > r.h) {
+        freeRects.push_back({f.id, f.w, f.h - r.h, f.x, f.y + r.h, 0});
+    }
+
+    return true;
+}
+
+/// Packs a rect into the first page with room.
+- (bool) pack:(stbrp_rect&)r {
+    for(size_t page=0;page<pages.size();++page) {
+        stbrp_pack_rects(&pages[page]->ctx, &r, 1);
+        if(r.was_packed) {
+            r.id = int(page);
+            return true;
+        }
+    }
+    return false;
 }
 
-// Add any new textures and repack if necessary.
+/// Evicts least recently used regions to make room for a rect. Regions
+/// used in the current or previous frame may still be drawn (text layouts
+/// are cached for a frame), so they're kept.
+///
+/// Freed rects only merge where they line up, so evicting can free plenty
+/// of area without making room. Eviction is tried on a copy of the free
+/// rects first. If the rect fits, the regions inside the space it fits in
+/// are evicted. Otherwise nothing is.
+- (bool) evictFor:(stbrp_rect&)r {
+
+    std::vector<int> candidates;
+    for(int i=0;i<int(regions.size());++i) {
+        if(regions[i].w and lastUse[i] + 1 < frame) {
+            candidates.push_back(i+1);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [&](int a, int b) {
+        return lastUse[a-1] < lastUse[b-1];
+    });
+
+    auto trial = freeRects;
+    auto space = trial.end();
+    size_t n = 0;
+    while(space == trial.end() and n < candidates.size()) {
+        freeRect(trial, regions[candidates[n++]-1]);
+        space = bestFreeRect(trial, r);
+    }
+
+    if(space == trial.end()) {
+        return false;
+    }
+
+    // Regions outside the space weren't merged into it, so freeing only
+    // the ones inside usually makes the same space. It may not if one of
+    // them merges with a free rect another candidate took in the trial,
+    // so check, and evict all the tried ones if it doesn't.
+    std::vector<int> victims;
+    auto target = *space;
+    for(size_t i=0;i<n;++i) {
+        if(contains(target, regions[candidates[i]-1])) {
+            victims.push_back(candidates[i]);
+        }
+    }
+
+    trial = freeRects;
+    for(auto region : victims) {
+        freeRect(trial, regions[region-1]);
+    }
+    if(bestFreeRect(trial, r) == trial.end()) {
+        victims.assign(candidates.begin(), candidates.begin() + n);
+    }
+
+    for(auto region : victims) {
+        auto& old = regions[region-1];
+        areaUsed -= old.w * old.h;
+        freeRect(freeRects, old);
+        old = stbrp_rect{};
+        freeRegions.push_back(region);
+        evicted.push_back(region);
+    }
+
+    auto placed = [self placeInFreeRect:r];
+    assert(placed);
+    return placed;
+}
+
+// Add any new textures, evicting old ones or adding pages if necessary.
 - (void) update:(id<MTLCommandBuffer>) buffer {
 
+    VGER_TRACE_ZONE("vgerTextureManager update");
+
+    evicted.clear();
+
     if(newTextures.count) {
 
-        // Pack new regions.
-        std::vector<stbrp_rect> newRegions;
-        for(id<MTLTexture> tex in newTextures) {
-            stbrp_rect r;
-            r.w = tex.width;
-            r.h = tex.height;
-            newRegions.push_back(r);
-            areaUsed += r.w*r.h;
+        auto n = int(newTextures.count);
+        std::vector<stbrp_rect> rects(n);
+        std::vector<int> order(n);
+        for(int i=0;i<n;++i) {
+            rects[i].w = int(newTextures[i].width);
+            rects[i].h = int(newTextures[i].height);
+            order[i] = i;
+        }
+
+        // Tallest first, as stbrp_pack_rects does.
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return rects[a].h > rects[b].h;
+        });
+
+        auto pageCount = pages.size();
+
+        // Reuse evicted rects first, since the skyline packer can't. Only
+        // evict when that makes room (evictFor checks first), so pages
+        // are added rather than evicting regions which don't help.
+        for(auto i : order) {
+            auto& r = rects[i];
+            if([self placeInFreeRect:r] or [self pack:r] or [self evictFor:r]) {
+                continue;
+            }
+            if(pages.size() < ATLAS_MAX_PAGES) {
+                pages.push_back(std::make_unique<Page>());
+                if([self pack:r]) {
+                    continue;
+                }
+            }
+            _failedCount++;
         }
 
-        if(stbrp_pack_rects(&ctx, newRegions.data(), int(newRegions.size()))) {
+        auto e = [buffer blitCommandEncoder];
 
-            auto e = [buffer blitCommandEncoder];
-            for(int i=0;i<newRegions.size();++i) {
-                auto r = newRegions[i];
-                auto tex = newTextures[i];
-                assert(tex);
-                [e copyFromTexture:tex
-                       sourceSlice:0
+        if(pages.size() > pageCount) {
+            // Texture arrays can't grow, so copy to a bigger one.
+            auto old = self.atlas;
+            atlasDesc.arrayLength = pages.size();
+            _atlas = [_device newTextureWithDescriptor:atlasDesc];
+            assert(self.atlas);
+            for(int page=0;page<int(pageCount);++page) {
+                [e copyFromTexture:old
+                       sourceSlice:page
                        sourceLevel:0
-                      sourceOrigin:MTLOriginMake(0, 0, 0)
-                        sourceSize:MTLSizeMake(tex.width, tex.height, 1)
                          toTexture:self.atlas
-                  destinationSlice:0
+                  destinationSlice:page
                   destinationLevel:0
-                 destinationOrigin:MTLOriginMake(r.x, r.y, 0)];
-                regions.push_back(r);
+                        sliceCount:1
+                        levelCount:1];
             }
-            [e endEncoding];
+        }
 
+        for(int i=0;i<n;++i) {
+            auto r = rects[i];
+            if(!r.was_packed) {
+                continue;
+            }
+            auto tex = newTextures[i];
+            assert(tex);
+            [e copyFromTexture:tex
+                   sourceSlice:0
+                   sourceLevel:0
+                  sourceOrigin:MTLOriginMake(0, 0, 0)
+                    sourceSize:MTLSizeMake(tex.width, tex.height, 1)
+                     toTexture:self.atlas
+              destinationSlice:r.id
+              destinationLevel:0
+             destinationOrigin:MTLOriginMake(r.x, r.y, 0)];
+            areaUsed += r.w*r.h;
+            regions[newRegions[i]-1] = r;
         }
+        [e endEncoding];
 
         [newTextures removeAllObjects];
+        newRegions.clear();
     }
+
+    _evictedCount = int(evicted.size());
 }
 
 /// Get a pointer to the first rectangle.
@@ -117,8 +394,16 @@
     return regions.data();
 }
 
+- (const int*) getEvictedRegions {
+    return evicted.data();
+}
+
 - (float) usage {
-    return float(areaUsed) / (ATLAS_SIZE*ATLAS_SIZE);
+    return float(areaUsed) / (float(ATLAS_SIZE*ATLAS_SIZE) * pages.size());
+}
+
+- (int) pageCount {
+    return int(pages.size());
 }
 
 @end
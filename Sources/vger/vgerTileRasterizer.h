@@ -0,0 +1,86 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include <vector>
+#include "paint.h"
+
+/// Fills paths on the CPU by binning their segments into screen tiles.
+///
+/// Each tile gets the segments which touch it, plus a backdrop from the
+/// segments to its right which gives the inside/outside parity of each
+/// pixel row. Tiles no segment touches are filled from the backdrop alone,
+/// so the cost of a fill is proportional to the tiles it covers rather than
+/// to the area of its slabs.
+///
+/// Doesn't depend on Metal.
+struct vgerTileRasterizer {
+
+    static constexpr int TileSize = 16;
+
+    struct Path {
+        vgerPaint paint;
+
+        /// Maps pixel coordinates to the space the paint is defined in.
+        vgerAffine pixelToLocal;
+
+        /// Range of segments in cvs (three cvs per segment).
+        int start;
+        int count;
+
+        /// Bounds of the control vertices.
+        simd_float2 min, max;
+    };
+
+    /// Paths to render, in order.
+    std::vector<Path> paths;
+
+    /// Quadratic segments, in pixel coordinates (y down).
+    std::vector<simd_float2> cvs;
+
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+
+    /// Non-premultiplied RGBA, top row first.
+    std::vector<simd_float4> pixels;
+
+    /// Number of segments binned to each tile by the last render, summed
+    /// over paths. For debugging.
+    std::vector<uint32_t> tileSegmentCounts;
+
+    /// A segment overlapping a row of tiles.
+    struct RowSegment {
+        simd_float2 a, b, c;
+
+        /// x extent, fattened as in vgerPathScanner.
+        float xmin, xmax;
+
+        /// Index in paths.
+        int path;
+    };
+
+    /// Segments binned into tile rows by render, kept between renders to
+    /// avoid allocating. Row ty's are rowSegments[rowStart[ty],
+    /// rowStart[ty+1]), in path order.
+    std::vector<RowSegment> rowSegments;
+    std::vector<uint32_t> rowStart;
+    std::vector<uint32_t> rowFill;
+
+    /// Active segments of each row during render, at the same offsets as
+    /// rowSegments.
+    std::vector<uint32_t> active;
+
+    /// Resize, clear to transparent and remove all paths.
+    void clear(int width, int height);
+
+    /// Add a path. Only color and gradient paints are supported.
+    void addPath(const simd_float2* cvs, int segmentCount, const vgerPaint& paint, const vgerAffine& pixelToLocal);
+
+    /// Render all paths, blending over what's already there.
+    void render();
+
+    /// Copy the pixels out as 8-bit RGBA (or BGRA), top row first.
+    void getPixels(uint8_t* out, int bytesPerRow, bool bgra) const;
+};
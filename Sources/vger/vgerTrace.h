@@ -0,0 +1,33 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+/// Trace zones time a scope and record it for vgerWriteTrace. They're
+/// compiled out unless VGER_TRACING is defined, which Package.swift does
+/// for debug builds.
+#ifdef VGER_TRACING
+
+/// Each thread keeps this many of its most recent events until they're
+/// written. Older ones are dropped (and counted in the trace's otherData).
+constexpr int vgerTraceEventsPerThread = 16384;
+
+struct vgerTraceZone {
+    const char* name;
+    uint64_t start;
+
+    /// name must be a string literal (it isn't copied).
+    vgerTraceZone(const char* name);
+    ~vgerTraceZone();
+};
+
+#define VGER_TRACE_CONCAT2(a, b) a##b
+#define VGER_TRACE_CONCAT(a, b) VGER_TRACE_CONCAT2(a, b)
+#define VGER_TRACE_ZONE(name) vgerTraceZone VGER_TRACE_CONCAT(_vgerTraceZone, __LINE__)(name)
+
+#else
+
+#define VGER_TRACE_ZONE(name)
+
+#endif
@@ -5,55 +5,64 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <memory>
+#include <chrono>
 #include "vgerPathScanner.h"
 #include "vgerGlyphPathCache.h"
 #include "vgerScene.h"
+#include "vgerTileRasterizer.h"
+#include "vgerRecorder.h"
+#include "vgerSceneFile.h"
+#include "vgerTrace.h"
 #include "paint.h"
+#include "vgerTextLayout.h"
 
 @class vgerRenderer;
 @class vgerGlyphCache;
 
-/// For caching the layout of strings.
-struct TextLayoutInfo {
-    /// The frame in which the string was last rendered. If not the current frame,
-    /// then the string is pruned from the cache.
-    uint64_t lastFrame = 0;
-
-    /// Prims are copied to output.
+/// Scanner output for a retained path (see vgerCreatePath).
+struct RetainedPath {
+    std::vector<float2> cvs;
     std::vector<vgerPrim> prims;
-};
 
-struct TextLayoutKey {
-    std::string str;
-    float size;
-    int align;
-    float breakRowWidth = -1;
-
-    friend bool operator==(const TextLayoutKey&, const TextLayoutKey&) = default;
-    friend bool operator!=(const TextLayoutKey&, const TextLayoutKey&) = default;
-};
+    /// For scanning again when filled at a smaller scale.
+    std::vector<vgerPathScanner::Segment> segments;
 
-inline void hash_combine(size_t& seed) { }
+    /// Pixel size in path coordinates the prims were scanned for.
+    float filterWidth = 0;
 
-template <typename T, typename... Rest>
-inline void hash_combine(size_t& seed, const T& v, Rest... rest) {
-    std::hash<T> hasher;
-    seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
-    hash_combine(seed, rest...);
-}
+    /// In freePaths, so deleting again does nothing.
+    bool freed = false;
+};
 
-#define MAKE_HASHABLE(Type, ...) \
-namespace std {\
-    template<> struct hash<Type> {\
-        size_t operator()(const Type &t) const {\
-            size_t ret = 0;\
-            hash_combine(ret, __VA_ARGS__);\
-            return ret;\
-        }\
-    };\
-}
+/// Field-wise hash for interning paints. Padding isn't hashed.
+struct PaintHash {
+    size_t operator()(const vgerPaint& p) const {
+        size_t h = 0;
+        hash_combine(h, int(p.type), p.image, p.flipY, p.glow, p.innerRadius, p.outerRadius);
+        for(int i=0;i<3;++i) {
+            auto c = p.xform.columns[i];
+            hash_combine(h, c.x, c.y);
+        }
+        hash_combine(h, p.innerColor.x, p.innerColor.y, p.innerColor.z, p.innerColor.w);
+        hash_combine(h, p.outerColor.x, p.outerColor.y, p.outerColor.z, p.outerColor.w);
+        return h;
+    }
+};
 
-MAKE_HASHABLE(TextLayoutKey, t.str, t.size, t.align, t.breakRowWidth);
+struct PaintEqual {
+    bool operator()(const vgerPaint& a, const vgerPaint& b) const {
+        return a.type == b.type and
+               a.image == b.image and
+               a.flipY == b.flipY and
+               a.glow == b.glow and
+               a.innerRadius == b.innerRadius and
+               a.outerRadius == b.outerRadius and
+               simd_equal(a.xform, b.xform) and
+               simd_all(a.innerColor == b.innerColor) and
+               simd_all(a.outerColor == b.outerColor);
+    }
+};
 
 /// Main state object. This is not ObjC to avoid call overhead for each prim.
 struct vger {
@@ -64,7 +73,16 @@ struct vger {
     vgerRenderer* glowRenderer;
 
     /// Transform matrix stack.
-    std::vector<float3x3> txStack;
+    std::vector<vgerAffine> txStack;
+
+    static constexpr uint32_t NoXform = UINT32_MAX;
+
+    /// Index of txStack.back() in the current scene's xforms, or NoXform
+    /// if it has changed since it was last added.
+    uint32_t xformIndex = NoXform;
+
+    /// Saved xformIndex for each entry of txStack below the top.
+    std::vector<uint32_t> xformIndexStack;
 
     /// Number of buffers.
     int maxBuffers = 1;
@@ -108,12 +126,69 @@ struct vger {
     /// Content scale factor.
     float devicePxRatio = 1.0;
 
+    /// Render text with distance field glyphs.
+    bool sdfGlyphs = false;
+
+    /// See vgerGlyphRasterMode.
+    vgerGlyphRasterMode glyphRasterMode = VGER_GLYPHS_SYNC;
+
     /// For speeding up path rendering.
     vgerPathScanner yScanner;
 
+    /// Width of the tiles path fill slabs are split into, in local
+    /// coordinates. Zero disables tiling.
+    float pathTileWidth = 64;
+
+    /// Maximum distance in pixels between a cubic passed to vgerCubicTo
+    /// and the quadratics it's converted to.
+    float cubicTolerance = 0.25;
+
+    /// A path queued by fillForTile.
+    struct TileFill {
+        vgerPaintIndex paint;
+        vgerAffine xform;
+
+        /// Range of segments in tileFillCVs.
+        int start;
+        int count;
+    };
+
+    /// Paths to render with encodeTileRender.
+    std::vector<TileFill> tileFills;
+    std::vector<float2> tileFillCVs;
+
+    /// For rendering tileFills.
+    vgerTileRasterizer tileRasterizer;
+
+    /// Scratch for encodeTileRender, kept to avoid allocating each frame.
+    std::vector<float2> tilePixelCVs;
+    std::vector<uint8_t> tileCounts;
+
+    /// Pixels from tileRasterizer, for copying to the render texture.
+    id<MTLBuffer> tileStagingBuffers[3];
+
+    /// Segments per tile from the last encodeTileRender (R8).
+    id<MTLTexture> coarseDebugTexture;
+
     /// For generating glyph paths.
     vgerGlyphPathCache glyphPathCache;
 
+    /// Paths created with vgerCreatePath. Index 0 is used to indicate errors.
+    std::vector<RetainedPath> retainedPaths;
+
+    /// Indices of deleted retained paths, for reuse.
+    std::vector<uint32_t> freePaths;
+
+    /// Scenes loaded with vgerLoadScene. Index 0 is used to indicate errors.
+    std::vector<vgerStaticScene> staticScenes;
+
+    /// Indices of deleted static scenes, for reuse.
+    std::vector<uint32_t> freeStaticScenes;
+
+    /// Scanner output scratch space (avoid malloc).
+    std::vector<vgerPrim> fillPrims;
+    std::vector<float2> fillCVs;
+
     /// The current location when creating paths.
     float2 pen;
 
@@ -134,8 +209,11 @@ struct vger {
 
     vger(uint32_t flags, MTLPixelFormat pixelFormat);
 
-    void addPrim(const vgerPrim& prim) {
-        scenes[currentScene].prims[currentLayer].append(prim);
+    /// Encodes a prim into the current layer. Bezier cvs are moved to the
+    /// cv buffer. aux is the piece index for vgerRectStroke.
+    void addPrim(const vgerPrim& prim, uint32_t aux = 0) {
+        scenes[currentScene].addPrim(currentLayer, prim, aux);
+        ++stats.prims[currentLayer][prim.type];
     }
 
     auto primCount() -> size_t {
@@ -146,16 +224,72 @@ struct vger {
         scenes[currentScene].cvs.append(p);
     }
 
-    uint32_t addxform(const matrix_float3x3& M) {
+    /// Size of a pixel in local coordinates under the current transform.
+    float filterWidth();
+
+    /// Scans a retained path's segments into its prims.
+    void scanPath(RetainedPath& path, float filterWidth);
+
+    uint32_t addxform(const vgerAffine& M) {
         uint32_t idx = (uint32_t) scenes[currentScene].xforms.count;
         scenes[currentScene].xforms.append(M);
         return idx;
     }
 
+    /// Index of the current transform, added to the scene only if it
+    /// changed since the last prim.
+    uint32_t currentXform() {
+        if(xformIndex == NoXform) {
+            xformIndex = addxform(txStack.back());
+        }
+        return xformIndex;
+    }
+
+    /// Paints added this frame, so identical paints share an index.
+    std::unordered_map<vgerPaint, uint32_t, PaintHash, PaintEqual> paintTable;
+
+    /// Paints which persist across frames (see vgerRetainPaint). They're
+    /// copied to the front of the paint buffer by begin, so their indices
+    /// don't change.
+    std::vector<vgerPaint> retainedPaints;
+
+    /// Released slots in retainedPaints.
+    std::vector<uint32_t> freePaints;
+
+    /// Whether each slot in retainedPaints is in freePaints, so releasing
+    /// again does nothing.
+    std::vector<bool> paintFreed;
+
+    /// Number of slots at the front of this frame's paint buffer reserved
+    /// for retained paints.
+    uint32_t retainedPaintSlots = 0;
+
+    /// API calls are recorded here between vgerBeginRecording and
+    /// vgerEndRecording.
+    std::unique_ptr<vgerRecorder> recorder;
+
+    /// Nesting depth of API calls, so calls made by other API functions
+    /// (e.g. vgerBegin calling vgerFillRect) aren't recorded.
+    int recordDepth = 0;
+
+    /// Statistics for the current frame (see vgerGetStats).
+    vgerStats stats = {};
+
     vgerPaintIndex addPaint(const vgerPaint& paint) {
-        uint32_t idx = (uint32_t) scenes[currentScene].paints.count;
-        scenes[currentScene].paints.append(paint);
-        return {idx};
+        auto [iter, inserted] = paintTable.try_emplace(paint, uint32_t(scenes[currentScene].paints.count));
+        if(inserted) {
+            scenes[currentScene].paints.append(paint);
+        }
+        return {iter->second};
+    }
+
+    vgerPaintIndex retainPaint(vgerPaintIndex paint);
+
+    void releasePaint(vgerPaintIndex paint);
+
+    /// Is paint a slot in retainedPaints which hasn't been released?
+    bool isRetainedPaint(vgerPaintIndex paint) const {
+        return paint.index < retainedPaints.size() and !paintFreed[paint.index];
     }
 
     /// Ensure a paint index is valid.
@@ -168,8 +302,21 @@ struct vger {
 
     void begin(float windowWidth, float windowHeight, float devicePxRatio);
 
+    /// Applies glyphRasterMode to the glyph cache.
+    void setupGlyphCache();
+
     bool fill(vgerPaintIndex paint);
 
+    /// Adds prims from vgerPathScanner::scanPrims with the given paint and
+    /// transform, along with their cvs.
+    void addPathPrims(const std::vector<vgerPrim>& prims, const std::vector<float2>& cvs, vgerPaintIndex paint, uint32_t xform);
+
+    vgerPathIndex createPath();
+
+    void fillPath(vgerPathIndex path, vgerPaintIndex paint);
+
+    void deletePath(vgerPathIndex path);
+
     void fillForTile(vgerPaintIndex paint);
 
     void encode(id<MTLCommandBuffer> buf, MTLRenderPassDescriptor* pass, bool glow);
@@ -189,13 +336,42 @@ struct vger {
     void renderGlyphPath(CGGlyph glyph, vgerPaintIndex paint, float2 position, uint32_t xform);
 };
 
+/// Declared at the start of each recordable API function. Only the
+/// outermost call is recorded.
+struct vgerRecordScope {
+    vger* vg;
+    bool outermost;
+
+    vgerRecordScope(vger* vg) : vg(vg), outermost(vg->recordDepth++ == 0) { }
+    ~vgerRecordScope() { vg->recordDepth--; }
+
+    template<class... Args>
+    void record(vgerOp op, const Args&... args) {
+        if(outermost and vg->recorder) {
+            vg->recorder->record(op, args...);
+        }
+    }
+};
+
+/// Adds the time until the end of the scope to one of the vgerStats
+/// times, in milliseconds.
+struct vgerStatTimer {
+    double& ms;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    vgerStatTimer(double& ms) : ms(ms) { }
+    ~vgerStatTimer() {
+        ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
 inline vgerPaint makeLinearGradient(float2 start,
                                     float2 end,
                                     float4 innerColor,
                                     float4 outerColor,
                                     float glow) {
     
-    vgerPaint p;
+    vgerPaint p = {};
     p.type = vgerPaintTypeLinearGradient;
 
     // Calculate transform aligned to the line
@@ -204,10 +380,10 @@ inline vgerPaint makeLinearGradient(float2 start,
         d = float2{0,1};
     }
 
-    p.xform = inverse(float3x3{
-        float3{d.x, d.y, 0},
-        float3{-d.y, d.x, 0},
-        float3{start.x, start.y, 1}
+    p.xform = affineInverse(vgerAffine{
+        float2{d.x, d.y},
+        float2{-d.y, d.x},
+        float2{start.x, start.y}
     });
 
     p.innerColor = innerColor;
@@ -225,14 +401,14 @@ inline vgerPaint makeRadialGradient(float2 center,
                                     float4 outerColor,
                                     float glow) {
 
-    vgerPaint p;
+    vgerPaint p = {};
     p.type = vgerPaintTypeRadialGradient;
 
-    p.xform = inverse(float3x3{
-        float3{1, 0, 0},
-        float3{0, 1, 0},
-        float3{center.x, center.y, 1}
-    });
+    p.xform = vgerAffine{
+        float2{1, 0},
+        float2{0, 1},
+        float2{-center.x, -center.y}
+    };
 
     p.innerRadius = innerRadius;
     p.outerRadius = outerRadius;
@@ -251,24 +427,24 @@ inline vgerPaint makeImagePattern(float2 origin,
                                   vgerImageIndex image,
                                   float alpha) {
 
-    vgerPaint p;
+    vgerPaint p = {};
     p.type  = vgerPaintTypeImagePattern;
     p.image = image.index;
     p.flipY = flipY;
 
-    float3x3 R = {
-        float3{ cosf(angle), sinf(angle), 0 },
-        float3{ -sinf(angle), cosf(angle), 0 },
-        float3{ -origin.x, -origin.y, 1}
+    vgerAffine R = {
+        float2{ cosf(angle), sinf(angle) },
+        float2{ -sinf(angle), cosf(angle) },
+        float2{ -origin.x, -origin.y }
     };
 
-    float3x3 S = {
-        float3{ 1/size.x, 0, 0 },
-        float3{ 0, 1/size.y, 0},
-        float3{ 0, 0, 1}
+    vgerAffine S = {
+        float2{ 1/size.x, 0 },
+        float2{ 0, 1/size.y },
+        float2{ 0, 0 }
     };
 
-    p.xform = matrix_multiply(S, R);
+    p.xform = affineCompose(S, R);
 
     p.innerColor = p.outerColor = float4{1,1,1,alpha};
     p.glow = 0;
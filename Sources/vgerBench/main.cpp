@@ -0,0 +1,360 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+// Benchmarks for the CPU side of vger. They only use the portable code
+// (vgerCore and headers), so they also run on Linux. The benchmarks which
+// need Metal are in vgerMetalBench, which takes the same flags.
+//
+//     swift run -c release vgerBench [--benchmark_filter=<regex>]
+//         [--benchmark_format=console|json] [--benchmark_out=<file>]
+//         [--benchmark_min_time=<seconds>] [--svg=<file>] [--svg_dir=<dir>]
+//         [--font=<ttf>]
+//
+// Flags and JSON output follow Google Benchmark, so its tools (e.g.
+// compare.py) can be used to track results.
+
+#include "../vger/include/vger.h"
+#include "../vger/vgerBasicScene.h"
+#include "../vger/vgerPathScanner.h"
+#include "../vger/vgerTextLayout.h"
+#include "../vger/bezier.h"
+#include "../vger/sdf.h"
+#include "../vger/sdf_batch.h"
+#include "../vger/vgerFont.h"
+#include "../vger/vgerGlyphRasterizer.h"
+#include "../vger/vgerCPURenderer.h"
+#include "bench.h"
+#include "nanosvg.h"
+#include <stdio.h>
+#include <math.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace simd;
+
+#pragma mark - Inputs
+
+/// A star with n points, as quadratic segments.
+static std::vector<vgerPathScanner::Segment> makeStar(int n) {
+    std::vector<vgerPathScanner::Segment> segments;
+    auto point = [n](int i) {
+        float r = (i % 2) ? 100 : 250;
+        float a = 2 * M_PI * i / (2 * n);
+        return float2{256 + r * cosf(a), 256 + r * sinf(a)};
+    };
+    for(int i=0;i<2*n;++i) {
+        auto a = point(i), c = point(i+1);
+        segments.push_back({a, (a + c) / 2, c});
+    }
+    return segments;
+}
+
+/// Segments for each shape of an SVG, made as vgerCubicApproxTo does.
+static std::vector<std::vector<vgerPathScanner::Segment>> loadSVG(const char* path) {
+    std::vector<std::vector<vgerPathScanner::Segment>> shapes;
+
+    auto image = nsvgParseFromFile(path, "px", 96);
+    if(!image) {
+        return shapes;
+    }
+
+    for(auto shape = image->shapes; shape; shape = shape->next) {
+        std::vector<vgerPathScanner::Segment> segments;
+        for(auto p = shape->paths; p; p = p->next) {
+            auto pts = (float2*) p->pts;
+            auto pen = pts[0];
+            for(int i=1; i<p->npts-2; i+=3) {
+                float2 cubic[4] = {pen, pts[i], pts[i+1], pts[i+2]};
+                float2 q[6];
+                approx_cubic(cubic, q);
+                segments.push_back({q[0], q[1], q[2]});
+                segments.push_back({q[3], q[4], q[5]});
+                pen = pts[i+2];
+            }
+        }
+        if(segments.size()) {
+            shapes.push_back(segments);
+        }
+    }
+
+    nsvgDelete(image);
+    return shapes;
+}
+
+/// Scanner and output, kept between runs like vger's, so the timed runs
+/// don't include growing them.
+struct ScanBuffers {
+    vgerPathScanner scan;
+    std::vector<vgerPrim> prims;
+    std::vector<float2> cvs;
+};
+
+/// Scans segments as vger::fill does.
+static size_t scanSegments(ScanBuffers& b, const std::vector<vgerPathScanner::Segment>& segments) {
+    b.prims.clear();
+    b.cvs.clear();
+    b.scan.segments = segments;
+    b.scan._init();
+    b.scan.scanPrims(0, 1, b.prims, b.cvs);
+    return b.prims.size();
+}
+
+/// Rasterizer and output, kept between runs.
+struct RasterBuffers {
+    vgerGlyphRasterizer rasterizer;
+    std::vector<vgerFontQuad> quads;
+    std::vector<uint8_t> image;
+};
+
+/// Rasterizes a glyph at pixelSize pixels per em as vgerGlyphCache does
+/// with vgerGlyphRasterizer, margin included. Returns false for glyphs
+/// without outlines.
+static bool rasterizeGlyph(const vgerFont& font, RasterBuffers& b, uint32_t glyph, float pixelSize) {
+
+    constexpr int margin = 4;
+
+    vgerGlyphBox box;
+    b.quads.clear();
+    if(!font.glyphBox(glyph, &box) or !font.glyphOutline(glyph, b.quads)) {
+        return false;
+    }
+
+    float s = pixelSize / font.unitsPerEm();
+    int width = ceilf((box.xMax - box.xMin) * s) + 2*margin;
+    int height = ceilf((box.yMax - box.yMin) * s) + 2*margin;
+    b.image.resize(width*height);
+
+    b.rasterizer.rasterize(b.quads, s, {margin - box.xMin * s, margin - box.yMin * s},
+                           width, height, b.image.data(), width);
+    return true;
+}
+
+#pragma mark - Benchmarks
+
+/// Inputs are made here, outside the timed runs. Benchmarks share their
+/// buffers between runs, so the warm-up run grows them.
+static std::vector<Benchmark> makeBenchmarks(const BenchFlags& flags) {
+
+    std::vector<Benchmark> benchmarks;
+
+    auto scene = std::make_shared<vgerHeapScene>();
+    benchmarks.push_back({"RecordPrims/1000000", [scene](BenchState& state) {
+        int n = 1000000;
+        for(int64_t it=0;it<state.iterations;++it) {
+            scene->clear();
+            for(int i=0;i<n;++i) {
+                vgerPrim prim = {
+                    .type = (i % 3 == 0) ? vgerBezier : ((i % 3 == 1) ? vgerRect : vgerCircle),
+                    .width = 1,
+                    .radius = 2,
+                    .cvs = { float2{float(i % 512), float(i / 512)}, float2{float(i % 512) + 8, 4}, float2{0, 8} },
+                    .xform = uint32_t(i / 16)
+                };
+                scene->addPrim(0, prim);
+            }
+            doNotOptimize(scene->prims[0].count);
+        }
+        state.itemsProcessed = state.iterations * n;
+    }});
+
+    auto buffers = std::make_shared<ScanBuffers>();
+
+    for(int n : {16, 1024}) {
+        auto segments = makeStar(n);
+        benchmarks.push_back({"PathScanner/star/" + std::to_string(n), [segments, buffers](BenchState& state) {
+            for(int64_t it=0;it<state.iterations;++it) {
+                doNotOptimize(scanSegments(*buffers, segments));
+            }
+            state.itemsProcessed = state.iterations * segments.size();
+        }});
+    }
+
+    auto shapes = loadSVG(flags.svgPath);
+    if(shapes.size()) {
+        size_t segmentCount = 0;
+        for(auto& s : shapes) {
+            segmentCount += s.size();
+        }
+        benchmarks.push_back({"PathScanner/svg", [shapes, segmentCount, buffers](BenchState& state) {
+            for(int64_t it=0;it<state.iterations;++it) {
+                for(auto& s : shapes) {
+                    doNotOptimize(scanSegments(*buffers, s));
+                }
+            }
+            state.itemsProcessed = state.iterations * segmentCount;
+        }});
+
+        // Items are pixels. The scene is recorded once, as vger::fill does,
+        // into a heap scene, so this runs without a GPU.
+        auto svgScene = std::make_shared<vgerHeapScene>();
+        svgScene->xforms.append(affineIdentity());
+        vgerPaint paint = {.type = vgerPaintTypeLinearGradient, .xform = affineIdentity(),
+                           .innerColor = float4{0.8, 0.5, 0.2, 0.9}, .outerColor = float4{0.8, 0.5, 0.2, 0.9},
+                           .image = -1};
+        svgScene->paints.append(paint);
+        for(auto& s : shapes) {
+            scanSegments(*buffers, s);
+            auto start = uint32_t(svgScene->cvs.count);
+            svgScene->cvs.append(buffers->cvs.data(), buffers->cvs.size());
+            for(auto prim : buffers->prims) {
+                prim.start += start;
+                svgScene->addPrim(0, prim);
+            }
+        }
+        auto renderer = std::make_shared<vgerCPURenderer>();
+        benchmarks.push_back({"CPURender/svg/1920x1080", [svgScene, renderer](BenchState& state) {
+            for(int64_t it=0;it<state.iterations;++it) {
+                renderer->clear(1920, 1080);
+                renderer->render(*svgScene, 0, float2{960, 540});
+                doNotOptimize(renderer->pixels.data());
+            }
+            state.itemsProcessed = state.iterations * 1920 * 1080;
+        }});
+    } else {
+        fprintf(stderr, "vgerBench: couldn't load %s, skipping PathScanner/svg\n", flags.svgPath);
+    }
+
+    benchmarks.push_back({"SubdivideBezierForStroke", [](BenchState& state) {
+        std::vector<vgerBezierSegment> segments;
+        int n = 1000;
+        for(int64_t it=0;it<state.iterations;++it) {
+            for(int i=0;i<n;++i) {
+                segments.clear();
+                float t = i * 0.01f;
+                subdivideBezierForStroke({float2{0, 0}, float2{200 * cosf(t), 300}, float2{400, 0}}, 2, segments);
+                doNotOptimize(segments.size());
+            }
+        }
+        state.itemsProcessed = state.iterations * n;
+    }});
+
+    benchmarks.push_back({"ApproxCubic", [](BenchState& state) {
+        int n = 10000;
+        for(int64_t it=0;it<state.iterations;++it) {
+            for(int i=0;i<n;++i) {
+                float x = i;
+                float2 cubic[4] = {float2{x, 0}, float2{x + 1, 2}, float2{x + 3, 2}, float2{x + 4, 0}};
+                float2 q[6];
+                approx_cubic(cubic, q);
+                doNotOptimize(q[2]);
+            }
+        }
+        state.itemsProcessed = state.iterations * n;
+    }});
+
+    // Items are quadratics emitted, so the rate is segments per second.
+    for(float tolerance : {1.0f, 0.25f, 0.01f}) {
+        char name[64];
+        snprintf(name, sizeof(name), "ApproxCubicAdaptive/%g", tolerance);
+        benchmarks.push_back({name, [tolerance](BenchState& state) {
+            int n = 10000;
+            int64_t quads = 0;
+            for(int64_t it=0;it<state.iterations;++it) {
+                for(int i=0;i<n;++i) {
+                    float x = i;
+                    float2 cubic[4] = {float2{x, 0}, float2{x + 100, 300}, float2{x + 300, -200}, float2{x + 400, 100}};
+                    quads += approx_cubic_adaptive(cubic, tolerance, [](float2 q, float2 end) {
+                        doNotOptimize(q);
+                    });
+                }
+            }
+            state.itemsProcessed = quads;
+            state.counters["quads_per_cubic"] = double(quads) / (state.iterations * n);
+        }});
+    }
+
+    std::unordered_map<TextLayoutKey, TextLayoutInfo> textCache;
+    std::vector<TextLayoutKey> keys;
+    for(int i=0;i<1000;++i) {
+        keys.push_back(TextLayoutKey{"label " + std::to_string(i), 2.0f, VGER_ALIGN_LEFT});
+        textCache[keys.back()].prims.resize(8);
+    }
+    benchmarks.push_back({"TextCacheLookup", [cache = std::move(textCache), keys](BenchState& state) {
+        for(int64_t it=0;it<state.iterations;++it) {
+            for(auto& key : keys) {
+                doNotOptimize(cache.find(key)->second.prims.size());
+            }
+        }
+        state.itemsProcessed = state.iterations * keys.size();
+    }});
+
+    // Items are glyphs. Each iteration rasterizes every glyph in the font.
+    // vgerMetalBench has GlyphRaster/coregraphics, for comparison.
+    auto font = std::make_shared<vgerFont>();
+    if(font->loadFile(flags.fontPath)) {
+        auto raster = std::make_shared<RasterBuffers>();
+        for(int size : {12, 24, 48}) {
+            benchmarks.push_back({"GlyphRaster/portable/" + std::to_string(size), [font, raster, size](BenchState& state) {
+                int64_t glyphs = 0;
+                for(int64_t it=0;it<state.iterations;++it) {
+                    for(int g=0;g<font->glyphCount();++g) {
+                        glyphs += rasterizeGlyph(*font, *raster, g, size);
+                        doNotOptimize(raster->image.data());
+                    }
+                }
+                state.itemsProcessed = glyphs;
+            }});
+        }
+    } else {
+        fprintf(stderr, "vgerBench: couldn't load %s, skipping GlyphRaster\n", flags.fontPath);
+    }
+
+    benchmarks.push_back({"SDF/bezier", [](BenchState& state) {
+        int n = 64;
+        for(int64_t it=0;it<state.iterations;++it) {
+            float sum = 0;
+            for(int y=0;y<n;++y) {
+                for(int x=0;x<n;++x) {
+                    sum += sdBezier(float2{float(x), float(y)}, float2{0, 0}, float2{32, 64}, float2{64, 0});
+                }
+            }
+            doNotOptimize(sum);
+        }
+        state.itemsProcessed = state.iterations * n * n;
+    }});
+
+    // Unsigned distance to the curve in SDF/bezier, 16 points at a time.
+    benchmarks.push_back({"SDF/bezierBatch", [](BenchState& state) {
+        int n = 64;
+        for(int64_t it=0;it<state.iterations;++it) {
+            simd_float16 sum = {};
+            for(int y=0;y<n;++y) {
+                for(int x=0;x<n;x+=16) {
+                    auto px = rampN<simd_float16>(x, 1);
+                    auto py = splatN<simd_float16>(y);
+                    sum += udBezierN(px, py, float2{0, 0}, float2{32, 64}, float2{64, 0});
+                }
+            }
+            doNotOptimize(sum[0]);
+        }
+        state.itemsProcessed = state.iterations * n * n;
+    }});
+
+    benchmarks.push_back({"SDF/prims", [](BenchState& state) {
+        vgerPrim prims[3] = {
+            {.type = vgerCircle, .radius = 20, .cvs = {float2{32, 32}}},
+            {.type = vgerRect, .radius = 4, .cvs = {float2{8, 8}, float2{56, 40}}},
+            {.type = vgerSegment, .width = 2, .cvs = {float2{0, 0}, float2{64, 64}}},
+        };
+        int n = 64;
+        for(int64_t it=0;it<state.iterations;++it) {
+            float sum = 0;
+            for(auto& prim : prims) {
+                for(int y=0;y<n;++y) {
+                    for(int x=0;x<n;++x) {
+                        sum += sdPrim(prim, nullptr, float2{float(x), float(y)});
+                    }
+                }
+            }
+            doNotOptimize(sum);
+        }
+        state.itemsProcessed = state.iterations * 3 * n * n;
+    }});
+
+    return benchmarks;
+}
+
+int main(int argc, const char* argv[]) {
+    return benchMain(argc, argv, makeBenchmarks);
+}
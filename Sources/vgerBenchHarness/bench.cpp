@@ -0,0 +1,193 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <regex>
+
+static double seconds(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/// Increases the iteration count until a run takes at least minTime. The
+/// first run is a warm-up, which may include lazy setup, so it isn't
+/// reported.
+static BenchResult runBenchmark(const Benchmark& bench, double minTime) {
+
+    int64_t iterations = 1;
+    bool warmup = true;
+
+    while(true) {
+        BenchState state{iterations};
+
+        auto realStart = seconds(CLOCK_MONOTONIC);
+        auto cpuStart = seconds(CLOCK_PROCESS_CPUTIME_ID);
+        bench.run(state);
+        auto real = seconds(CLOCK_MONOTONIC) - realStart;
+        auto cpu = seconds(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+
+        if(warmup) {
+            warmup = false;
+            continue;
+        }
+
+        if(real >= minTime or iterations >= 1000000000) {
+            return {
+                bench.name,
+                iterations,
+                real * 1e9 / iterations,
+                cpu * 1e9 / iterations,
+                state.itemsProcessed / real,
+                state.counters
+            };
+        }
+
+        // Aim a little past minTime, growing by at most 10x.
+        auto scale = real > 0 ? 1.4 * minTime / real : 10.0;
+        iterations = std::max(iterations + 1, int64_t(iterations * std::min(scale, 10.0)));
+    }
+}
+
+static void printConsole(const std::vector<BenchResult>& results) {
+    printf("%-40s %15s %15s %12s %15s\n", "Benchmark", "Time (ns)", "CPU (ns)", "Iterations", "Items/s");
+    for(auto& r : results) {
+        printf("%-40s %15.0f %15.0f %12lld %15.4g",
+               r.name.c_str(), r.realTime, r.cpuTime, (long long) r.iterations, r.itemsPerSecond);
+        for(auto& [name, value] : r.counters) {
+            printf(" %s=%g", name.c_str(), value);
+        }
+        printf("\n");
+    }
+}
+
+/// Escapes a string for a JSON string literal. Paths and benchmark names
+/// (e.g. SVG file names) may contain quotes or backslashes.
+static std::string jsonEscape(const std::string& s) {
+    std::string result;
+    for(unsigned char c : s) {
+        switch(c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if(c < 0x20) {
+                    char code[8];
+                    snprintf(code, sizeof(code), "\\u%04x", c);
+                    result += code;
+                } else {
+                    result += c;
+                }
+        }
+    }
+    return result;
+}
+
+static void printJSON(FILE* file, const std::vector<BenchResult>& results, const char* executable) {
+
+    char date[64];
+    auto t = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&t));
+
+    fprintf(file, "{\n  \"context\": {\n");
+    fprintf(file, "    \"date\": \"%s\",\n", date);
+    fprintf(file, "    \"executable\": \"%s\",\n", jsonEscape(executable).c_str());
+    fprintf(file, "    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+#ifdef NDEBUG
+    fprintf(file, "    \"library_build_type\": \"release\"\n");
+#else
+    fprintf(file, "    \"library_build_type\": \"debug\"\n");
+#endif
+    fprintf(file, "  },\n  \"benchmarks\": [\n");
+    for(size_t i=0;i<results.size();++i) {
+        auto& r = results[i];
+        fprintf(file, "    {\n");
+        auto escapedName = jsonEscape(r.name);
+        fprintf(file, "      \"name\": \"%s\",\n", escapedName.c_str());
+        fprintf(file, "      \"run_name\": \"%s\",\n", escapedName.c_str());
+        fprintf(file, "      \"run_type\": \"iteration\",\n");
+        fprintf(file, "      \"iterations\": %lld,\n", (long long) r.iterations);
+        fprintf(file, "      \"real_time\": %f,\n", r.realTime);
+        fprintf(file, "      \"cpu_time\": %f,\n", r.cpuTime);
+        fprintf(file, "      \"time_unit\": \"ns\",\n");
+        fprintf(file, "      \"items_per_second\": %f", r.itemsPerSecond);
+        for(auto& [name, value] : r.counters) {
+            fprintf(file, ",\n      \"%s\": %f", jsonEscape(name).c_str(), value);
+        }
+        fprintf(file, "\n");
+        fprintf(file, "    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+static const char* flagValue(const char* arg, const char* flag) {
+    auto n = strlen(flag);
+    if(strncmp(arg, flag, n) == 0 and arg[n] == '=') {
+        return arg + n + 1;
+    }
+    return nullptr;
+}
+
+int benchMain(int argc, const char* argv[],
+              const std::function<std::vector<Benchmark>(const BenchFlags&)>& makeBenchmarks) {
+
+    std::string filter = ".*";
+    std::string format = "console";
+    const char* outPath = nullptr;
+    double minTime = 0.5;
+    BenchFlags flags;
+
+    for(int i=1;i<argc;++i) {
+        const char* value;
+        if((value = flagValue(argv[i], "--benchmark_filter"))) {
+            filter = value;
+        } else if((value = flagValue(argv[i], "--benchmark_format"))) {
+            format = value;
+        } else if((value = flagValue(argv[i], "--benchmark_out"))) {
+            outPath = value;
+        } else if((value = flagValue(argv[i], "--benchmark_min_time"))) {
+            minTime = atof(value);
+        } else if((value = flagValue(argv[i], "--svg"))) {
+            flags.svgPath = value;
+        } else if((value = flagValue(argv[i], "--svg_dir"))) {
+            flags.svgDir = value;
+        } else if((value = flagValue(argv[i], "--font"))) {
+            flags.fontPath = value;
+        } else {
+            fprintf(stderr, "vgerBench: unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    std::regex re(filter);
+    std::vector<BenchResult> results;
+    for(auto& bench : makeBenchmarks(flags)) {
+        if(std::regex_search(bench.name, re)) {
+            results.push_back(runBenchmark(bench, minTime));
+        }
+    }
+
+    if(format == "json") {
+        printJSON(stdout, results, argv[0]);
+    } else {
+        printConsole(results);
+    }
+
+    if(outPath) {
+        auto file = fopen(outPath, "w");
+        if(!file) {
+            fprintf(stderr, "vgerBench: couldn't write %s\n", outPath);
+            return 1;
+        }
+        printJSON(file, results, argv[0]);
+        fclose(file);
+    }
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+
+/// Passed to each benchmark, which runs its body iterations times.
+struct BenchState {
+    int64_t iterations;
+
+    /// Set by the benchmark to report items per second.
+    int64_t itemsProcessed = 0;
+
+    /// Extra values to report, like Google Benchmark's user counters.
+    std::map<std::string, double> counters;
+};
+
+struct Benchmark {
+    std::string name;
+    std::function<void(BenchState&)> run;
+};
+
+struct BenchResult {
+    std::string name;
+    int64_t iterations;
+    double realTime; // ns per iteration
+    double cpuTime;  // ns per iteration
+    double itemsPerSecond;
+    std::map<std::string, double> counters;
+};
+
+/// Keeps the compiler from optimizing away a result.
+template<class T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// Flags for the benchmarks' inputs, shared by the bench executables.
+struct BenchFlags {
+    const char* svgPath = "Tests/vgerTests/images/Ghostscript_Tiger.svg";
+    const char* svgDir = "Tests/vgerTests/images";
+    const char* fontPath = "Sources/vger/fonts/Anodina-Regular.ttf";
+};
+
+/// Parses Google Benchmark's flags (and BenchFlags), runs the benchmarks
+/// which match the filter and prints the results. Returns the exit code.
+int benchMain(int argc, const char* argv[],
+              const std::function<std::vector<Benchmark>(const BenchFlags&)>& makeBenchmarks);
@@ -0,0 +1,266 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#include "../vger/vgerCPURenderer.h"
+#include "../vger/vgerParallel.h"
+#include "../vger/sdf.h"
+#include "../vger/compact_prim.h"
+#include "../vger/paint.h"
+#include <algorithm>
+
+using namespace simd;
+
+namespace {
+
+/// A prim along with everything we can compute once instead of per pixel.
+struct PreparedPrim {
+    vgerPrim prim;
+
+    /// Maps window coordinates to the prim's local coordinates.
+    vgerAffine inverse;
+
+    /// Derivatives of the interpolated texture coordinate per pixel.
+    float2 dtdx, dtdy;
+
+    /// length(fwidth(t)) in the fragment function.
+    float filterWidth;
+
+    /// sdfGlyphFilterWidth in the fragment function.
+    float glyphFilterWidth;
+
+    /// Covered pixels, [x0,x1) x [y0,y1).
+    int x0, y0, x1, y1;
+};
+
+/// Rows rendered by each task.
+constexpr int BandHeight = 16;
+
+inline float4 sampleBilinear(const vgerCPUTexture& tex, float2 p, bool alphaOnly) {
+
+    // p is in texel space with texel centers at .5
+    float x = p.x - 0.5f, y = p.y - 0.5f;
+    float fx = floorf(x), fy = floorf(y);
+    float ax = x - fx, ay = y - fy;
+
+    auto texel = [&](int i, int j) -> float4 {
+        i = std::clamp(i, 0, tex.width-1);
+        j = std::clamp(j, 0, tex.height-1);
+        auto row = tex.data + j * tex.bytesPerRow;
+        if(alphaOnly) {
+            return float4{0, 0, 0, row[i] / 255.0f};
+        }
+        auto px = row + 4*i;
+        return float4{float(px[0]), float(px[1]), float(px[2]), float(px[3])} / 255.0f;
+    };
+
+    int i = int(fx), j = int(fy);
+    auto top = mix(texel(i, j), texel(i+1, j), ax);
+    auto bottom = mix(texel(i, j+1), texel(i+1, j+1), ax);
+    return mix(top, bottom, ay);
+}
+
+/// Same as smoothstep in Metal.
+inline float smoothstep(float edge0, float edge1, float x) {
+    float t = std::clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+/// Same as gridAlpha in vger.metal, with the derivative passed in.
+inline float gridAlpha(float2 pos, float aa) {
+    auto dist = min(fabsf(pos.x - roundf(pos.x)), fabsf(pos.y - roundf(pos.y)));
+    return 0.5f * smoothstep(aa, 0.0f, dist);
+}
+
+}
+
+void vgerCPURenderer::clear(int width, int height) {
+    this->width = width;
+    this->height = height;
+    pixels.assign(size_t(width) * height, clearColor);
+}
+
+void vgerCPURenderer::render(const vgerCPULayer& layer, float2 windowSize) {
+
+    if(width == 0 or height == 0) {
+        return;
+    }
+
+    auto cvs = layer.cvs;
+    auto xforms = layer.xforms;
+
+    // Size of a pixel in window coordinates.
+    float2 pixelSize = windowSize / float2{float(width), float(height)};
+
+    std::vector<PreparedPrim> prepared;
+    prepared.reserve(layer.primCount);
+
+    for(auto& chunk : layer.prims)
+    for(size_t i=0;i<chunk.count;++i) {
+
+        auto& cp = chunk.ptr[i];
+        if(primType(cp) == vgerGlyph and (primGlyphPage(cp) >= glyphPages.size() or
+                                          glyphPages[primGlyphPage(cp)].data == nullptr)) {
+            continue;
+        }
+
+        // Same as vger_vertex.
+        PreparedPrim pp;
+        pp.prim = decodePrim(cp, cvs);
+        auto& prim = pp.prim;
+        decodePrimBounds(cp, prim, cvs);
+
+        auto qsize = prim.quadBounds[1] - prim.quadBounds[0];
+        if(qsize.x == 0 or qsize.y == 0 or prim.xform >= layer.xformCount) {
+            continue;
+        }
+
+        auto& M = xforms[prim.xform];
+        pp.inverse = affineInverse(M);
+
+        // Pixel bounds of the transformed quad.
+        float2 lo = FLT_MAX, hi = -FLT_MAX;
+        for(int c=0;c<4;++c) {
+            float2 corner{prim.quadBounds[c & 1].x, prim.quadBounds[c >> 1].y};
+            auto w = affineApply(M, corner);
+            float2 px{w.x / pixelSize.x, (windowSize.y - w.y) / pixelSize.y};
+            lo = simd_min(lo, px);
+            hi = simd_max(hi, px);
+        }
+
+        pp.x0 = std::max(0, int(ceilf(lo.x - 0.5f)));
+        pp.y0 = std::max(0, int(ceilf(lo.y - 0.5f)));
+        pp.x1 = std::min(width, int(floorf(hi.x - 0.5f)) + 1);
+        pp.y1 = std::min(height, int(floorf(hi.y - 0.5f)) + 1);
+
+        if(pp.x0 >= pp.x1 or pp.y0 >= pp.y1) {
+            continue;
+        }
+
+        // The vertex function interpolates t linearly across the quad.
+        auto tscale = (prim.texBounds[1] - prim.texBounds[0]) / qsize;
+        pp.dtdx = affineApplyVector(pp.inverse, float2{pixelSize.x, 0}) * tscale;
+        pp.dtdy = affineApplyVector(pp.inverse, float2{0, -pixelSize.y}) * tscale;
+        pp.filterWidth = length(abs(pp.dtdx) + abs(pp.dtdy));
+        pp.glyphFilterWidth = sdfGlyphFilterWidth(pp.dtdx, pp.dtdy);
+
+        prepared.push_back(pp);
+    }
+
+    auto preparedPtr = prepared.data();
+    auto preparedCount = prepared.size();
+    auto paints = layer.paints;
+    auto paintCount = layer.paintCount;
+    auto fb = pixels.data();
+    auto texturesPtr = textures.data();
+    int textureCount = int(textures.size());
+    auto glyphPagesPtr = glyphPages.data();
+    int w = width, h = height;
+    int bandCount = (height + BandHeight - 1) / BandHeight;
+
+    vgerParallelFor(bandCount, [&](size_t band) {
+
+        int bandY0 = int(band) * BandHeight;
+        int bandY1 = std::min(h, bandY0 + BandHeight);
+
+        for(size_t i=0;i<preparedCount;++i) {
+
+            auto& pp = preparedPtr[i];
+            auto& prim = pp.prim;
+
+            int y0 = std::max(pp.y0, bandY0);
+            int y1 = std::min(pp.y1, bandY1);
+            if(y0 >= y1) {
+                continue;
+            }
+
+            if(prim.paint >= paintCount) {
+                continue;
+            }
+            auto& paint = paints[prim.paint];
+
+            const vgerCPUTexture* image = nullptr;
+            if(prim.type != vgerGlyph and paint.image >= 0) {
+                if(paint.image >= textureCount or texturesPtr[paint.image].data == nullptr) {
+                    continue;
+                }
+                image = texturesPtr + paint.image;
+            }
+
+            auto q0 = prim.quadBounds[0];
+            auto qsize = prim.quadBounds[1] - q0;
+            auto t0 = prim.texBounds[0];
+            auto tsize = prim.texBounds[1] - t0;
+            float fw = pp.filterWidth;
+
+            for(int y=y0;y<y1;++y) {
+                auto row = fb + size_t(y) * w;
+                float wy = windowSize.y - (y + 0.5f) * pixelSize.y;
+
+                for(int x=pp.x0;x<pp.x1;++x) {
+
+                    float wx = (x + 0.5f) * pixelSize.x;
+                    auto u = (affineApply(pp.inverse, float2{wx, wy}) - q0) / qsize;
+
+                    // Outside the quad.
+                    if(u.x < 0 or u.y < 0 or u.x >= 1 or u.y >= 1) {
+                        continue;
+                    }
+
+                    auto t = t0 + u * tsize;
+                    float4 color;
+
+                    if(prim.type == vgerGlyph) {
+                        auto c = paint.innerColor;
+                        float a = sampleBilinear(glyphPagesPtr[prim.glyph], t, true).w;
+                        if(prim.width > 0) {
+                            a = sdfGlyphCoverage(a, prim.width, pp.glyphFilterWidth);
+                        }
+                        color = float4{c.x, c.y, c.z, c.w * a};
+                    } else {
+                        float d = sdPrim(prim, cvs, t, fw);
+
+                        if(paint.image == -1) {
+                            color = applyPaint(paint, t);
+                        } else if(paint.image == -2) {
+                            auto pos = affineApply(paint.xform, t);
+                            auto dx = affineApplyVector(paint.xform, pp.dtdx);
+                            auto dy = affineApplyVector(paint.xform, pp.dtdy);
+                            color = paint.innerColor;
+                            color.w *= gridAlpha(pos, length(abs(dx) + abs(dy)));
+                        } else {
+                            auto tc = affineApply(paint.xform, t);
+                            if(!paint.flipY) {
+                                tc.y = 1.0f - tc.y;
+                            }
+                            color = sampleBilinear(*image, tc * float2{float(image->width), float(image->height)}, false);
+                            color.w *= paint.innerColor.w;
+                        }
+
+                        color.w *= 1.0f - smoothstep(-fw/2, fw/2, d);
+                    }
+
+                    // Blend with source alpha, as the render pipeline does.
+                    auto& dst = row[x];
+                    float a = color.w;
+                    dst.x = color.x * a + dst.x * (1 - a);
+                    dst.y = color.y * a + dst.y * (1 - a);
+                    dst.z = color.z * a + dst.z * (1 - a);
+                    dst.w = a * a + dst.w * (1 - a);
+                }
+            }
+        }
+    });
+}
+
+void vgerCPURenderer::getPixels(uint8_t* rgba, int bytesPerRow) const {
+    for(int y=0;y<height;++y) {
+        auto out = rgba + size_t(y) * bytesPerRow;
+        auto row = pixels.data() + size_t(y) * width;
+        for(int x=0;x<width;++x) {
+            auto c = simd_clamp(row[x], 0.0f, 1.0f) * 255.0f + 0.5f;
+            out[4*x+0] = uint8_t(c.x);
+            out[4*x+1] = uint8_t(c.y);
+            out[4*x+2] = uint8_t(c.z);
+            out[4*x+3] = uint8_t(c.w);
+        }
+    }
+}
@@ -0,0 +1,472 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#include "../vger/vgerFont.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+// Simple glyph flags.
+enum {
+    OnCurve = 1,
+    XShort = 2,
+    YShort = 4,
+    Repeat = 8,
+    XSameOrPositive = 16,
+    YSameOrPositive = 32
+};
+
+// Composite glyph flags.
+enum {
+    ArgsAreWords = 1,
+    ArgsAreXYValues = 2,
+    HaveScale = 8,
+    MoreComponents = 0x20,
+    HaveXYScale = 0x40,
+    HaveTwoByTwo = 0x80
+};
+
+/// Composite glyphs can refer to other composites. Fonts don't go deep,
+/// so this just stops cycles. The budget bounds the total work.
+constexpr int maxCompositeDepth = 8;
+
+vgerFontPoint mid(vgerFontPoint a, vgerFontPoint b) {
+    return {(a.x + b.x) * 0.5f, (a.y + b.y) * 0.5f};
+}
+
+vgerFontPoint apply(const float m[6], float x, float y) {
+    return {m[0]*x + m[2]*y + m[4], m[1]*x + m[3]*y + m[5]};
+}
+
+}
+
+bool vgerFont::load(const void* data, size_t size) {
+
+    auto bytes = (const uint8_t*) data;
+    _data.assign(bytes, bytes + size);
+
+    auto version = _u32(0);
+    if(version != 0x00010000 and version != 0x74727565 /* 'true' */) {
+        return false;
+    }
+
+    auto head = _findTable("head");
+    auto maxp = _findTable("maxp");
+    auto hhea = _findTable("hhea");
+    _loca = _findTable("loca");
+    _glyf = _findTable("glyf", &_glyfLength);
+    _hmtx = _findTable("hmtx");
+
+    if(!head or !maxp or !_loca or !_glyf) {
+        return false;
+    }
+
+    _unitsPerEm = _u16(head + 18);
+    _longLocaFormat = _i16(head + 50);
+    _glyphCount = _u16(maxp + 4);
+    _hmetricCount = hhea ? _u16(hhea + 34) : 0;
+
+    if(_unitsPerEm == 0) {
+        return false;
+    }
+
+    // Prefer a full unicode subtable (format 12), then the BMP (format 4).
+    _cmap = 0;
+    if(auto cmap = _findTable("cmap")) {
+        int best = 0;
+        auto count = _u16(cmap + 2);
+        for(int i=0;i<count;++i) {
+            auto record = cmap + 4 + 8*i;
+            auto platform = _u16(record);
+            auto encoding = _u16(record + 2);
+            auto subtable = cmap + _u32(record + 4);
+            auto format = _u16(subtable);
+            bool unicode = platform == 0 or (platform == 3 and (encoding == 1 or encoding == 10));
+            int score = !unicode ? 0 : format == 12 ? 2 : format == 4 ? 1 : 0;
+            if(score > best) {
+                best = score;
+                _cmap = subtable;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool vgerFont::loadFile(const char* path) {
+
+    auto file = fopen(path, "rb");
+    if(!file) {
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t buf[65536];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(file);
+
+    return load(data.data(), data.size());
+}
+
+uint32_t vgerFont::_findTable(const char* tag, uint32_t* length) const {
+    auto count = _u16(4);
+    for(int i=0;i<count;++i) {
+        auto record = 12 + 16*i;
+        if(_has(record, 16) and memcmp(&_data[record], tag, 4) == 0) {
+            auto offset = _u32(record + 8);
+            auto size = _u32(record + 12);
+            if(!_has(offset, size)) {
+                return 0;
+            }
+            if(length) {
+                *length = size;
+            }
+            return offset;
+        }
+    }
+    return 0;
+}
+
+uint32_t vgerFont::glyphIndex(uint32_t codepoint) const {
+
+    if(!_cmap) {
+        return 0;
+    }
+
+    auto format = _u16(_cmap);
+
+    if(format == 4) {
+        if(codepoint > 0xffff) {
+            return 0;
+        }
+        auto segCountX2 = _u16(_cmap + 6);
+        auto endCodes = _cmap + 14;
+        auto startCodes = endCodes + segCountX2 + 2;
+        auto deltas = startCodes + segCountX2;
+        auto rangeOffsets = deltas + segCountX2;
+
+        // Binary search for the first segment ending at or after the
+        // code point.
+        int lo = 0, hi = segCountX2 / 2;
+        while(lo < hi) {
+            int m = (lo + hi) / 2;
+            if(_u16(endCodes + 2*m) < codepoint) {
+                lo = m + 1;
+            } else {
+                hi = m;
+            }
+        }
+        if(lo == segCountX2 / 2) {
+            return 0;
+        }
+
+        auto start = _u16(startCodes + 2*lo);
+        if(codepoint < start) {
+            return 0;
+        }
+
+        auto delta = _u16(deltas + 2*lo);
+        auto rangeOffset = _u16(rangeOffsets + 2*lo);
+        if(rangeOffset == 0) {
+            return (codepoint + delta) & 0xffff;
+        }
+
+        auto glyph = _u16(rangeOffsets + 2*lo + rangeOffset + 2*(codepoint - start));
+        return glyph ? (glyph + delta) & 0xffff : 0;
+    }
+
+    if(format == 12) {
+        auto groups = _u32(_cmap + 12);
+        int lo = 0, hi = int(groups);
+        while(lo < hi) {
+            int m = (lo + hi) / 2;
+            auto group = _cmap + 16 + 12*m;
+            if(codepoint < _u32(group)) {
+                hi = m;
+            } else if(codepoint > _u32(group + 4)) {
+                lo = m + 1;
+            } else {
+                return _u32(group + 8) + codepoint - _u32(group);
+            }
+        }
+    }
+
+    return 0;
+}
+
+int vgerFont::advance(uint32_t glyph) const {
+    if(!_hmtx or _hmetricCount == 0) {
+        return 0;
+    }
+    // Glyphs past the last metric use its advance.
+    auto i = glyph < uint32_t(_hmetricCount) ? glyph : _hmetricCount - 1;
+    return _u16(_hmtx + 4*i);
+}
+
+bool vgerFont::_glyphRange(uint32_t glyph, uint32_t* offset, uint32_t* length) const {
+
+    if(glyph >= uint32_t(_glyphCount)) {
+        return false;
+    }
+
+    uint32_t start, end;
+    if(_longLocaFormat) {
+        start = _u32(_loca + 4*glyph);
+        end = _u32(_loca + 4*glyph + 4);
+    } else {
+        start = _u16(_loca + 2*glyph) * 2;
+        end = _u16(_loca + 2*glyph + 2) * 2;
+    }
+
+    // Empty glyphs (like space) have no outline.
+    if(end <= start or end > _glyfLength) {
+        return false;
+    }
+
+    *offset = _glyf + start;
+    *length = end - start;
+    return true;
+}
+
+bool vgerFont::glyphBox(uint32_t glyph, vgerGlyphBox* box) const {
+
+    uint32_t offset, length;
+    if(!_glyphRange(glyph, &offset, &length) or length < 10 or _i16(offset) == 0) {
+        return false;
+    }
+
+    box->xMin = _i16(offset + 2);
+    box->yMin = _i16(offset + 4);
+    box->xMax = _i16(offset + 6);
+    box->yMax = _i16(offset + 8);
+    return true;
+}
+
+bool vgerFont::glyphOutline(uint32_t glyph, std::vector<vgerFontQuad>& quads) const {
+    const float identity[6] = {1, 0, 0, 1, 0, 0};
+    auto count = quads.size();
+    _Budget budget{vgerFontMaxComponents, vgerFontMaxPoints};
+    // Don't leave part of an outline behind on failure.
+    if(!_outline(glyph, identity, 0, budget, quads) or budget.components < 0 or budget.points < 0) {
+        quads.resize(count);
+        return false;
+    }
+    return quads.size() > count;
+}
+
+bool vgerFont::_outline(uint32_t glyph, const float m[6], int depth, _Budget& budget, std::vector<vgerFontQuad>& quads) const {
+
+    uint32_t offset, length;
+    if(!_glyphRange(glyph, &offset, &length) or length < 10) {
+        return false;
+    }
+
+    auto end = offset + length;
+    int contourCount = _i16(offset);
+
+    if(contourCount < 0) {
+
+        if(depth >= maxCompositeDepth) {
+            return false;
+        }
+
+        // Composite glyph: transformed components.
+        auto p = offset + 10;
+        uint16_t flags;
+        do {
+            if(p + 4 > end or --budget.components < 0) {
+                return false;
+            }
+            flags = _u16(p);
+            auto component = _u16(p + 2);
+            p += 4;
+
+            float dx = 0, dy = 0;
+            if(flags & ArgsAreWords) {
+                dx = _i16(p);
+                dy = _i16(p + 2);
+                p += 4;
+            } else {
+                dx = int8_t(_u8(p));
+                dy = int8_t(_u8(p + 1));
+                p += 2;
+            }
+
+            // Aligning points isn't supported. Use no offset.
+            if(!(flags & ArgsAreXYValues)) {
+                dx = dy = 0;
+            }
+
+            float a = 1, b = 0, c = 0, d = 1;
+            if(flags & HaveScale) {
+                a = d = _i16(p) / 16384.0f;
+                p += 2;
+            } else if(flags & HaveXYScale) {
+                a = _i16(p) / 16384.0f;
+                d = _i16(p + 2) / 16384.0f;
+                p += 4;
+            } else if(flags & HaveTwoByTwo) {
+                a = _i16(p) / 16384.0f;
+                b = _i16(p + 2) / 16384.0f;
+                c = _i16(p + 4) / 16384.0f;
+                d = _i16(p + 6) / 16384.0f;
+                p += 8;
+            }
+
+            // Component transform followed by ours.
+            float cm[6] = {
+                m[0]*a + m[2]*b, m[1]*a + m[3]*b,
+                m[0]*c + m[2]*d, m[1]*c + m[3]*d,
+                m[0]*dx + m[2]*dy + m[4], m[1]*dx + m[3]*dy + m[5]
+            };
+            // Skip components which fail, along with anything they added.
+            auto componentStart = quads.size();
+            if(!_outline(component, cm, depth + 1, budget, quads)) {
+                quads.resize(componentStart);
+            }
+            if(budget.components < 0 or budget.points < 0) {
+                return false;
+            }
+
+        } while(flags & MoreComponents);
+
+        return true;
+    }
+
+    // Simple glyph.
+    auto endPoints = offset + 10;
+    if(contourCount == 0 or endPoints + 2*contourCount + 2 > end) {
+        return false;
+    }
+
+    int pointCount = _u16(endPoints + 2*(contourCount-1)) + 1;
+    budget.points -= pointCount;
+    if(budget.points < 0) {
+        return false;
+    }
+    auto instructionLength = _u16(endPoints + 2*contourCount);
+    auto p = endPoints + 2*contourCount + 2 + instructionLength;
+
+    // Simple glyphs don't recurse, so scratch can be shared by the calls
+    // for a composite's components. Kept to avoid allocating per glyph.
+    static thread_local std::vector<uint8_t> flags;
+    static thread_local std::vector<vgerFontPoint> points;
+    flags.resize(pointCount);
+    for(int i=0;i<pointCount;) {
+        if(p >= end) {
+            return false;
+        }
+        auto f = _u8(p++);
+        int repeat = 1;
+        if(f & Repeat) {
+            repeat += _u8(p++);
+        }
+        for(;repeat and i<pointCount;--repeat) {
+            flags[i++] = f;
+        }
+    }
+
+    points.resize(pointCount);
+
+    int x = 0;
+    for(int i=0;i<pointCount;++i) {
+        auto f = flags[i];
+        if(f & XShort) {
+            int dx = _u8(p++);
+            x += (f & XSameOrPositive) ? dx : -dx;
+        } else if(!(f & XSameOrPositive)) {
+            x += _i16(p);
+            p += 2;
+        }
+        points[i].x = x;
+    }
+
+    int y = 0;
+    for(int i=0;i<pointCount;++i) {
+        auto f = flags[i];
+        if(f & YShort) {
+            int dy = _u8(p++);
+            y += (f & YSameOrPositive) ? dy : -dy;
+        } else if(!(f & YSameOrPositive)) {
+            y += _i16(p);
+            p += 2;
+        }
+        points[i].y = y;
+    }
+
+    if(p > end) {
+        return false;
+    }
+
+    for(auto& pt : points) {
+        pt = apply(m, pt.x, pt.y);
+    }
+
+    vgerFontPoint pen, control;
+    bool haveControl = false;
+
+    auto visit = [&](vgerFontPoint pt, bool on) {
+        if(on) {
+            if(haveControl) {
+                quads.push_back({pen, control, pt});
+            } else if(pen.x != pt.x or pen.y != pt.y) {
+                quads.push_back({pen, mid(pen, pt), pt});
+            }
+            pen = pt;
+            haveControl = false;
+        } else {
+            // Consecutive off curve points have an implied on curve point
+            // between them.
+            if(haveControl) {
+                auto m = mid(control, pt);
+                quads.push_back({pen, control, m});
+                pen = m;
+            }
+            control = pt;
+            haveControl = true;
+        }
+    };
+
+    int first = 0;
+    for(int c=0;c<contourCount;++c) {
+
+        int last = _u16(endPoints + 2*c);
+        if(last < first or last >= pointCount) {
+            return false;
+        }
+        int n = last - first + 1;
+
+        // Start at an on curve point, or between the last and first
+        // points if there isn't one.
+        int start = -1;
+        for(int i=0;i<n;++i) {
+            if(flags[first + i] & OnCurve) {
+                start = i;
+                break;
+            }
+        }
+
+        haveControl = false;
+        if(start >= 0) {
+            pen = points[first + start];
+            for(int k=1;k<=n;++k) {
+                int i = first + (start + k) % n;
+                visit(points[i], flags[i] & OnCurve);
+            }
+        } else {
+            auto origin = mid(points[last], points[first]);
+            pen = origin;
+            for(int i=first;i<=last;++i) {
+                visit(points[i], false);
+            }
+            visit(origin, true);
+        }
+
+        first = last + 1;
+    }
+
+    return true;
+}
@@ -0,0 +1,182 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#include "../vger/vgerGlyphRasterizer.h"
+#include <math.h>
+#include <algorithm>
+
+/// ceilf without a library call on targets lacking a rounding instruction.
+static inline int ceilInt(float x) {
+    int i = int(x);
+    return i + (float(i) < x);
+}
+
+void vgerGlyphRasterizer::begin(int width, int height) {
+    _width = width;
+    _height = height;
+
+    // Lines at the right edge write up to two past the row. Those columns
+    // are never summed, so each row's running sum starts from zero.
+    _stride = width + 2;
+    _accum.assign(size_t(_stride) * height, 0.0f);
+}
+
+void vgerGlyphRasterizer::addLine(vgerFontPoint a, vgerFontPoint b) {
+
+    if(a.y == b.y) {
+        return;
+    }
+
+    float dir = 1;
+    if(a.y > b.y) {
+        std::swap(a, b);
+        dir = -1;
+    }
+
+    a.x = std::clamp(a.x, 0.0f, float(_width));
+    b.x = std::clamp(b.x, 0.0f, float(_width));
+
+    float dxdy = (b.x - a.x) / (b.y - a.y);
+    float x = a.x;
+    if(a.y < 0) {
+        x -= a.y * dxdy;
+    }
+
+    int yStart = std::max(int(a.y), 0);
+    int yEnd = std::min(ceilInt(b.y), _height);
+    auto accum = _accum.data();
+
+    for(int y=yStart;y<yEnd;++y) {
+
+        auto row = accum + size_t(y) * _stride;
+        float dy = std::min(float(y + 1), b.y) - std::max(float(y), a.y);
+        float xNext = std::clamp(x + dxdy * dy, 0.0f, float(_width));
+        float d = dy * dir;
+
+        float x0 = std::min(x, xNext);
+        float x1 = std::max(x, xNext);
+        // x is clamped to the image, so truncating is flooring.
+        int x0i = int(x0);
+        float x0Floor = float(x0i);
+        int x1i = ceilInt(x1);
+        float x1Ceil = float(x1i);
+
+        if(x1i <= x0i + 1) {
+            // Within one pixel: the area right of the line is coverage for
+            // this pixel, and the rest carries to the next.
+            float xm = 0.5f * (x + xNext) - x0Floor;
+            row[x0i] += d - d * xm;
+            row[x0i + 1] += d * xm;
+        } else {
+            // Spread over the pixels the line crosses.
+            float s = 1.0f / (x1 - x0);
+            float x0f = x0 - x0Floor;
+            float a0 = 0.5f * s * (1 - x0f) * (1 - x0f);
+            float x1f = x1 - x1Ceil + 1;
+            float am = 0.5f * s * x1f * x1f;
+            row[x0i] += d * a0;
+            if(x1i == x0i + 2) {
+                row[x0i + 1] += d * (1 - a0 - am);
+            } else {
+                float a1 = s * (1.5f - x0f);
+                row[x0i + 1] += d * (a1 - a0);
+                for(int xi=x0i+2;xi<x1i-1;++xi) {
+                    row[xi] += d * s;
+                }
+                float a2 = a1 + (x1i - x0i - 3) * s;
+                row[x1i - 1] += d * (1 - a2 - am);
+            }
+            row[x1i] += d * am;
+        }
+
+        x = xNext;
+    }
+}
+
+void vgerGlyphRasterizer::addQuad(const vgerFontQuad& quad) {
+
+    auto p0 = quad.cvs[0], p1 = quad.cvs[1], p2 = quad.cvs[2];
+
+    // A quadratic's distance from its chord over 1/n of it is at most
+    // |p0 - 2p1 + p2| / (4n²).
+    float ddx = p0.x - 2*p1.x + p2.x;
+    float ddy = p0.y - 2*p1.y + p2.y;
+    float dd = sqrtf(ddx*ddx + ddy*ddy);
+    int n = std::clamp(ceilInt(sqrtf(dd / (4 * tolerance))), 1, 64);
+
+    if(n == 1) {
+        addLine(p0, p2);
+        return;
+    }
+
+    // Forward differences of B(t) at steps of 1/n.
+    float h = 1.0f / n;
+    float ax = ddx * h * h, ay = ddy * h * h;
+    float dx = 2 * (p1.x - p0.x) * h + ax;
+    float dy = 2 * (p1.y - p0.y) * h + ay;
+    ax *= 2;
+    ay *= 2;
+
+    auto p = p0;
+    for(int i=1;i<n;++i) {
+        vgerFontPoint next = {p.x + dx, p.y + dy};
+        addLine(p, next);
+        p = next;
+        dx += ax;
+        dy += ay;
+    }
+    addLine(p, p2);
+}
+
+static inline uint8_t coverageByte(float sum) {
+    return uint8_t(std::min(fabsf(sum), 1.0f) * 255.0f + 0.5f);
+}
+
+void vgerGlyphRasterizer::end(uint8_t* image, int bytesPerRow) {
+
+    // The running sums are serial within a row, so sum four rows at once
+    // to keep the adds from waiting on each other.
+    int y = 0;
+    for(;y+4<=_height;y+=4) {
+        auto a = _accum.data() + size_t(y) * _stride;
+        auto out = image + size_t(y) * bytesPerRow;
+        float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        for(int x=0;x<_width;++x) {
+            s0 += a[x];
+            s1 += a[x + _stride];
+            s2 += a[x + 2*_stride];
+            s3 += a[x + 3*_stride];
+            out[x] = coverageByte(s0);
+            out[x + bytesPerRow] = coverageByte(s1);
+            out[x + 2*bytesPerRow] = coverageByte(s2);
+            out[x + 3*bytesPerRow] = coverageByte(s3);
+        }
+    }
+
+    for(;y<_height;++y) {
+        auto a = _accum.data() + size_t(y) * _stride;
+        auto out = image + size_t(y) * bytesPerRow;
+        float sum = 0;
+        for(int x=0;x<_width;++x) {
+            sum += a[x];
+            out[x] = coverageByte(sum);
+        }
+    }
+}
+
+void vgerGlyphRasterizer::rasterize(const std::vector<vgerFontQuad>& quads,
+                                    float scale, vgerFontPoint offset,
+                                    int width, int height,
+                                    uint8_t* image, int bytesPerRow) {
+
+    begin(width, height);
+
+    auto transform = [&](vgerFontPoint p) {
+        return vgerFontPoint{p.x * scale + offset.x, height - (p.y * scale + offset.y)};
+    };
+
+    for(auto& q : quads) {
+        addQuad({transform(q.cvs[0]), transform(q.cvs[1]), transform(q.cvs[2])});
+    }
+
+    end(image, bytesPerRow);
+}
@@ -0,0 +1,98 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#include "../vger/vgerParallel.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+/// Set on pool threads, and on a caller while it's helping, so nested
+/// calls run inline.
+thread_local bool insidePool = false;
+
+/// Workers sleep until the generation changes, then take indices from
+/// next until they run out. The caller waits until every worker has
+/// checked in, so a job's body outlives all uses of it.
+struct Pool {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    /// Held for the duration of a job, so concurrent callers run inline.
+    std::mutex callMutex;
+
+    const std::function<void(size_t)>* body = nullptr;
+    size_t count = 0;
+    std::atomic<size_t> next{0};
+    uint64_t generation = 0;
+    int busy = 0;
+    int workers = 0;
+
+    Pool() {
+        workers = int(std::thread::hardware_concurrency()) - 1;
+        for(int i=0;i<workers;++i) {
+            std::thread([this] { work(); }).detach();
+        }
+    }
+
+    void run(const std::function<void(size_t)>& f, size_t n) {
+        for(size_t i = next++; i < n; i = next++) {
+            f(i);
+        }
+    }
+
+    void work() {
+        insidePool = true;
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for(;;) {
+            wake.wait(lock, [&] { return generation != seen; });
+            seen = generation;
+            auto f = body;
+            auto n = count;
+            lock.unlock();
+            run(*f, n);
+            lock.lock();
+            if(--busy == 0) {
+                done.notify_one();
+            }
+        }
+    }
+};
+
+}
+
+void vgerParallelFor(size_t count, const std::function<void(size_t)>& body) {
+
+    // Never destroyed, since the workers are detached.
+    static Pool* pool = new Pool;
+
+    if(count <= 1 or pool->workers <= 0 or insidePool or !pool->callMutex.try_lock()) {
+        for(size_t i=0;i<count;++i) {
+            body(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->body = &body;
+        pool->count = count;
+        pool->next = 0;
+        pool->busy = pool->workers;
+        ++pool->generation;
+    }
+    pool->wake.notify_all();
+
+    insidePool = true;
+    pool->run(body, count);
+    insidePool = false;
+
+    {
+        std::unique_lock<std::mutex> lock(pool->mutex);
+        pool->done.wait(lock, [&] { return pool->busy == 0; });
+    }
+    pool->callMutex.unlock();
+}
@@ -0,0 +1,493 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#include "../vger/vgerPathScanner.h"
+#include "../vger/vgerTrace.h"
+#include <cassert>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+using namespace simd;
+
+bool operator<(const vgerPathScanner::Node& a, const vgerPathScanner::Node& b) {
+    return std::tie(a.coord, a.seg, a.end) < std::tie(b.coord, b.seg, b.end);
+}
+
+/// Segments are always fattened by at least a unit to prevent artifacts
+/// from slightly missing a curve in a band.
+static float fattening(float filterWidth) {
+    return std::max(filterWidth, 1.0f);
+}
+
+void vgerPathScanner::_init(float filterWidth) {
+
+    VGER_TRACE_ZONE("vgerPathScanner::_init");
+
+    nodes.clear();
+    index = 0;
+    tilePad = 0;
+    float pad = fattening(filterWidth);
+
+    for(int i=0;i<segments.size();++i) {
+        auto yInterval = segments[i].yInterval(pad);
+        nodes.push_back({yInterval.a, i, 0});
+        nodes.push_back({yInterval.b, i, 1});
+    }
+
+    // Below this, std::sort beats the radix sort's fixed overhead.
+    constexpr size_t RadixThreshold = 256;
+
+    switch(sortMode) {
+        case SortModeStd:
+            // Note: using qsort is significantly slower according to profiling.
+            std::sort(nodes.begin(), nodes.end());
+            break;
+        case SortModeRadix:
+            _radixSort();
+            break;
+        case SortModeAuto:
+            if(!_mergeSorted()) {
+                if(nodes.size() < RadixThreshold) {
+                    std::sort(nodes.begin(), nodes.end());
+                } else {
+                    _radixSort();
+                }
+            }
+            break;
+    }
+
+}
+
+/// Maps a float to a key which sorts the same way as unsigned.
+static uint32_t sortKey(float f) {
+    f += 0.0f; // -0 to +0, so they compare equal as in operator<.
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return (u & 0x80000000) ? ~u : (u | 0x80000000);
+}
+
+void vgerPathScanner::_radixSort() {
+
+    // Nodes are generated in (seg, end) order, so a stable sort on coord
+    // gives the same order as operator<.
+    auto n = nodes.size();
+    if(n == 0) {
+        return;
+    }
+
+    sortKeys.resize(n);
+    sortKeysTmp.resize(n);
+    sortNodes.resize(n);
+
+    for(size_t i=0;i<n;++i) {
+        sortKeys[i] = sortKey(nodes[i].coord);
+    }
+
+    for(int shift=0;shift<32;shift+=8) {
+
+        size_t counts[256] = {};
+        for(auto k : sortKeys) {
+            ++counts[(k >> shift) & 0xff];
+        }
+
+        // Skip the pass if every key has the same digit.
+        if(counts[(sortKeys[0] >> shift) & 0xff] == n) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for(auto& c : counts) {
+            auto t = c;
+            c = offset;
+            offset += t;
+        }
+
+        for(size_t i=0;i<n;++i) {
+            auto d = counts[(sortKeys[i] >> shift) & 0xff]++;
+            sortKeysTmp[d] = sortKeys[i];
+            sortNodes[d] = nodes[i];
+        }
+
+        std::swap(sortKeys, sortKeysTmp);
+        std::swap(nodes, sortNodes);
+    }
+}
+
+bool vgerPathScanner::_mergeSorted() {
+
+    // Start nodes are at even indices, end nodes at odd.
+    auto n = nodes.size();
+    for(size_t i=2;i<n;++i) {
+        if(nodes[i].coord < nodes[i-2].coord) {
+            return false;
+        }
+    }
+
+    sortNodes.resize(n);
+    for(size_t i=0;i<n/2;++i) {
+        sortNodes[i] = nodes[2*i];
+        sortNodes[n/2 + i] = nodes[2*i+1];
+    }
+
+    std::merge(sortNodes.begin(), sortNodes.begin() + n/2,
+               sortNodes.begin() + n/2, sortNodes.end(),
+               nodes.begin());
+
+    return true;
+}
+
+void vgerPathScanner::begin(vector_float2 *cvs, int count) {
+
+    segments.clear();
+
+    for(int i=0;i<count-2;i+=2) {
+        segments.push_back({cvs[i], cvs[i+1], cvs[i+2]});
+    }
+
+    // Close the path if necessary.
+    auto start = segments.front().cvs[0];
+    auto end = segments.back().cvs[2];
+    if(!equal(start, end)) {
+        segments.push_back({end, (start+end)/2, start});
+    }
+
+    _init();
+
+}
+
+bool vgerPathScanner::next() {
+
+    VGER_TRACE_ZONE("vgerPathScanner::next");
+
+    float y = nodes[index].coord;
+    interval.a = y;
+    auto n = nodes.size();
+
+    // Activate and deactivate segments.
+    for(;index < n && nodes[index].coord == y; ++index) {
+        assert(index < n);
+        auto& node = nodes[index];
+        assert(node.seg < segments.size());
+        if(node.end) {
+            --activeCount;
+            auto& prev = segments[node.seg].previous;
+            auto& next = segments[node.seg].next;
+            if(prev != -1) {
+                assert(prev < segments.size());
+                segments[prev].next = next;
+            }
+            if(next != -1) {
+                assert(next < segments.size());
+                segments[next].previous = prev;
+            }
+            if(first == node.seg) {
+                first = next;
+            }
+            next = prev = -1;
+        } else {
+            ++activeCount;
+            segments[node.seg].next = first;
+            if(first != -1) {
+                assert(first < segments.size());
+                segments[first].previous = node.seg;
+            }
+            first = node.seg;
+        }
+    }
+
+    if(index < n) {
+        interval.b = nodes[index].coord;
+    }
+
+    return index < n;
+}
+
+/// Sorts added and merges it into v, which is already sorted.
+template<class Less>
+static void insertSorted(std::vector<vgerPathScanner::SweepSegment>& v,
+                         std::vector<vgerPathScanner::SweepSegment>& added,
+                         Less less) {
+
+    std::sort(added.begin(), added.end(), less);
+
+    // Merge from the back, so nothing is overwritten before it's moved.
+    auto i = v.size(), j = added.size();
+    v.resize(i + j);
+    for(auto k = v.size(); j > 0;) {
+        if(i > 0 and less(added[j-1], v[i-1])) {
+            v[--k] = v[--i];
+        } else {
+            v[--k] = added[--j];
+        }
+    }
+}
+
+void vgerPathScanner::tile(float width, float filterWidth) {
+
+    tiles.clear();
+    tileSegments.clear();
+    tileLive.clear();
+    tileCrossings.clear();
+    tileEntered = 0;
+
+    float pad = fattening(filterWidth);
+
+    if(pad != tilePad) {
+        tileActive.clear();
+        tileEnds.clear();
+        tileStamps.assign(segments.size(), 0);
+        tileCall = 1;
+        tilePad = pad;
+    }
+
+    // Each segment is active for a single run of slabs, so one which is
+    // still active has the last call's stamp.
+    auto previousCall = tileCall++;
+    tileAdded.clear();
+
+    // Extent of the control vertices.
+    Interval slabX{FLT_MAX, -FLT_MAX};
+    for(int a = first; a != -1; a = segments[a].next) {
+        if(tileStamps[a] != previousCall) {
+            tileAdded.push_back({segments[a].xInterval(pad), a});
+        }
+        tileStamps[a] = tileCall;
+        for(auto p : segments[a].cvs) {
+            slabX.a = std::min(slabX.a, p.x);
+            slabX.b = std::max(slabX.b, p.x);
+        }
+    }
+
+    // Keep the segments sorted, so the tiles can be swept rather than
+    // checking every segment against every tile.
+    auto ended = [this](const SweepSegment& s) { return tileStamps[s.seg] != tileCall; };
+    tileActive.erase(std::remove_if(tileActive.begin(), tileActive.end(), ended), tileActive.end());
+    tileEnds.erase(std::remove_if(tileEnds.begin(), tileEnds.end(), ended), tileEnds.end());
+    insertSorted(tileActive, tileAdded, [](const SweepSegment& l, const SweepSegment& r) {
+        return l.x.a < r.x.a;
+    });
+    insertSorted(tileEnds, tileAdded, [](const SweepSegment& l, const SweepSegment& r) {
+        return l.x.b < r.x.b;
+    });
+
+    if(slabX.empty() or slabX.a == slabX.b) {
+        return;
+    }
+
+    // Every segment starts out right of the tiles. The chord crosses a
+    // horizontal line iff exactly one endpoint is below it, so the parity
+    // at y is the parity of the number of endpoints below y. Most
+    // endpoints are outside the slab, so only their parity is kept.
+    float below = interval.a - 1, above = interval.b + 1;
+    int belowCount = 0, aboveCount = 0;
+    for(auto& s : tileActive) {
+        auto& seg = segments[s.seg];
+        for(auto y : {seg.cvs[0].y, seg.cvs[2].y}) {
+            if(y <= below) {
+                ++belowCount;
+            } else if(y >= above) {
+                ++aboveCount;
+            } else {
+                tileCrossings.push_back(y);
+            }
+        }
+    }
+    std::sort(tileCrossings.begin(), tileCrossings.end());
+
+    // Cancel out pairs of equal endpoints.
+    size_t kept = 0;
+    for(size_t i=0;i<tileCrossings.size();) {
+        size_t j = i;
+        while(j < tileCrossings.size() and tileCrossings[j] == tileCrossings[i]) {
+            ++j;
+        }
+        if((j - i) % 2) {
+            tileCrossings[kept++] = tileCrossings[i];
+        }
+        i = j;
+    }
+    tileCrossings.resize(kept);
+    if(belowCount % 2) {
+        tileCrossings.insert(tileCrossings.begin(), below);
+    }
+    if(aboveCount % 2) {
+        tileCrossings.push_back(above);
+    }
+
+    // Cover the antialiased edge.
+    slabX.a -= pad;
+    slabX.b += pad;
+
+    // Proxy segments go outside the filter of every pixel in the tile.
+    if(width <= 0) {
+        _tile(slabX, slabX, slabX.b - slabX.a + 2 * pad);
+        return;
+    }
+
+    // Align tiles to a grid so seams line up between slabs.
+    int k0 = int(floorf(slabX.a / width));
+    int k1 = int(ceilf(slabX.b / width));
+
+    for(int k=k0;k<k1;++k) {
+        _tile({k * width, (k+1) * width}, slabX, width + 2 * pad);
+    }
+}
+
+size_t vgerPathScanner::_tileCount(Interval tileX) const {
+
+    // Segments ending left of the tile also start left of its right edge.
+    auto started = std::lower_bound(tileActive.begin(), tileActive.end(), tileX.b,
+                                    [](const SweepSegment& s, float x) { return s.x.a < x; });
+    auto ended = std::upper_bound(tileEnds.begin(), tileEnds.end(), tileX.a,
+                                  [](float x, const SweepSegment& s) { return x < s.x.b; });
+    return (started - tileActive.begin()) - (ended - tileEnds.begin());
+}
+
+void vgerPathScanner::_toggleCrossings(const Segment& seg) {
+    for(auto y : {seg.cvs[0].y, seg.cvs[2].y}) {
+        y = std::clamp(y, interval.a - 1, interval.b + 1);
+        auto it = std::lower_bound(tileCrossings.begin(), tileCrossings.end(), y);
+        if(it != tileCrossings.end() and *it == y) {
+            tileCrossings.erase(it);
+        } else {
+            tileCrossings.insert(it, y);
+        }
+    }
+}
+
+void vgerPathScanner::_tile(Interval tileX, Interval slabX, float proxyOffset) {
+
+    // Split tiles with too many segments.
+    auto localCount = _tileCount(tileX);
+    if(int(localCount) > MaxTileSegments and tileX.b - tileX.a > 2 * MinTileWidth) {
+        float mid = (tileX.a + tileX.b) / 2;
+
+        // Where segments are dense (e.g. thin spikes) most are within pad
+        // of the middle, so the halves would just copy them, doing little
+        // for the work per pixel. Only split if the halves hold less than
+        // 7/4 as many segments between them.
+        auto halvesCount = _tileCount({tileX.a, mid}) + _tileCount({mid, tileX.b});
+
+        if(4 * halvesCount <= 7 * localCount) {
+            _tile({tileX.a, mid}, slabX, proxyOffset);
+            _tile({mid, tileX.b}, slabX, proxyOffset);
+            return;
+        }
+    }
+
+    // Segments starting left of the tile's right edge are no longer to
+    // its right.
+    for(; tileEntered < tileActive.size() and tileActive[tileEntered].x.a < tileX.b; ++tileEntered) {
+        auto& s = tileActive[tileEntered];
+        tileLive.push_back(s);
+        _toggleCrossings(segments[s.seg]);
+    }
+
+    // Segments to the left never cross a ray going to the right.
+    tileLive.erase(std::remove_if(tileLive.begin(), tileLive.end(), [tileX](const SweepSegment& s) {
+        return s.x.b <= tileX.a;
+    }), tileLive.end());
+
+    int start = int(tileSegments.size());
+
+    for(auto& s : tileLive) {
+        auto& seg = segments[s.seg];
+        tileSegments.push_back({seg.cvs[0], seg.cvs[1], seg.cvs[2]});
+    }
+
+    // Pair up the endpoints into vertical segments. Put them well to the
+    // right so they're outside the AA filter.
+    float proxyX = tileX.b + proxyOffset;
+    for(size_t i=0;i+1<tileCrossings.size();i+=2) {
+        float2 a{proxyX, tileCrossings[i]}, c{proxyX, tileCrossings[i+1]};
+        tileSegments.push_back({a, (a+c)/2, c});
+    }
+
+    int count = int(tileSegments.size()) - start;
+
+    // Nothing to render if the tile isn't touched and is outside.
+    if(count == 0) {
+        return;
+    }
+
+    tiles.push_back({{std::max(tileX.a, slabX.a), std::min(tileX.b, slabX.b)}, start, count});
+}
+
+void vgerPathScanner::scanPrims(float tileWidth, float filterWidth, std::vector<vgerPrim>& prims, std::vector<float2>& cvs) {
+
+    slabCount = 0;
+
+    if(nodes.empty()) {
+        return;
+    }
+
+    while(next()) {
+
+        ++slabCount;
+
+        if(tileWidth > 0 or activeCount > MaxTileSegments) {
+            tile(tileWidth, filterWidth);
+
+            for(auto& t : tiles) {
+
+                vgerPrim prim = {
+                    .type = vgerPathFill,
+                    .start = uint32_t(cvs.size()),
+                    .count = uint32_t(t.count),
+                };
+
+                for(int a = t.start; a < t.start + t.count; ++a) {
+                    for(int i=0;i<3;++i) {
+                        cvs.push_back(tileSegments[a].cvs[i]);
+                    }
+                }
+
+                // Proxy segments lie outside the tile, so don't
+                // include them in the bounds.
+                float2 min{t.xInterval.a, interval.a};
+                float2 max{t.xInterval.b, interval.b};
+                prim.quadBounds[0] = prim.texBounds[0] = min;
+                prim.quadBounds[1] = prim.texBounds[1] = max;
+
+                prims.push_back(prim);
+            }
+
+        } else {
+
+            vgerPrim prim = {
+                .type = vgerPathFill,
+                .start = uint32_t(cvs.size()),
+                .count = uint32_t(activeCount),
+            };
+
+            Interval xInt{FLT_MAX, -FLT_MAX};
+
+            for(int a = first; a != -1; a = segments[a].next) {
+
+                assert(a < segments.size());
+                for(int i=0;i<3;++i) {
+                    auto p = segments[a].cvs[i];
+                    cvs.push_back(p);
+                    xInt.a = std::min(xInt.a, p.x);
+                    xInt.b = std::max(xInt.b, p.x);
+                }
+
+            }
+
+            // Calculate the prim vertices at this stage,
+            // as we do for glyphs. Cover the antialiased edge, as
+            // slabs do vertically.
+            float pad = fattening(filterWidth);
+            float2 min{xInt.a - pad, interval.a};
+            float2 max{xInt.b + pad, interval.b};
+            prim.quadBounds[0] = prim.texBounds[0] = min;
+            prim.quadBounds[1] = prim.texBounds[1] = max;
+
+            prims.push_back(prim);
+        }
+    }
+
+    assert(activeCount == 0);
+}
@@ -0,0 +1,267 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#include "../vger/vgerTileRasterizer.h"
+#include "../vger/vgerParallel.h"
+#include "../vger/sdf_batch.h"
+#include <algorithm>
+#include <cfloat>
+
+using namespace simd;
+
+namespace {
+
+/// One tile row of pixels.
+using Row = simd_float16;
+static_assert(vgerLanes<Row>::width == vgerTileRasterizer::TileSize);
+
+/// Same AA filter width as vger.metal for an unscaled prim.
+constexpr float FilterWidth = 1.414213562373095f;
+
+inline void blend(float4& dst, float4 color) {
+    float a = color.w;
+    dst.x = color.x * a + dst.x * (1 - a);
+    dst.y = color.y * a + dst.y * (1 - a);
+    dst.z = color.z * a + dst.z * (1 - a);
+    dst.w = a * a + dst.w * (1 - a);
+}
+
+/// Range of tile rows a segment's fattened y extent overlaps, or false if
+/// it's off screen.
+inline bool tileRows(const float2* p, int tilesY, int height, int& ty0, int& ty1) {
+    float ymin = std::min(p[0].y, std::min(p[1].y, p[2].y)) - 1;
+    float ymax = std::max(p[0].y, std::max(p[1].y, p[2].y)) + 1;
+    constexpr float T = vgerTileRasterizer::TileSize;
+    float fy0 = std::max(0.0f, floorf(ymin / T));
+    float fy1 = std::min(float(tilesY - 1), ceilf(ymax / T) - 1);
+    if(ymin >= height or !(fy0 <= fy1)) {
+        return false;
+    }
+    ty0 = int(fy0);
+    ty1 = int(fy1);
+    return true;
+}
+
+}
+
+void vgerTileRasterizer::clear(int width, int height) {
+    this->width = width;
+    this->height = height;
+    tilesX = (width + TileSize - 1) / TileSize;
+    tilesY = (height + TileSize - 1) / TileSize;
+    pixels.assign(size_t(width) * height, float4{0,0,0,0});
+    tileSegmentCounts.assign(size_t(tilesX) * tilesY, 0);
+    paths.clear();
+    cvs.clear();
+}
+
+void vgerTileRasterizer::addPath(const float2* pathCVs, int segmentCount, const vgerPaint& paint, const vgerAffine& pixelToLocal) {
+
+    if(segmentCount == 0 or paint.image != -1) {
+        return;
+    }
+
+    Path path;
+    path.paint = paint;
+    path.pixelToLocal = pixelToLocal;
+    path.start = int(cvs.size() / 3);
+    path.count = segmentCount;
+    path.min = FLT_MAX;
+    path.max = -FLT_MAX;
+
+    for(int i=0;i<segmentCount*3;++i) {
+        cvs.push_back(pathCVs[i]);
+        path.min = simd_min(path.min, pathCVs[i]);
+        path.max = simd_max(path.max, pathCVs[i]);
+    }
+
+    // Entirely off screen. Pixels outside a closed path have even parity,
+    // so we can ignore paths to the right too.
+    if(path.max.x + 1 <= 0 or path.max.y + 1 <= 0 or path.min.x - 1 >= width or path.min.y - 1 >= height) {
+        cvs.resize(path.start * 3);
+        return;
+    }
+
+    paths.push_back(path);
+}
+
+void vgerTileRasterizer::render() {
+
+    tileSegmentCounts.assign(size_t(tilesX) * tilesY, 0);
+
+    // Bin segments into tile rows with a counting sort, so each row only
+    // sees its own segments. Within a row, segments stay in path order.
+    rowStart.assign(tilesY + 1, 0);
+    for(int pi=0;pi<int(paths.size());++pi) {
+        auto& path = paths[pi];
+        for(int s=path.start;s<path.start+path.count;++s) {
+            int ty0, ty1;
+            if(tileRows(cvs.data() + 3*s, tilesY, height, ty0, ty1)) {
+                for(int ty=ty0;ty<=ty1;++ty) {
+                    ++rowStart[ty+1];
+                }
+            }
+        }
+    }
+
+    for(int ty=0;ty<tilesY;++ty) {
+        rowStart[ty+1] += rowStart[ty];
+    }
+
+    rowSegments.resize(rowStart[tilesY]);
+    active.resize(rowStart[tilesY]);
+    rowFill.assign(rowStart.begin(), rowStart.end() - 1);
+
+    for(int pi=0;pi<int(paths.size());++pi) {
+        auto& path = paths[pi];
+        for(int s=path.start;s<path.start+path.count;++s) {
+            auto p = cvs.data() + 3*s;
+            int ty0, ty1;
+            if(tileRows(p, tilesY, height, ty0, ty1)) {
+                RowSegment seg = {p[0], p[1], p[2],
+                    std::min(p[0].x, std::min(p[1].x, p[2].x)) - 1,
+                    std::max(p[0].x, std::max(p[1].x, p[2].x)) + 1,
+                    pi};
+                for(int ty=ty0;ty<=ty1;++ty) {
+                    rowSegments[rowFill[ty]++] = seg;
+                }
+            }
+        }
+    }
+
+    vgerParallelFor(tilesY, [&](size_t ty) {
+
+        float y0 = float(ty * TileSize);
+        float y1 = std::min(y0 + TileSize, float(height));
+        int rows = int(y1 - y0);
+        auto counts = tileSegmentCounts.data() + ty * tilesX;
+
+        auto rowEnd = rowSegments.data() + rowStart[ty+1];
+
+        for(auto segs = rowSegments.data() + rowStart[ty]; segs < rowEnd; ) {
+
+            auto& path = paths[segs->path];
+            auto segsEnd = segs;
+            while(segsEnd < rowEnd and segsEnd->path == segs->path) {
+                ++segsEnd;
+            }
+
+            // Sweep right to left. Segments join the active list once they
+            // reach the current tile, in order of xmax, and move into the
+            // backdrop once they're entirely to its right. Each tile only
+            // looks at the segments which touch it.
+            std::sort(segs, segsEnd, [](const RowSegment& a, const RowSegment& b) {
+                return a.xmax > b.xmax;
+            });
+
+            auto act = active.data() + (segs - rowSegments.data());
+            int activeCount = 0;
+            auto next = segs;
+
+            // Bit r is the parity of pixel row r due to segments to the right.
+            uint32_t backdrop = 0;
+
+            int txLast = std::min(tilesX - 1, int(floorf((path.max.x + 1) / TileSize)));
+            int txFirst = std::max(0, int(floorf((path.min.x - 1) / TileSize)));
+
+            for(int tx = txLast; tx >= 0; --tx) {
+
+                int x0 = tx * TileSize;
+                int x1 = std::min(x0 + TileSize, width);
+
+                for(;next < segsEnd and next->xmax > x0; ++next) {
+                    act[activeCount++] = uint32_t(next - segs);
+                }
+
+                int n = 0;
+                for(int i=0;i<activeCount;++i) {
+                    auto& seg = segs[act[i]];
+                    if(seg.xmin >= x1) {
+                        for(int r=0;r<rows;++r) {
+                            float y = y0 + r + 0.5f;
+                            if((seg.a.y < y) != (seg.c.y < y)) {
+                                backdrop ^= 1u << r;
+                            }
+                        }
+                    } else {
+                        act[n++] = act[i];
+                    }
+                }
+                activeCount = n;
+
+                counts[tx] += uint32_t(activeCount);
+
+                // Nothing touches this tile, so it's solid or empty per row.
+                // Everything further left is the same.
+                if(activeCount == 0 and tx < txFirst) {
+                    x0 = 0;
+                    tx = 0;
+                }
+
+                for(int r=0;r<rows;++r) {
+
+                    auto row = pixels.data() + size_t(y0 + r) * width;
+                    bool inside = (backdrop >> r) & 1;
+                    float y = y0 + r + 0.5f;
+
+                    if(activeCount == 0) {
+                        if(inside) {
+                            for(int x=x0;x<x1;++x) {
+                                auto p = affineApply(path.pixelToLocal, float2{x + 0.5f, y});
+                                blend(row[x], applyPaint(path.paint, p));
+                            }
+                        }
+                        continue;
+                    }
+
+                    Row px = rampN<Row>(x0 + 0.5f, 1);
+                    Row py = splatN<Row>(y);
+                    vgerLanes<Row>::Mask in = {};
+                    if(inside) {
+                        in = ~in;
+                    }
+                    Row d = splatN<Row>(FLT_MAX);
+
+                    for(int i=0;i<activeCount;++i) {
+                        auto& seg = segs[act[i]];
+                        in ^= lineTestN(px, py, seg.a, seg.c);
+                        in ^= bezierTestN(px, py, seg.a, seg.b, seg.c);
+                        d = simd_min(d, udBezierN(px, py, seg.a, seg.b, seg.c));
+                    }
+
+                    // 1 - smoothstep(-fw/2, fw/2, d)
+                    Row t = simd_clamp((selectN(d, -d, in) + FilterWidth/2) / FilterWidth, 0.0f, 1.0f);
+                    Row coverage = 1.0f - t*t*(3.0f - 2.0f*t);
+
+                    for(int x=x0;x<x1;++x) {
+                        float c = coverage[x - x0];
+                        if(c > 0) {
+                            auto p = affineApply(path.pixelToLocal, float2{x + 0.5f, y});
+                            auto color = applyPaint(path.paint, p);
+                            color.w *= c;
+                            blend(row[x], color);
+                        }
+                    }
+                }
+            }
+
+            segs = segsEnd;
+        }
+    });
+}
+
+void vgerTileRasterizer::getPixels(uint8_t* out, int bytesPerRow, bool bgra) const {
+    for(int y=0;y<height;++y) {
+        auto dst = out + size_t(y) * bytesPerRow;
+        auto row = pixels.data() + size_t(y) * width;
+        for(int x=0;x<width;++x) {
+            auto c = simd_clamp(row[x], 0.0f, 1.0f) * 255.0f + 0.5f;
+            if(bgra) {
+                std::swap(c.x, c.z);
+            }
+            dst[4*x+0] = uint8_t(c.x);
+            dst[4*x+1] = uint8_t(c.y);
+            dst[4*x+2] = uint8_t(c.z);
+            dst[4*x+3] = uint8_t(c.w);
+        }
+    }
+}
@@ -0,0 +1,144 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#include "../vger/include/vger.h"
+#include "../vger/vgerTrace.h"
+#include <stdio.h>
+
+#ifdef VGER_TRACING
+
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <atomic>
+#ifdef __APPLE__
+#include <pthread.h>
+#endif
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start; // microseconds
+    uint64_t duration;
+};
+
+/// Each thread records into its own ring, so zones don't contend. The
+/// lock is only shared with vgerWriteTrace. When the ring is full, the
+/// oldest events are overwritten.
+struct TraceBuffer {
+    std::mutex mutex;
+    uint64_t tid;
+    std::vector<TraceEvent> events;
+
+    /// Events recorded since the last write. Only the last
+    /// vgerTraceEventsPerThread are kept.
+    uint64_t count = 0;
+
+    TraceBuffer(uint64_t tid) : tid(tid), events(vgerTraceEventsPerThread) { }
+};
+
+/// Buffers of every thread which has recorded a zone. Buffers are shared
+/// with their thread, so events outlive it until they're written.
+std::mutex registryMutex;
+std::vector<std::shared_ptr<TraceBuffer>> registry;
+
+uint64_t threadID() {
+#ifdef __APPLE__
+    uint64_t tid = 0;
+    pthread_threadid_np(nullptr, &tid);
+    return tid;
+#else
+    // Numbered in order of first use.
+    static std::atomic<uint64_t> nextID{1};
+    return nextID++;
+#endif
+}
+
+TraceBuffer& threadBuffer() {
+    thread_local std::shared_ptr<TraceBuffer> buffer;
+    if(!buffer) {
+        buffer = std::make_shared<TraceBuffer>(threadID());
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(buffer);
+    }
+    return *buffer;
+}
+
+uint64_t now() {
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(t).count();
+}
+
+}
+
+vgerTraceZone::vgerTraceZone(const char* name) : name(name), start(now()) { }
+
+vgerTraceZone::~vgerTraceZone() {
+    auto& buffer = threadBuffer();
+    TraceEvent event{name, start, now() - start};
+
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events[buffer.count % vgerTraceEventsPerThread] = event;
+    ++buffer.count;
+}
+
+bool vgerWriteTrace(const char* path) {
+
+    struct ThreadEvents {
+        uint64_t tid;
+        std::vector<TraceEvent> events;
+    };
+
+    // Take the events, oldest first, so zones can keep recording while
+    // the file is written.
+    std::vector<ThreadEvents> threads;
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+
+        for(auto& buffer : registry) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            auto n = std::min(buffer->count, uint64_t(vgerTraceEventsPerThread));
+            dropped += buffer->count - n;
+
+            ThreadEvents t{buffer->tid};
+            t.events.reserve(n);
+            for(auto i = buffer->count - n; i < buffer->count; ++i) {
+                t.events.push_back(buffer->events[i % vgerTraceEventsPerThread]);
+            }
+            buffer->count = 0;
+            threads.push_back(std::move(t));
+        }
+
+        // Forget threads which have exited.
+        std::erase_if(registry, [](auto& buffer) { return buffer.use_count() == 1; });
+    }
+
+    auto file = fopen(path, "w");
+    if(!file) {
+        return false;
+    }
+
+    fprintf(file, "{\"traceEvents\":[");
+    const char* separator = "\n";
+    for(auto& t : threads) {
+        for(auto& e : t.events) {
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%llu,\"ts\":%llu,\"dur\":%llu}",
+                    separator, e.name, (unsigned long long) t.tid, (unsigned long long) e.start,
+                    (unsigned long long) e.duration);
+            separator = ",\n";
+        }
+    }
+    fprintf(file, "\n],\n\"otherData\":{\"droppedEvents\":%llu}}\n", (unsigned long long) dropped);
+
+    return fclose(file) == 0;
+}
+
+#else
+
+bool vgerWriteTrace(const char* path) {
+    return false;
+}
+
+#endif
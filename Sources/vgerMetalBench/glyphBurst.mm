@@ -0,0 +1,113 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#import <Metal/Metal.h>
+#import "vger.h"
+#include "../vger/vger_private.h"
+#include "metalBench.h"
+#include <chrono>
+
+using namespace simd;
+
+namespace {
+
+constexpr int burstFrames = 30;
+
+/// Frame the dialog opens in.
+constexpr int dialogFrame = 5;
+
+/// Each printable character at this many sizes is about 2,000 new glyphs.
+constexpr int dialogSizes = 22;
+
+/// Draws a frame, and the dialog from dialogFrame on, then updates the
+/// glyph atlas, as encoding would.
+void drawFrame(vgerContext vg, id<MTLCommandQueue> queue, int frame, const std::string& text) {
+
+    vgerBegin(vg, 1024, 1024, 2.0);
+    vgerText(vg, "Status: ready", float4{1,1,1,1}, 0);
+
+    if(frame >= dialogFrame) {
+        for(int i=0;i<dialogSizes;++i) {
+            float scale = 1.0f + i * 0.25f;
+            vgerSave(vg);
+            vgerTranslate(vg, float2{0, 40.0f * i});
+            vgerScale(vg, float2{scale, scale});
+            vgerText(vg, text.c_str(), float4{1,1,1,1}, 0);
+            vgerRestore(vg);
+        }
+    }
+
+    auto buf = [queue commandBuffer];
+    [vg->glyphCache update:buf];
+    [buf commit];
+}
+
+}
+
+void addGlyphBurstBenchmarks(std::vector<Benchmark>& benchmarks) {
+
+    auto device = MTLCreateSystemDefaultDevice();
+    if(!device) {
+        fprintf(stderr, "vgerBench: no Metal device, skipping glyph burst\n");
+        return;
+    }
+
+    std::string text;
+    for(char c='!';c<='~';++c) {
+        text += c;
+    }
+
+    std::pair<const char*, vgerGlyphRasterMode> modes[] = {
+        {"GlyphBurst/sync", VGER_GLYPHS_SYNC},
+        {"GlyphBurst/wait", VGER_GLYPHS_ASYNC_WAIT},
+        {"GlyphBurst/placeholder", VGER_GLYPHS_ASYNC_PLACEHOLDER},
+    };
+
+    // Items are frames. Each iteration starts with a new context, so the
+    // dialog's glyphs are all new.
+    for(auto& m : modes) {
+
+        auto mode = m.second;
+        benchmarks.push_back({m.first, [=](BenchState& state) {
+
+            auto queue = [device newCommandQueue];
+
+            double worstFrame = 0;
+            int64_t newGlyphs = 0;
+            int64_t framesUntilDrawn = 0;
+
+            for(int64_t it=0;it<state.iterations;++it) {
+
+                auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+                vgerSetGlyphRasterMode(vg, mode);
+
+                int glyphsBefore = 0;
+                int drawnFrame = burstFrames;
+
+                for(int frame=0;frame<burstFrames;++frame) {
+
+                    if(frame == dialogFrame) {
+                        glyphsBefore = vg->glyphCache.count;
+                    }
+
+                    auto start = std::chrono::steady_clock::now();
+                    drawFrame(vg, queue, frame, text);
+                    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                    worstFrame = std::max(worstFrame, elapsed.count());
+
+                    if(frame >= dialogFrame and drawnFrame == burstFrames and vg->glyphCache.pendingCount == 0) {
+                        drawnFrame = frame;
+                    }
+                }
+
+                newGlyphs += vg->glyphCache.count - glyphsBefore;
+                framesUntilDrawn += drawnFrame - dialogFrame;
+                vgerDelete(vg);
+            }
+
+            state.itemsProcessed = state.iterations * burstFrames;
+            state.counters["new_glyphs"] = double(newGlyphs) / state.iterations;
+            state.counters["worst_frame_ms"] = worstFrame;
+            state.counters["frames_until_drawn"] = double(framesUntilDrawn) / state.iterations;
+        }});
+    }
+}
@@ -0,0 +1,91 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#import <Metal/Metal.h>
+#import "vger.h"
+#include "../vger/vger_private.h"
+#include "metalBench.h"
+#include <random>
+#include <chrono>
+
+using namespace simd;
+
+namespace {
+
+constexpr int churnFrames = 200;
+constexpr int stringsPerFrame = 40;
+
+}
+
+void addGlyphChurnBenchmarks(std::vector<Benchmark>& benchmarks) {
+
+    auto device = MTLCreateSystemDefaultDevice();
+    if(!device) {
+        fprintf(stderr, "vgerBench: no Metal device, skipping glyph churn\n");
+        return;
+    }
+
+    // Items are frames. Sizes are quantized so some glyphs are reused.
+    benchmarks.push_back({"GlyphChurn", [device](BenchState& state) {
+
+        auto queue = [device newCommandQueue];
+        auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> letter('A', 'z');
+        std::uniform_int_distribution<int> length(4, 12);
+        std::uniform_int_distribution<int> size(0, 63);
+        std::uniform_real_distribution<float> position(0, 1024);
+
+        double worstFrame = 0;
+        int64_t evictions = 0;
+        int64_t resets = 0;
+        int64_t rasterized = 0;
+
+        for(int64_t it=0;it<state.iterations;++it) {
+            for(int frame=0;frame<churnFrames;++frame) {
+
+                auto start = std::chrono::steady_clock::now();
+                auto cache = vg->glyphCache;
+
+                vgerBegin(vg, 1024, 1024, 2.0);
+                for(int i=0;i<stringsPerFrame;++i) {
+                    std::string str;
+                    for(int n=length(rng);n;--n) {
+                        str += char(letter(rng));
+                    }
+                    float scale = 0.5f + size(rng) * 0.125f;
+                    vgerSave(vg);
+                    vgerTranslate(vg, float2{position(rng), position(rng)});
+                    vgerScale(vg, float2{scale, scale});
+                    vgerText(vg, str.c_str(), float4{1,1,1,1}, 0);
+                    vgerRestore(vg);
+                }
+
+                auto buf = [queue commandBuffer];
+                [vg->glyphCache update:buf];
+                [buf commit];
+
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                worstFrame = std::max(worstFrame, elapsed.count());
+
+                // The atlas was full, even after evicting.
+                if(cache != vg->glyphCache) {
+                    rasterized += cache.count;
+                    resets++;
+                }
+                evictions += vg->glyphCache.evictedCount;
+            }
+        }
+
+        rasterized += vg->glyphCache.count;
+        auto frames = double(state.iterations * churnFrames);
+
+        state.itemsProcessed = state.iterations * churnFrames;
+        state.counters["rasterizations_per_frame"] = rasterized / frames;
+        state.counters["evictions_per_frame"] = evictions / frames;
+        state.counters["atlas_resets"] = resets;
+        state.counters["worst_frame_ms"] = worstFrame;
+
+        vgerDelete(vg);
+    }});
+}
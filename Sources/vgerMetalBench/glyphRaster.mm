@@ -0,0 +1,90 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#import <Foundation/Foundation.h>
+#import <CoreGraphics/CoreGraphics.h>
+#import <CoreText/CoreText.h>
+#include "metalBench.h"
+#include <math.h>
+#include <memory>
+
+namespace {
+
+/// Same as the glyph cache.
+constexpr int margin = 4;
+constexpr float fontSize = 12;
+
+/// Rasterizes a glyph as vgerGlyphCache does with CoreGraphics. Returns
+/// false for glyphs without outlines.
+bool rasterizeCoreGraphics(CTFontRef ctFont, CGGlyph glyph, float scale, std::vector<uint8_t>& image) {
+
+    CGRect boundingRect;
+    CTFontGetBoundingRectsForGlyphs(ctFont, kCTFontOrientationHorizontal, &glyph, &boundingRect, 1);
+    auto glyphTransform = CGAffineTransformMakeTranslation(-boundingRect.origin.x, -boundingRect.origin.y);
+    auto path = CTFontCreatePathForGlyph(ctFont, glyph, &glyphTransform);
+    if(!path) {
+        return false;
+    }
+
+    int width = ceilf(boundingRect.size.width * scale) + 2*margin;
+    int height = ceilf(boundingRect.size.height * scale) + 2*margin;
+    image.resize(width*height);
+
+    auto colorSpace = CGColorSpaceCreateDeviceGray();
+    auto context = CGBitmapContextCreate(image.data(), width, height, 8, width, colorSpace,
+                                         kCGBitmapAlphaInfoMask & kCGImageAlphaNone);
+
+    CGContextTranslateCTM(context, margin, margin);
+    CGContextScaleCTM(context, scale, scale);
+    CGContextSetRGBFillColor(context, 0, 0, 0, 1);
+    CGContextFillRect(context, CGRectMake(0, 0, width, height));
+    CGContextSetRGBFillColor(context, 1, 1, 1, 1);
+    CGContextAddPath(context, path);
+    CGContextFillPath(context);
+
+    CGPathRelease(path);
+    CGContextRelease(context);
+    CGColorSpaceRelease(colorSpace);
+    return true;
+}
+
+}
+
+void addGlyphRasterBenchmarks(std::vector<Benchmark>& benchmarks, const char* fontPath) {
+
+    auto url = [NSURL fileURLWithPath:@(fontPath)];
+    auto fd = CTFontManagerCreateFontDescriptorsFromURL((__bridge CFURLRef) url);
+    if(!fd or CFArrayGetCount(fd) == 0) {
+        fprintf(stderr, "vgerBench: couldn't load %s, skipping glyph raster\n", fontPath);
+        if(fd) {
+            CFRelease(fd);
+        }
+        return;
+    }
+
+    auto ctFont = std::shared_ptr<const __CTFont>(
+        CTFontCreateWithFontDescriptor((CTFontDescriptorRef) CFArrayGetValueAtIndex(fd, 0), fontSize, nil),
+        CFRelease);
+    CFRelease(fd);
+
+    // The same glyphs as GlyphRaster/portable, since vgerFont's glyph
+    // indices are CoreText's.
+    int glyphCount = int(CTFontGetGlyphCount(ctFont.get()));
+
+    // Items are glyphs. Each iteration rasterizes every glyph in the font.
+    for(int size : {12, 24, 48}) {
+
+        float scale = size / fontSize;
+
+        benchmarks.push_back({"GlyphRaster/coregraphics/" + std::to_string(size), [=](BenchState& state) {
+            std::vector<uint8_t> image;
+            int64_t glyphs = 0;
+            for(int64_t it=0;it<state.iterations;++it) {
+                for(int g=0;g<glyphCount;++g) {
+                    glyphs += rasterizeCoreGraphics(ctFont.get(), g, scale, image);
+                    doNotOptimize(image.data());
+                }
+            }
+            state.itemsProcessed = glyphs;
+        }});
+    }
+}
@@ -0,0 +1,97 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#import <Metal/Metal.h>
+#import "vger.h"
+#include "../vger/vger_private.h"
+#include "metalBench.h"
+#include <math.h>
+
+using namespace simd;
+
+namespace {
+
+/// Frames in one zoom from 0.5x to 8x.
+constexpr int sweepFrames = 120;
+
+const char* sweepText = "The quick brown fox jumps over the lazy dog 0123456789";
+
+/// Draws a frame of the zoom and updates the glyph atlas, as encoding
+/// would.
+void drawFrame(vgerContext vg, id<MTLCommandQueue> queue, int frame) {
+
+    float zoom = 0.5f * powf(16.0f, float(frame) / (sweepFrames - 1));
+
+    vgerBegin(vg, 1024, 1024, 2.0);
+    vgerSave(vg);
+    vgerScale(vg, float2{zoom, zoom});
+    for(int line=0;line<4;++line) {
+        vgerSave(vg);
+        vgerTranslate(vg, float2{0, 20.0f * line});
+        vgerText(vg, sweepText, float4{1,1,1,1}, 0);
+        vgerRestore(vg);
+    }
+    vgerRestore(vg);
+
+    auto buf = [queue commandBuffer];
+    [vg->glyphCache update:buf];
+    [buf commit];
+}
+
+}
+
+void addGlyphZoomBenchmarks(std::vector<Benchmark>& benchmarks) {
+
+    auto device = MTLCreateSystemDefaultDevice();
+    if(!device) {
+        fprintf(stderr, "vgerBench: no Metal device, skipping glyph zoom\n");
+        return;
+    }
+
+    for(bool sdf : {false, true}) {
+
+        // Items are frames. Each sweep starts with a new context, so the
+        // counters include generating every glyph.
+        benchmarks.push_back({sdf ? "GlyphZoom/sdf" : "GlyphZoom/bitmap", [sdf, device](BenchState& state) {
+
+            auto queue = [device newCommandQueue];
+
+            double generationTime = 0;
+            uint32_t resets = 0;
+            int entries = 0;
+            float usage = 0;
+
+            for(int64_t it=0;it<state.iterations;++it) {
+
+                auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+                vgerSetSDFGlyphs(vg, sdf);
+
+                for(int frame=0;frame<sweepFrames;++frame) {
+                    auto cache = vg->glyphCache;
+                    drawFrame(vg, queue, frame);
+
+                    vgerStats stats;
+                    vgerGetStats(vg, &stats);
+                    // Glyphs are generated on text cache misses, so this
+                    // includes typesetting.
+                    generationTime += stats.textLayoutTime;
+                    resets += stats.glyphAtlasResets;
+
+                    // Count glyphs in atlases replaced during the frame too.
+                    if(cache != vg->glyphCache) {
+                        entries += cache.count;
+                    }
+                }
+
+                entries += vg->glyphCache.count;
+                usage = vg->glyphCache.usage;
+                vgerDelete(vg);
+            }
+
+            state.itemsProcessed = state.iterations * sweepFrames;
+            state.counters["atlas_entries"] = double(entries) / state.iterations;
+            state.counters["atlas_usage"] = usage;
+            state.counters["atlas_resets"] = double(resets) / state.iterations;
+            state.counters["generation_ms"] = generationTime / state.iterations;
+        }});
+    }
+}
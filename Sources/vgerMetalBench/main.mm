@@ -0,0 +1,22 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+// Benchmarks which need a Metal device (or CoreGraphics). The portable
+// ones are in vgerBench.
+//
+//     swift run -c release vgerMetalBench [--benchmark_filter=<regex>]
+//         [--benchmark_format=console|json] [--benchmark_out=<file>]
+//         [--benchmark_min_time=<seconds>] [--svg_dir=<dir>] [--font=<ttf>]
+
+#include "metalBench.h"
+
+int main(int argc, const char* argv[]) {
+    return benchMain(argc, argv, [](const BenchFlags& flags) {
+        std::vector<Benchmark> benchmarks;
+        addSVGCorpusBenchmarks(benchmarks, flags.svgDir);
+        addGlyphZoomBenchmarks(benchmarks);
+        addGlyphChurnBenchmarks(benchmarks);
+        addGlyphRasterBenchmarks(benchmarks, flags.fontPath);
+        addGlyphBurstBenchmarks(benchmarks);
+        return benchmarks;
+    });
+}
@@ -0,0 +1,29 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#pragma once
+
+#include "bench.h"
+
+/// Adds a benchmark for each SVG in dir, which records it with the vger
+/// API (fills and strokes). Needs a Metal device to create a context.
+void addSVGCorpusBenchmarks(std::vector<Benchmark>& benchmarks, const char* dir);
+
+/// Adds benchmarks which zoom text from 0.5x to 8x with coverage and
+/// distance field glyphs, reporting glyph atlas entries and generation
+/// time. Needs a Metal device.
+void addGlyphZoomBenchmarks(std::vector<Benchmark>& benchmarks);
+
+/// Adds a benchmark which draws random strings at random sizes, so glyphs
+/// are evicted from the atlas, reporting rasterizations per frame and the
+/// worst frame time. Needs a Metal device.
+void addGlyphChurnBenchmarks(std::vector<Benchmark>& benchmarks);
+
+/// Adds benchmarks which rasterize every glyph of a font with CoreGraphics
+/// at a few pixel sizes. vgerBench rasterizes the same glyphs with
+/// vgerGlyphRasterizer.
+void addGlyphRasterBenchmarks(std::vector<Benchmark>& benchmarks, const char* fontPath);
+
+/// Adds benchmarks which open a "dialog" with about 2,000 new glyphs with
+/// each vgerGlyphRasterMode, reporting the worst frame time and how many
+/// frames the glyphs took to appear. Needs a Metal device.
+void addGlyphBurstBenchmarks(std::vector<Benchmark>& benchmarks);
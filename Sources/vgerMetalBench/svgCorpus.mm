@@ -0,0 +1,177 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#import <Metal/Metal.h>
+#import "vger.h"
+#include "../vger/vger_private.h"
+#include "../vger/bezier.h"
+#include "metalBench.h"
+#include "nanosvg.h"
+#include <dirent.h>
+#include <algorithm>
+
+using namespace simd;
+
+namespace {
+
+/// Window the SVGs are scaled to fit.
+constexpr float windowSize = 1024;
+
+float4 svgColor(const NSVGpaint& paint, float opacity) {
+    auto c = paint.color;
+    if(paint.type != NSVG_PAINT_COLOR and paint.gradient->nstops) {
+        // Gradients aren't converted. Use the first stop.
+        c = paint.gradient->stops[0].color;
+    }
+    auto color = float4{
+        float((c >> 0) & 0xff),
+        float((c >> 8) & 0xff),
+        float((c >> 16) & 0xff),
+        float((c >> 24) & 0xff)
+    } * 1.0/255.0;
+    color.w *= opacity;
+    return color;
+}
+
+/// Draws an SVG with the vger API. Returns the number of quadratic
+/// segments sent, counting two per cubic.
+size_t drawSVG(vgerContext vg, NSVGimage* image, float scale) {
+
+    size_t segments = 0;
+
+    vgerSave(vg);
+    vgerTranslate(vg, float2{0, windowSize});
+    vgerScale(vg, float2{scale, -scale});
+
+    for(auto shape = image->shapes; shape; shape = shape->next) {
+
+        if(!(shape->flags & NSVG_FLAGS_VISIBLE)) {
+            continue;
+        }
+
+        if(shape->fill.type != NSVG_PAINT_NONE) {
+            auto paint = vgerColorPaint(vg, svgColor(shape->fill, shape->opacity));
+            for(auto path = shape->paths; path; path = path->next) {
+                auto pts = (float2*) path->pts;
+                vgerMoveTo(vg, pts[0]);
+                for(int i=1; i<path->npts-2; i+=3) {
+                    vgerCubicApproxTo(vg, pts[i], pts[i+1], pts[i+2]);
+                    segments += 2;
+                }
+            }
+            vgerFill(vg, paint);
+        }
+
+        if(shape->stroke.type != NSVG_PAINT_NONE and shape->strokeWidth > 0) {
+            auto paint = vgerColorPaint(vg, svgColor(shape->stroke, shape->opacity));
+            for(auto path = shape->paths; path; path = path->next) {
+                auto pts = (float2*) path->pts;
+                for(int i=0; i<path->npts-3; i+=3) {
+                    float2 cubic[4] = {pts[i], pts[i+1], pts[i+2], pts[i+3]};
+                    float2 q[6];
+                    approx_cubic(cubic, q);
+                    // vgerStrokeBezier's width is the distance from the curve.
+                    vgerStrokeBezier(vg, {q[0], q[1], q[2]}, shape->strokeWidth / 2, paint);
+                    vgerStrokeBezier(vg, {q[3], q[4], q[5]}, shape->strokeWidth / 2, paint);
+                    segments += 2;
+                }
+            }
+        }
+    }
+
+    vgerRestore(vg);
+
+    return segments;
+}
+
+/// An SVG and a context to draw it with, loaded on first use so skipped
+/// benchmarks cost nothing.
+struct SVGScene {
+    std::string path;
+    NSVGimage* image = nullptr;
+    vgerContext vg = nullptr;
+    float scale = 1;
+
+    SVGScene(const std::string& path) : path(path) { }
+
+    ~SVGScene() {
+        if(vg) {
+            vgerDelete(vg);
+        }
+        if(image) {
+            nsvgDelete(image);
+        }
+    }
+
+    bool load() {
+        if(!image) {
+            image = nsvgParseFromFile(path.c_str(), "px", 96);
+            if(!image) {
+                fprintf(stderr, "vgerBench: couldn't parse %s\n", path.c_str());
+                return false;
+            }
+            scale = windowSize / std::max({image->width, image->height, 1.0f});
+            vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+        }
+        return true;
+    }
+};
+
+}
+
+void addSVGCorpusBenchmarks(std::vector<Benchmark>& benchmarks, const char* dir) {
+
+    auto d = opendir(dir);
+    if(!d) {
+        fprintf(stderr, "vgerBench: couldn't open %s, skipping SVG corpus\n", dir);
+        return;
+    }
+
+    std::vector<std::string> files;
+    while(auto entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if(name.size() > 4 and name.compare(name.size() - 4, 4, ".svg") == 0) {
+            files.push_back(name);
+        }
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+
+    if(files.size() and !MTLCreateSystemDefaultDevice()) {
+        fprintf(stderr, "vgerBench: no Metal device, skipping SVG corpus\n");
+        return;
+    }
+
+    for(auto& name : files) {
+
+        auto scene = std::make_shared<SVGScene>(std::string(dir) + "/" + name);
+
+        benchmarks.push_back({"SVG/" + name, [scene](BenchState& state) {
+
+            if(!scene->load()) {
+                return;
+            }
+
+            auto vg = scene->vg;
+            size_t segments = 0;
+            for(int64_t it=0;it<state.iterations;++it) {
+                vgerBegin(vg, windowSize, windowSize, 1.0);
+                segments = drawSVG(vg, scene->image, scene->scale);
+            }
+
+            vgerStats stats;
+            vgerGetStats(vg, &stats);
+
+            uint32_t prims = 0;
+            for(int type=0;type<VGER_STATS_PRIM_TYPES;++type) {
+                prims += stats.prims[0][type];
+            }
+
+            state.itemsProcessed = state.iterations * segments;
+            state.counters["segments"] = segments;
+            state.counters["slabs"] = stats.pathFillSlabs;
+            state.counters["prims"] = prims;
+            state.counters["cv_bytes"] = double(vg->scenes[vg->currentScene].cvs.count) * sizeof(float2);
+            state.counters["segment_tests_per_pixel"] = vg->scenes[vg->currentScene].segmentTestsPerPixel(0, scene->scale);
+        }});
+    }
+}
@@ -0,0 +1,184 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <Metal/Metal.h>
+#import "../../Sources/vger/bezier.h"
+#import "../../Sources/vger/vger_private.h"
+#include <vector>
+#include <chrono>
+
+@interface bezierTests : XCTestCase
+
+@end
+
+@implementation bezierTests
+
+static float2 evalCubic(const float2 b[4], float t) {
+    float s = 1 - t;
+    return s*s*s*b[0] + 3*s*s*t*b[1] + 3*s*t*t*b[2] + t*t*t*b[3];
+}
+
+static float2 evalQuad(float2 a, float2 b, float2 c, float t) {
+    float s = 1 - t;
+    return s*s*a + 2*s*t*b + t*t*c;
+}
+
+/// Largest distance from a point in a to the closest point in b.
+static float directedHausdorff(const std::vector<float2>& a, const std::vector<float2>& b) {
+    float d = 0;
+    for(auto p : a) {
+        float closest = FLT_MAX;
+        for(auto q : b) {
+            closest = std::min(closest, simd_distance(p, q));
+        }
+        d = std::max(d, closest);
+    }
+    return d;
+}
+
+/// Hausdorff distance between a cubic and quadratics (three points each),
+/// by dense sampling.
+static float hausdorffError(const float2 cubic[4], const std::vector<float2>& quads) {
+    const int samples = 400;
+
+    std::vector<float2> a, b;
+    for(int i=0;i<=samples;++i) {
+        a.push_back(evalCubic(cubic, float(i) / samples));
+    }
+
+    auto n = quads.size() / 3;
+    int perQuad = std::max(samples / int(n), 8);
+    for(size_t j=0;j<n;++j) {
+        for(int i=0;i<=perQuad;++i) {
+            b.push_back(evalQuad(quads[3*j], quads[3*j+1], quads[3*j+2], float(i) / perQuad));
+        }
+    }
+
+    return std::max(directedHausdorff(a, b), directedHausdorff(b, a));
+}
+
+static std::vector<float2> adaptiveQuads(const float2 cubic[4], float tolerance) {
+    std::vector<float2> quads;
+    auto pen = cubic[0];
+    approx_cubic_adaptive(cubic, tolerance, [&](float2 q, float2 end) {
+        quads.insert(quads.end(), {pen, q, end});
+        pen = end;
+    });
+    return quads;
+}
+
+- (void) testAdaptiveError {
+
+    float2 cubics[][4] = {
+        {{0,0}, {100,300}, {300,-200}, {400,100}}, // S curve
+        {{0,0}, {0,100}, {100,100}, {100,0}},      // arch
+        {{0,0}, {200,200}, {-100,200}, {100,0}},   // loop
+        {{0,0}, {10,50}, {20,-50}, {500,0}},       // long and nearly flat
+    };
+
+    for(auto& cubic : cubics) {
+
+        float2 fixed[6];
+        approx_cubic(cubic, fixed);
+        std::vector<float2> fixedQuads = {fixed[0], fixed[1], fixed[2], fixed[3], fixed[4], fixed[5]};
+        auto fixedError = hausdorffError(cubic, fixedQuads);
+
+        for(float tolerance : {4.0f, 1.0f, 0.25f, 0.05f}) {
+            auto quads = adaptiveQuads(cubic, tolerance);
+            auto error = hausdorffError(cubic, quads);
+
+            printf("tolerance %g: %d quads, error %f (approx_cubic: %f)\n",
+                   tolerance, int(quads.size() / 3), error, fixedError);
+
+            // Allow for sampling.
+            XCTAssertLessThanOrEqual(error, tolerance * 1.01 + 0.01);
+            XCTAssertLessThanOrEqual(quads.size() / 3, maxCubicQuads);
+        }
+    }
+}
+
+- (void) testAdaptiveEndpoints {
+
+    float2 cubic[4] = {{0,0}, {100,300}, {300,-200}, {400,100}};
+    auto quads = adaptiveQuads(cubic, 0.1);
+
+    XCTAssertTrue(simd_equal(quads.front(), cubic[0]));
+    XCTAssertTrue(simd_equal(quads.back(), cubic[3]));
+
+    // Pieces are joined.
+    for(size_t i=3;i<quads.size();i+=3) {
+        XCTAssertTrue(simd_equal(quads[i], quads[i-1]));
+    }
+}
+
+- (void) testFlatCubics {
+
+    // A line.
+    float2 line[4] = {{0,0}, {1,1}, {2,2}, {3,3}};
+    XCTAssertEqual(cubic_quad_count(line, 0.01), 1);
+
+    // A quadratic raised to a cubic is matched exactly.
+    float2 a{0,0}, b{50,100}, c{100,0};
+    float2 raised[4] = {a, a + 2*(b-a)/3, c + 2*(b-c)/3, c};
+    XCTAssertEqual(cubic_quad_count(raised, 0.01), 1);
+
+    auto quads = adaptiveQuads(raised, 0.01);
+    XCTAssertEqual(quads.size(), 3);
+    XCTAssertLessThan(simd_distance(quads[1], b), 1e-4);
+}
+
+- (void) testCubicToTolerance {
+
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+
+    float2 cubic[4] = {{0,0}, {100,300}, {300,-200}, {400,100}};
+
+    vgerMoveTo(vg, cubic[0]);
+    vgerCubicTo(vg, cubic[1], cubic[2], cubic[3]);
+    auto segments = vg->yScanner.segments.size();
+    XCTAssertEqual(segments, cubic_quad_count(cubic, 0.25));
+    vgerCancelPath(vg);
+
+    // Zooming in needs more segments for the same error in pixels.
+    vgerScale(vg, float2{8, 8});
+    vgerMoveTo(vg, cubic[0]);
+    vgerCubicTo(vg, cubic[1], cubic[2], cubic[3]);
+    XCTAssertEqual(vg->yScanner.segments.size(), cubic_quad_count(cubic, 0.25 / 8));
+    XCTAssertGreaterThan(vg->yScanner.segments.size(), segments);
+    vgerCancelPath(vg);
+
+    vgerSetCubicTolerance(vg, 100);
+    vgerMoveTo(vg, cubic[0]);
+    vgerCubicTo(vg, cubic[1], cubic[2], cubic[3]);
+    XCTAssertEqual(vg->yScanner.segments.size(), 1);
+    vgerCancelPath(vg);
+
+    vgerDelete(vg);
+}
+
+- (void) testAdaptivePerf {
+
+    const int n = 100000;
+    std::vector<float2> cvs;
+    for(int i=0;i<n;++i) {
+        float x = i % 1000;
+        cvs.insert(cvs.end(), {float2{x, 0}, float2{x + 100, 300}, float2{x + 300, -200}, float2{x + 400, 100}});
+    }
+
+    for(float tolerance : {1.0f, 0.25f, 0.01f}) {
+        size_t quads = 0;
+        float2 sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(int i=0;i<n;++i) {
+            quads += approx_cubic_adaptive(&cvs[4*i], tolerance, [&](float2 q, float2 end) {
+                sum += q;
+            });
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printf("tolerance %g: %.1f quads per cubic, %.1fM segments/sec (%f)\n",
+               tolerance, double(quads) / n, quads / elapsed.count() * 1e-6, sum.x);
+    }
+}
+
+@end
@@ -3,8 +3,10 @@
 #import <XCTest/XCTest.h>
 #import <simd/simd.h>
 #include "vger.h"
+#include <vector>
 
 #import "../../Sources/vger/sdf.h"
+#import "../../Sources/vger/sdf_batch.h"
 
 @interface sdfTests : XCTestCase
 
@@ -145,4 +147,81 @@ static void checkSdBezier(float2 A, float2 B, float2 C) {
     checkSdBezier(a, float2{1, -1}, c);
 }
 
+static float randf(float lo, float hi) {
+    return lo + (hi - lo) * float(rand()) / RAND_MAX;
+}
+
+static float2 randPoint() {
+    return float2{randf(-2, 2), randf(-2, 2)};
+}
+
+/// Compare each lane of the batched functions against the scalar reference
+/// for a row of pixels.
+template<class V>
+static void checkBatchedRow(float y, float2 A, float2 B, float2 C) {
+
+    constexpr int n = vgerLanes<V>::width;
+    float x0 = -2, dx = 4.0f / n;
+    V px = rampN<V>(x0, dx);
+    V py = splatN<V>(y);
+
+    float2 sca{sinf(0.3f), cosf(0.3f)}, scb{sinf(1.2f), cosf(1.2f)};
+
+    V circle = sdCircleN(px, py, 1.5f);
+    V box = sdBoxN(px, py, float2{1, .5}, .2f);
+    V segment = sdSegment2N(px, py, A, C, .3f);
+    V arc = sdArc2N(px, py, sca, scb, 1.0f, .1f);
+    V bez = udBezierN(px, py, A, B, C);
+    V bezApprox = udBezierApproxN(px, py, A, B, C);
+    auto lines = lineTestN(px, py, A, C);
+    auto beziers = bezierTestN(px, py, A, B, C);
+
+    for(int i=0;i<n;++i) {
+        float2 p{px[i], y};
+        XCTAssertEqualWithAccuracy(circle[i], sdCircle(p, 1.5f), 1e-5);
+        XCTAssertEqualWithAccuracy(box[i], sdBox(p, float2{1, .5}, .2f), 1e-5);
+        XCTAssertEqualWithAccuracy(segment[i], sdSegment2(p, A, C, .3f), 1e-4);
+        XCTAssertEqualWithAccuracy(arc[i], sdArc2(p, sca, scb, 1.0f, .1f), 1e-4);
+        XCTAssertEqualWithAccuracy(bez[i], udBezier(p, A, B, C), 1e-3);
+        XCTAssertEqualWithAccuracy(bezApprox[i], udBezierApprox(p, A, B, C), 1e-3);
+        XCTAssertEqual(lines[i] != 0, lineTest(p, A, C));
+        XCTAssertEqual(beziers[i] != 0, bezierTest(p, A, B, C));
+    }
+}
+
+- (void) testBatched {
+
+    srand(42);
+
+    for(int i=0;i<200;++i) {
+        float2 A = randPoint(), B = randPoint(), C = randPoint();
+        float y = randf(-2, 2);
+        checkBatchedRow<simd_float4>(y, A, B, C);
+        checkBatchedRow<simd_float8>(y, A, B, C);
+        checkBatchedRow<simd_float16>(y, A, B, C);
+    }
+
+    // Collinear curves take the segment path.
+    checkBatchedRow<simd_float8>(0.1f, float2{-1,0}, float2{0,0}, float2{1,0});
+}
+
+- (void) testBatchedPerf {
+
+    constexpr int n = 1 << 16;
+    std::vector<float> out(n);
+    float2 A{-1,-1}, B{0,2}, C{1,-1};
+
+    [self measureBlock:^{
+        float* o = out.data();
+        for(int i=0;i<n;i+=16) {
+            auto px = rampN<simd_float16>(-2 + 4.0f * (i % 256) / 256, 4.0f / 256);
+            auto py = splatN<simd_float16>(-2 + 4.0f * (i / 256) / 256);
+            auto d = udBezierApproxN(px, py, A, B, C);
+            for(int j=0;j<16;++j) {
+                o[i+j] = d[j];
+            }
+        }
+    }];
+}
+
 @end
@@ -48,26 +48,42 @@ CGImageRef createImage(UInt8* data, NSUInteger w, NSUInteger h) {
 
 }
 
+/// Slices of array textures, such as the glyph atlas, are stacked
+/// vertically.
 CGImageRef createImage(id<MTLTexture> texture) {
 
     auto w = texture.width;
     auto h = texture.height;
-
-    std::vector<UInt8> imageBytes(4*w*h, 0);
+    auto slices = texture.arrayLength;
+
+    std::vector<UInt8> imageBytes(4*w*h*slices, 0);
+
+    // The slice variant of getBytes works for both 2D and 2D array
+    // textures. The other one is only valid for single slice textures.
+    auto getSlices = [&](UInt8* bytes, NSUInteger bytesPerPixel) {
+        for(NSUInteger slice=0;slice<slices;++slice) {
+            [texture getBytes:bytes + slice * bytesPerPixel * w * h
+                  bytesPerRow:w * bytesPerPixel
+                bytesPerImage:w * h * bytesPerPixel
+                   fromRegion:MTLRegionMake2D(0, 0, w, h)
+                  mipmapLevel:0
+                        slice:slice];
+        }
+    };
 
     switch(texture.pixelFormat) {
         case MTLPixelFormatRGBA8Unorm:
-            [texture getBytes:imageBytes.data() bytesPerRow:w * 4 fromRegion:MTLRegionMake2D(0, 0, w, h) mipmapLevel:0];
+            getSlices(imageBytes.data(), 4);
             break;
         case MTLPixelFormatBGRA8Unorm:
-            [texture getBytes:imageBytes.data() bytesPerRow:w * 4 fromRegion:MTLRegionMake2D(0, 0, w, h) mipmapLevel:0];
+            getSlices(imageBytes.data(), 4);
             for(auto i=0;i<imageBytes.size()/4;++i) {
                 std::swap(imageBytes[4*i], imageBytes[4*i+2]);
             }
             break;
         case MTLPixelFormatA8Unorm: {
-            std::vector<UInt8> tmpBytes(w*h);
-            [texture getBytes:tmpBytes.data() bytesPerRow:w fromRegion:MTLRegionMake2D(0, 0, w, h) mipmapLevel:0];
+            std::vector<UInt8> tmpBytes(w*h*slices);
+            getSlices(tmpBytes.data(), 1);
             for(auto i=0;i<tmpBytes.size();++i) {
                 imageBytes[4*i] = tmpBytes[i];
             }
@@ -78,7 +94,7 @@ CGImageRef createImage(id<MTLTexture> texture) {
             assert(false && "unsupported pixel format");
     }
 
-    return createImage(imageBytes.data(), w, h);
+    return createImage(imageBytes.data(), w, h*slices);
 }
 
 void showTexture(id<MTLTexture> texture, NSString* name) {
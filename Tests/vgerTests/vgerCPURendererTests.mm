@@ -0,0 +1,230 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <MetalKit/MetalKit.h>
+#import "testUtils.h"
+#import "vger.h"
+#include <vector>
+#include <chrono>
+#include "nanosvg.h"
+
+#import "../../Sources/vger/vgerCPURenderer.h"
+#import "../../Sources/vger/vger_private.h"
+
+using namespace simd;
+
+@interface vgerCPURendererTests : XCTestCase {
+    id<MTLDevice> device;
+    id<MTLCommandQueue> queue;
+}
+
+@end
+
+@implementation vgerCPURendererTests
+
+- (void)setUp {
+    device = MTLCreateSystemDefaultDevice();
+    queue = [device newCommandQueue];
+}
+
+- (NSURL*) getImageURL:(NSString*)name {
+    NSString* path = @"Contents/Resources/vger_vgerTests.bundle/Contents/Resources/images/";
+    path = [path stringByAppendingString:name];
+    NSBundle* bundle = [NSBundle bundleForClass:self.class];
+    return [bundle.bundleURL URLByAppendingPathComponent:path];
+}
+
+static void drawBasics(vgerContext vg) {
+
+    auto white = vgerColorPaint(vg, float4{1,1,1,1});
+    auto cyan = vgerColorPaint(vg, float4{0,1,1,1});
+    auto magenta = vgerColorPaint(vg, float4{1,0,1,1});
+
+    vgerFillCircle(vg, float2{256, 256}, 40, cyan);
+    vgerStrokeBezier(vg, {{256,256}, {256,384}, {384,384}}, 1, white);
+    vgerFillRect(vg, float2{400,100}, float2{450,150}, 10, vgerLinearGradient(vg, float2{400,100}, float2{450, 150}, float4{0,1,1,1}, float4{1,0,1,1}, 0));
+    vgerFillRect(vg, float2{400,200}, float2{450,250}, 10, vgerRadialGradient(vg, float2{425,225}, 10, 40, float4{0,1,1,1}, float4{1,0,1,1}, 0));
+    vgerStrokeArc(vg, float2{100,400}, 30, 3, 0, .5 * M_PI, white);
+    vgerStrokeSegment(vg, float2{100,100}, float2{200,200}, 10, magenta);
+    vgerStrokeRect(vg, float2{400,300}, float2{450,350}, 10, 2.0, magenta);
+    vgerStrokeWire(vg, float2{200,100}, float2{300,200}, 3, white);
+
+    vgerSave(vg);
+    vgerTranslate(vg, float2{20, 200});
+    vgerRotate(vg, 0.3);
+    vgerScale(vg, float2{100, 100});
+    vgerMoveTo(vg, float2{0,0});
+    vgerLineTo(vg, float2{1,0});
+    vgerQuadTo(vg, float2{.5, .5}, float2{0,0});
+    vgerFill(vg, white);
+    vgerRestore(vg);
+}
+
+static void drawTiger(vgerContext vg, NSVGimage* image) {
+
+    vgerSave(vg);
+    vgerTranslate(vg, float2{0, 512});
+    vgerScale(vg, float2{0.5, -0.5});
+
+    for (NSVGshape *shape = image->shapes; shape; shape = shape->next) {
+
+        auto c = shape->fill.color;
+        auto fcolor = float4{
+            float((c >> 0) & 0xff),
+            float((c >> 8) & 0xff),
+            float((c >> 16) & 0xff),
+            float((c >> 24) & 0xff)
+        } * 1.0/255.0;
+
+        auto paint = vgerColorPaint(vg, fcolor);
+
+        for (NSVGpath *path = shape->paths; path; path = path->next) {
+            float2* pts = (float2*) path->pts;
+            vgerMoveTo(vg, pts[0]);
+            for(int i=1; i<path->npts-2; i+=3) {
+                vgerCubicApproxTo(vg, pts[i], pts[i+1], pts[i+2]);
+            }
+        }
+
+        vgerFill(vg, paint);
+    }
+
+    vgerRestore(vg);
+}
+
+- (void) testCircle {
+
+    auto vg = vgerNew(0, MTLPixelFormatRGBA8Unorm);
+    vgerBegin(vg, 64, 64, 1.0);
+
+    vgerFillCircle(vg, float2{32, 16}, 8, vgerColorPaint(vg, float4{1,1,1,1}));
+
+    std::vector<uint8_t> pixels(64*64*4);
+    vgerRenderCPU(vg, pixels.data(), 64, 64, 64*4);
+
+    auto pixel = [&](int x, int y) { return &pixels[4*(y*64 + x)]; };
+
+    // y is up in vger, so the circle is in the bottom half of the image.
+    XCTAssertEqual(pixel(32, 47)[0], 255);
+    XCTAssertEqual(pixel(32, 47)[3], 255);
+    XCTAssertEqual(pixel(32, 16)[0], 0);
+    XCTAssertEqual(pixel(0, 0)[0], 0);
+
+    // Partial coverage at the edge.
+    auto edge = pixel(40, 47)[0];
+    XCTAssertGreaterThan(edge, 0);
+    XCTAssertLessThan(edge, 255);
+
+    vgerDelete(vg);
+}
+
+- (void) testMatchesGPU {
+
+    int w = 512, h = 512;
+
+    auto textureDesc = [MTLTextureDescriptor
+                        texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA8Unorm
+                        width:w
+                        height:h
+                        mipmapped:NO];
+
+    textureDesc.usage = MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead;
+    textureDesc.storageMode = MTLStorageModeShared;
+    auto texture = [device newTextureWithDescriptor:textureDesc];
+
+    auto pass = [MTLRenderPassDescriptor new];
+    pass.colorAttachments[0].texture = texture;
+    pass.colorAttachments[0].storeAction = MTLStoreActionStore;
+    pass.colorAttachments[0].loadAction = MTLLoadActionClear;
+    pass.colorAttachments[0].clearColor = MTLClearColorMake(0, 0, 0, 1);
+
+    auto vg = vgerNew(0, MTLPixelFormatRGBA8Unorm);
+    vgerBegin(vg, w, h, 1.0);
+    drawBasics(vg);
+
+    std::vector<uint8_t> cpuPixels(w*h*4);
+    vgerRenderCPU(vg, cpuPixels.data(), w, h, w*4);
+
+    auto commandBuffer = [queue commandBuffer];
+    vgerEncode(vg, commandBuffer, pass);
+    [commandBuffer commit];
+    [commandBuffer waitUntilCompleted];
+
+    std::vector<uint8_t> gpuPixels(w*h*4);
+    [texture getBytes:gpuPixels.data() bytesPerRow:w*4 fromRegion:MTLRegionMake2D(0, 0, w, h) mipmapLevel:0];
+
+    // Allow for differences in interpolation precision and blending
+    // rounding, but not for missing or misplaced geometry.
+    int mismatched = 0;
+    for(size_t i=0;i<cpuPixels.size();++i) {
+        if(std::abs(int(cpuPixels[i]) - int(gpuPixels[i])) > 8) {
+            ++mismatched;
+        }
+    }
+
+    XCTAssertLessThan(mismatched, int(cpuPixels.size() / 1000));
+
+    vgerDelete(vg);
+}
+
+- (void) testTigerPerf {
+
+    auto tigerURL = [self getImageURL:@"Ghostscript_Tiger.svg"];
+    auto image = nsvgParseFromFile(tigerURL.path.UTF8String, "px", 96);
+
+    int w = 1920, h = 1080;
+    std::vector<uint8_t> pixels(w*h*4);
+    auto data = pixels.data();
+
+    auto vg = vgerNew(0, MTLPixelFormatRGBA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+    drawTiger(vg, image);
+
+    [self measureBlock:^{
+        vgerRenderCPU(vg, data, w, h, w*4);
+    }];
+
+    // Best of a few, so a busy machine doesn't fail the test.
+    double best = DBL_MAX;
+    for(int i=0;i<3;++i) {
+        auto start = std::chrono::steady_clock::now();
+        vgerRenderCPU(vg, data, w, h, w*4);
+        std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+        best = std::min(best, time.count());
+    }
+    printf("1080p tiger on the CPU: %g s\n", best);
+    XCTAssertLessThan(best, 0.5);
+
+    nsvgDelete(image);
+    vgerDelete(vg);
+}
+
+- (void) testHeapScene {
+
+    // No Metal device is needed to record or render.
+    vgerHeapScene scene;
+    scene.xforms.append(affineIdentity());
+
+    vgerPaint paint = {.type = vgerPaintTypeLinearGradient, .xform = affineIdentity(),
+                       .innerColor = float4{1, 0, 0, 1}, .outerColor = float4{1, 0, 0, 1}, .image = -1};
+    scene.paints.append(paint);
+
+    vgerPrim prim = {.type = vgerCircle, .radius = 20, .cvs = {float2{32, 32}}};
+    scene.addPrim(0, prim);
+
+    vgerCPURenderer cpu;
+    cpu.clear(64, 64);
+    cpu.render(scene, 0, float2{64, 64});
+
+    std::vector<uint8_t> pixels(64*64*4);
+    cpu.getPixels(pixels.data(), 64*4);
+
+    auto center = pixels.data() + (32*64 + 32)*4;
+    XCTAssertEqual(center[0], 255);
+    XCTAssertEqual(center[1], 0);
+
+    auto corner = pixels.data();
+    XCTAssertEqual(corner[0], 0);
+}
+
+@end
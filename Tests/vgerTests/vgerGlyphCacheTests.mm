@@ -2,8 +2,12 @@
 
 #import <XCTest/XCTest.h>
 #import "../../Sources/vger/vgerGlyphCache.h"
+#import "../../Sources/vger/vger_private.h"
 #import <MetalKit/MetalKit.h>
 #import "testUtils.h"
+#include <vector>
+#include <chrono>
+#include <thread>
 
 @interface vgerGlyphCacheTests : XCTestCase {
     id<MTLDevice> device;
@@ -46,4 +50,225 @@
 
 }
 
+/// Texels of an atlas region, row by row.
+static std::vector<uint8_t> glyphTexels(id<MTLTexture> atlas, const stbrp_rect& r) {
+    std::vector<uint8_t> texels(r.w * r.h);
+    [atlas getBytes:texels.data()
+        bytesPerRow:r.w
+      bytesPerImage:r.w * r.h
+         fromRegion:MTLRegionMake2D(r.x, r.y, r.w, r.h)
+        mipmapLevel:0
+              slice:r.id];
+    return texels;
+}
+
+- (void)testSDFGlyph {
+
+    auto cache = [[vgerGlyphCache alloc] initWithDevice:device];
+
+    UniChar c = 'O';
+    CGGlyph glyph;
+    CTFontGetGlyphsForCharacters([cache getFont], &c, &glyph, 1);
+
+    auto info = [cache getSDFGlyph:glyph];
+    XCTAssertTrue(info.sdf);
+    XCTAssertEqual(info.size, GLYPH_SDF_SCALE);
+    XCTAssertNotEqual(info.regionIndex, -1);
+
+    // Generated once.
+    XCTAssertEqual([cache getSDFGlyph:glyph].regionIndex, info.regionIndex);
+    XCTAssertEqual(cache.count, 1);
+
+    // Coverage glyphs are separate, even at the same scale.
+    auto bitmap = [cache getGlyph:glyph scale:GLYPH_SDF_SCALE];
+    XCTAssertFalse(bitmap.sdf);
+    XCTAssertNotEqual(bitmap.regionIndex, info.regionIndex);
+    XCTAssertEqual(bitmap.textureWidth, info.textureWidth);
+    XCTAssertEqual(bitmap.textureHeight, info.textureHeight);
+
+    id<MTLCommandBuffer> buf = [queue commandBuffer];
+    [cache update:buf];
+
+    auto atlas = [cache getAltas];
+
+    #if TARGET_OS_OSX
+    auto blitEncoder = [buf blitCommandEncoder];
+    [blitEncoder synchronizeResource:atlas];
+    [blitEncoder endEncoding];
+    #endif
+
+    [buf commit];
+    [buf waitUntilCompleted];
+
+    showTexture(atlas, @"sdf_glyph_atlas.png");
+
+    // Distances match the coverage glyph: thresholding at the outline
+    // (0.5) gives nearly the same shape.
+    auto sdfTexels = glyphTexels(atlas, [cache getRects][info.regionIndex]);
+    auto coverageTexels = glyphTexels(atlas, [cache getRects][bitmap.regionIndex]);
+    XCTAssertEqual(sdfTexels.size(), coverageTexels.size());
+
+    size_t agree = 0, edge = 0;
+    for(size_t i=0;i<sdfTexels.size();++i) {
+        agree += (sdfTexels[i] >= 128) == (coverageTexels[i] >= 128);
+        edge += sdfTexels[i] > 32 and sdfTexels[i] < 224;
+    }
+    XCTAssertGreaterThanOrEqual(agree, 0.98 * sdfTexels.size());
+
+    // Values ramp across the spread instead of being a step.
+    XCTAssertGreaterThan(edge, 0);
+
+    // The corner is more than the spread outside, and the middle of the
+    // 'O' is in its hole.
+    int w = info.textureWidth, h = info.textureHeight;
+    XCTAssertEqual(sdfTexels[0], 0);
+    XCTAssertLessThan(sdfTexels[(h/2)*w + w/2], 128);
+
+    // The left stroke of the 'O', at mid height, is inside.
+    int x = 0;
+    for(;x<w/2;++x) {
+        if(coverageTexels[(h/2)*w + x] >= 192) {
+            break;
+        }
+    }
+    XCTAssertLessThan(x, w/2);
+    XCTAssertGreaterThan(sdfTexels[(h/2)*w + x], 128);
+}
+
+- (void)testSDFGlyphsZoom {
+
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+
+    int counts[2];
+    for(bool sdf : {false, true}) {
+        vgerSetSDFGlyphs(vg, sdf);
+        auto start = vg->glyphCache.count;
+        for(float zoom : {0.5f, 1.0f, 2.0f, 4.0f, 8.0f}) {
+            vgerBegin(vg, 512, 512, 1.0);
+            vgerScale(vg, float2{zoom, zoom});
+            vgerText(vg, "zoom", float4{1,1,1,1}, 0);
+        }
+        counts[sdf] = vg->glyphCache.count - start;
+    }
+
+    // Coverage glyphs are rasterized at each scale.
+    XCTAssertEqual(counts[0], 3*5);
+
+    // Distance field glyphs are generated once.
+    XCTAssertEqual(counts[1], 3);
+
+    // Glyph prims carry the spread.
+    auto& prims = vg->scenes[vg->currentScene].prims[0];
+    XCTAssertEqual(prims.count, 4);
+    for(size_t i=0;i<prims.count;++i) {
+        XCTAssertEqual(primType(prims[i]), vgerGlyph);
+        XCTAssertEqual(primAux(prims[i]), GLYPH_MARGIN);
+    }
+
+    vgerDelete(vg);
+}
+
+/// Printable characters at 22 scales, about 2,000 glyphs.
+static std::vector<std::pair<CGGlyph, float>> burstGlyphs(CTFontRef font) {
+    std::vector<std::pair<CGGlyph, float>> result;
+    for(int i=0;i<22;++i) {
+        for(UniChar c='!';c<='~';++c) {
+            CGGlyph glyph;
+            CTFontGetGlyphsForCharacters(font, &c, &glyph, 1);
+            result.push_back({glyph, 2.0f + i * 0.5f});
+        }
+    }
+    return result;
+}
+
+- (void)testAsyncGlyphs {
+
+    double ms[2];
+    std::vector<GlyphInfo> infos[2];
+
+    for(bool async : {false, true}) {
+
+        auto cache = [[vgerGlyphCache alloc] initWithDevice:device];
+        cache.async = async;
+        auto glyphs = burstGlyphs([cache getFont]);
+
+        // A frame with all the glyphs: drawing and updating the atlas.
+        auto start = std::chrono::steady_clock::now();
+        for(auto [glyph, scale] : glyphs) {
+            infos[async].push_back([cache getGlyph:glyph scale:scale]);
+        }
+        id<MTLCommandBuffer> buf = [queue commandBuffer];
+        [cache update:buf];
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        ms[async] = elapsed.count();
+
+        [buf commit];
+        [buf waitUntilCompleted];
+
+        // Waited for all the glyphs.
+        XCTAssertEqual(cache.pendingCount, 0);
+        XCTAssertEqual(cache.count, int(glyphs.size()));
+        XCTAssertFalse(cache.full);
+
+        auto rects = [cache getRects];
+        for(auto& info : infos[async]) {
+            auto& r = rects[info.regionIndex-1];
+            XCTAssertEqual(r.w, info.textureWidth);
+            XCTAssertEqual(r.h, info.textureHeight);
+        }
+    }
+
+    printf("%d new glyphs: %.1f ms synchronously, %.1f ms on workers\n",
+           int(infos[0].size()), ms[0], ms[1]);
+
+    // Glyph sizes don't depend on how they're rasterized.
+    for(size_t i=0;i<infos[0].size();++i) {
+        XCTAssertEqual(infos[0][i].textureWidth, infos[1][i].textureWidth);
+        XCTAssertEqual(infos[0][i].textureHeight, infos[1][i].textureHeight);
+    }
+}
+
+- (void)testGlyphPlaceholders {
+
+    auto cache = [[vgerGlyphCache alloc] initWithDevice:device];
+    cache.async = true;
+    cache.waitForGlyphs = false;
+    auto glyphs = burstGlyphs([cache getFont]);
+
+    std::vector<GlyphInfo> infos;
+    auto start = std::chrono::steady_clock::now();
+    for(auto [glyph, scale] : glyphs) {
+        infos.push_back([cache getGlyph:glyph scale:scale]);
+    }
+    [cache update:[queue commandBuffer]];
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("%d new glyphs: %.1f ms without waiting, %d pending\n",
+           int(glyphs.size()), elapsed.count(), cache.pendingCount);
+
+    // Glyphs still rasterizing have empty rects.
+    auto rects = [cache getRects];
+    int empty = 0;
+    for(auto& info : infos) {
+        empty += rects[info.regionIndex-1].w == 0;
+    }
+    XCTAssertEqual(empty, cache.pendingCount);
+
+    // Later frames add them.
+    for(int frame=0;frame<1000 and cache.pendingCount;++frame) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        [cache beginFrame];
+        for(auto& info : infos) {
+            [cache useRegion:info.regionIndex];
+        }
+        [cache update:[queue commandBuffer]];
+    }
+    XCTAssertEqual(cache.pendingCount, 0);
+
+    rects = [cache getRects];
+    for(auto& info : infos) {
+        XCTAssertEqual(rects[info.regionIndex-1].w, info.textureWidth);
+    }
+}
+
 @end
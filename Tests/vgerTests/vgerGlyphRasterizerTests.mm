@@ -0,0 +1,354 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import "../../Sources/vger/vgerGlyphCache.h"
+#import "../../Sources/vger/vgerFont.h"
+#import "../../Sources/vger/vgerGlyphRasterizer.h"
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+@interface vgerGlyphRasterizerTests : XCTestCase {
+    id<MTLDevice> device;
+    vgerGlyphCache* cache;
+    CTFontRef ctFont;
+    vgerFont font;
+}
+
+@end
+
+@implementation vgerGlyphRasterizerTests
+
+- (void)setUp {
+    device = MTLCreateSystemDefaultDevice();
+    cache = [[vgerGlyphCache alloc] initWithDevice:device];
+    ctFont = [cache getFont];
+
+    // The same font file the glyph cache uses.
+    auto url = (NSURL*) CFBridgingRelease(CTFontCopyAttribute(ctFont, kCTFontURLAttribute));
+    XCTAssertTrue(font.loadFile(url.fileSystemRepresentation));
+}
+
+/// Rasterizes as vgerGlyphCache does with CoreGraphics.
+static bool rasterizeCG(CTFontRef ctFont, CGGlyph glyph, float scale, std::vector<uint8_t>& image, int* width, int* height) {
+
+    CGRect rect;
+    CTFontGetBoundingRectsForGlyphs(ctFont, kCTFontOrientationHorizontal, &glyph, &rect, 1);
+    auto xform = CGAffineTransformMakeTranslation(-rect.origin.x, -rect.origin.y);
+    auto path = CTFontCreatePathForGlyph(ctFont, glyph, &xform);
+    if(!path) {
+        return false;
+    }
+
+    *width = ceilf(rect.size.width * scale) + 2*GLYPH_MARGIN;
+    *height = ceilf(rect.size.height * scale) + 2*GLYPH_MARGIN;
+    image.assign(*width * *height, 0);
+
+    auto colorSpace = CGColorSpaceCreateDeviceGray();
+    auto context = CGBitmapContextCreate(image.data(), *width, *height, 8, *width, colorSpace,
+                                         kCGBitmapAlphaInfoMask & kCGImageAlphaNone);
+    CGContextTranslateCTM(context, GLYPH_MARGIN, GLYPH_MARGIN);
+    CGContextScaleCTM(context, scale, scale);
+    CGContextSetRGBFillColor(context, 1, 1, 1, 1);
+    CGContextAddPath(context, path);
+    CGContextFillPath(context);
+
+    CGPathRelease(path);
+    CGContextRelease(context);
+    CGColorSpaceRelease(colorSpace);
+    return true;
+}
+
+/// Rasterizes as vgerGlyphCache does with vgerGlyphRasterizer.
+static bool rasterizePortable(const vgerFont& font, float fontSize, uint32_t glyph, float scale,
+                              std::vector<uint8_t>& image, int* width, int* height) {
+
+    vgerGlyphBox box;
+    std::vector<vgerFontQuad> quads;
+    if(!font.glyphBox(glyph, &box) or !font.glyphOutline(glyph, quads)) {
+        return false;
+    }
+
+    float s = fontSize / font.unitsPerEm() * scale;
+    *width = ceilf((box.xMax - box.xMin) * s) + 2*GLYPH_MARGIN;
+    *height = ceilf((box.yMax - box.yMin) * s) + 2*GLYPH_MARGIN;
+    image.assign(*width * *height, 0);
+
+    // Reuses the accumulation buffer, as vgerGlyphCache does.
+    static thread_local vgerGlyphRasterizer rasterizer;
+    rasterizer.rasterize(quads, s, {GLYPH_MARGIN - box.xMin * s, GLYPH_MARGIN - box.yMin * s},
+                         *width, *height, image.data(), *width);
+    return true;
+}
+
+- (void) testCharacterMap {
+
+    for(UniChar c = 32; c < 127; ++c) {
+        CGGlyph glyph;
+        CTFontGetGlyphsForCharacters(ctFont, &c, &glyph, 1);
+        XCTAssertEqual(font.glyphIndex(c), glyph);
+    }
+
+    XCTAssertEqual(font.glyphCount(), CTFontGetGlyphCount(ctFont));
+}
+
+- (void) testMatchesCoreGraphics {
+
+    float fontSize = CTFontGetSize(ctFont);
+
+    for(float scale : {1.0f, 2.0f, 4.0f}) {
+
+        double totalDiff = 0;
+        size_t pixels = 0;
+        int sizeMismatches = 0;
+
+        for(int g=0;g<font.glyphCount();++g) {
+
+            std::vector<uint8_t> cg, portable;
+            int cgWidth, cgHeight, width, height;
+            bool hasCG = rasterizeCG(ctFont, g, scale, cg, &cgWidth, &cgHeight);
+            bool hasPortable = rasterizePortable(font, fontSize, g, scale, portable, &width, &height);
+
+            XCTAssertEqual(hasCG, hasPortable, "glyph %d", g);
+            if(!hasCG or !hasPortable) {
+                continue;
+            }
+
+            if(width != cgWidth or height != cgHeight) {
+                ++sizeMismatches;
+                continue;
+            }
+
+            for(size_t i=0;i<cg.size();++i) {
+                totalDiff += abs(int(cg[i]) - int(portable[i]));
+            }
+            pixels += cg.size();
+        }
+
+        double meanDiff = totalDiff / pixels;
+        printf("scale %g: mean difference %f, %d size mismatches\n", scale, meanDiff, sizeMismatches);
+
+        // Antialiasing differs a little at edges.
+        XCTAssertLessThan(meanDiff, 4.0);
+        XCTAssertLessThan(sizeMismatches, font.glyphCount() / 50);
+    }
+}
+
+- (void) testGlyphCache {
+
+    auto portableCache = [[vgerGlyphCache alloc] initWithDevice:device];
+    portableCache.portableRasterizer = true;
+
+    UniChar c = 'g';
+    CGGlyph glyph;
+    CTFontGetGlyphsForCharacters(ctFont, &c, &glyph, 1);
+
+    auto info = [portableCache getGlyph:glyph scale:2];
+    auto cgInfo = [cache getGlyph:glyph scale:2];
+
+    XCTAssertGreaterThan(info.regionIndex, 0);
+    XCTAssertEqual(info.textureWidth, cgInfo.textureWidth);
+    XCTAssertEqual(info.textureHeight, cgInfo.textureHeight);
+    XCTAssertEqualWithAccuracy(info.glyphBounds.origin.y, cgInfo.glyphBounds.origin.y, 0.1);
+
+    // Glyphs without outlines are skipped, as with CoreGraphics.
+    c = ' ';
+    CTFontGetGlyphsForCharacters(ctFont, &c, &glyph, 1);
+    XCTAssertEqual([portableCache getGlyph:glyph scale:2].regionIndex, -1);
+}
+
+static void u16(std::vector<uint8_t>& d, int v) {
+    d.push_back(uint8_t(v >> 8));
+    d.push_back(uint8_t(v));
+}
+
+static void u32(std::vector<uint8_t>& d, uint32_t v) {
+    u16(d, v >> 16);
+    u16(d, v & 0xffff);
+}
+
+/// A triangle with contours contours. Each contour after the first ends
+/// where the first does, so they're malformed.
+static void addTriangle(std::vector<uint8_t>& glyf, std::vector<uint32_t>& loca, int contours = 1) {
+    for(int v : {contours, 0, 0, 100, 100}) {
+        u16(glyf, v);
+    }
+    for(int c=0;c<contours;++c) {
+        u16(glyf, 2);
+    }
+    u16(glyf, 0);
+    glyf.insert(glyf.end(), {1, 1, 1});
+    for(int v : {0, 100, -100, 0, 0, 100}) {
+        u16(glyf, v);
+    }
+    glyf.push_back(0);
+    loca.push_back(uint32_t(glyf.size()));
+}
+
+/// A TrueType font with only the tables vgerFont needs.
+static std::vector<uint8_t> makeFont(const std::vector<uint8_t>& glyf, const std::vector<uint32_t>& loca) {
+
+    std::vector<uint8_t> head(54), maxp, locaTable;
+    head[18] = 1000 >> 8;
+    head[19] = 1000 & 0xff;
+    head[51] = 1; // Long loca.
+    u32(maxp, 0x5000);
+    u16(maxp, int(loca.size()) - 1);
+    for(auto offset : loca) {
+        u32(locaTable, offset);
+    }
+
+    std::pair<const char*, const std::vector<uint8_t>*> tables[] = {
+        {"glyf", &glyf}, {"head", &head}, {"loca", &locaTable}, {"maxp", &maxp}
+    };
+
+    std::vector<uint8_t> font;
+    u32(font, 0x00010000);
+    u16(font, 4);
+    u16(font, 0);
+    u16(font, 0);
+    u16(font, 0);
+    uint32_t offset = 12 + 16*4;
+    for(auto& [tag, table] : tables) {
+        font.insert(font.end(), tag, tag + 4);
+        u32(font, 0);
+        u32(font, offset);
+        u32(font, uint32_t(table->size()));
+        offset += (table->size() + 3) & ~3;
+    }
+    for(auto& [tag, table] : tables) {
+        font.insert(font.end(), table->begin(), table->end());
+        font.resize((font.size() + 3) & ~3);
+    }
+    return font;
+}
+
+/// Glyph 0 is a triangle. Each glyph after it is a composite of copies
+/// copies of the next one, and the last is copies of the triangle.
+static std::vector<uint8_t> makeCompositeFont(int levels, int copies) {
+
+    // Triangle: one contour, three on curve points with word deltas.
+    std::vector<uint8_t> glyf;
+    std::vector<uint32_t> loca = {0};
+    addTriangle(glyf, loca);
+
+    for(int level=1;level<=levels;++level) {
+        for(int v : {-1, 0, 0, 100, 100}) {
+            u16(glyf, v);
+        }
+        for(int i=0;i<copies;++i) {
+            u16(glyf, (i + 1 < copies ? 0x20 : 0) | 2); // MoreComponents, ArgsAreXYValues
+            u16(glyf, level == levels ? 0 : level + 1);
+            glyf.insert(glyf.end(), {0, 0});
+        }
+        loca.push_back(uint32_t(glyf.size()));
+    }
+
+    return makeFont(glyf, loca);
+}
+
+- (void) testMalformedOutline {
+
+    // The second contour ends before it starts, so the outline fails after
+    // the first contour's quads are made.
+    std::vector<uint8_t> glyf;
+    std::vector<uint32_t> loca = {0};
+    addTriangle(glyf, loca, 2);
+
+    // A composite of a triangle and the malformed glyph.
+    for(int v : {-1, 0, 0, 100, 100, 0x22, 2, 0, 2, 0, 0}) {
+        u16(glyf, v);
+    }
+    loca.push_back(uint32_t(glyf.size()));
+    addTriangle(glyf, loca);
+
+    auto data = makeFont(glyf, loca);
+    vgerFont malformed;
+    XCTAssertTrue(malformed.load(data.data(), data.size()));
+
+    std::vector<vgerFontQuad> quads(5);
+    XCTAssertFalse(malformed.glyphOutline(0, quads));
+    XCTAssertEqual(quads.size(), 5);
+
+    // The malformed component is skipped, along with its quads.
+    quads.clear();
+    XCTAssertTrue(malformed.glyphOutline(1, quads));
+    XCTAssertEqual(quads.size(), 3);
+}
+
+- (void) testCompositeBudget {
+
+    auto data = makeCompositeFont(2, 2);
+    vgerFont small;
+    XCTAssertTrue(small.load(data.data(), data.size()));
+
+    std::vector<vgerFontQuad> quads;
+    XCTAssertTrue(small.glyphOutline(0, quads));
+    XCTAssertEqual(quads.size(), 3);
+
+    // Two copies of two triangles.
+    quads.clear();
+    XCTAssertTrue(small.glyphOutline(1, quads));
+    XCTAssertEqual(quads.size(), 4*3);
+
+    // Only 8 levels deep, but 16^8 triangles. The budget stops it quickly,
+    // and nothing is appended.
+    data = makeCompositeFont(8, 16);
+    vgerFont bomb;
+    XCTAssertTrue(bomb.load(data.data(), data.size()));
+
+    quads.resize(5);
+    auto start = std::chrono::steady_clock::now();
+    XCTAssertFalse(bomb.glyphOutline(1, quads));
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    XCTAssertEqual(quads.size(), 5);
+    XCTAssertLessThan(time.count(), 0.1);
+
+    // 16^2 triangles fit.
+    quads.clear();
+    XCTAssertTrue(bomb.glyphOutline(7, quads));
+    XCTAssertEqual(quads.size(), 256*3);
+}
+
+/// The portable rasterizer should be at least twice as fast as
+/// CoreGraphics, so portableRasterizer is a clear win.
+- (void) testPerf {
+
+    float fontSize = CTFontGetSize(ctFont);
+
+    for(float scale : {1.0f, 2.0f, 4.0f}) {
+
+        std::vector<uint8_t> image;
+        int width, height;
+        int cgGlyphs = 0, portableGlyphs = 0;
+
+        // Best of a few runs, so a busy machine doesn't fail the test.
+        double cgTime = INFINITY, portableTime = INFINITY;
+        for(int run=0;run<3;++run) {
+
+            cgGlyphs = 0;
+            auto start = std::chrono::steady_clock::now();
+            for(int g=0;g<font.glyphCount();++g) {
+                cgGlyphs += rasterizeCG(ctFont, g, scale, image, &width, &height);
+            }
+            std::chrono::duration<double> cg = std::chrono::steady_clock::now() - start;
+            cgTime = std::min(cgTime, cg.count());
+
+            portableGlyphs = 0;
+            start = std::chrono::steady_clock::now();
+            for(int g=0;g<font.glyphCount();++g) {
+                portableGlyphs += rasterizePortable(font, fontSize, g, scale, image, &width, &height);
+            }
+            std::chrono::duration<double> portable = std::chrono::steady_clock::now() - start;
+            portableTime = std::min(portableTime, portable.count());
+        }
+
+        printf("scale %g: CoreGraphics %.0f glyphs/sec, portable %.0f glyphs/sec (%.1fx)\n",
+               scale, cgGlyphs / cgTime, portableGlyphs / portableTime, cgTime / portableTime);
+
+        XCTAssertEqual(cgGlyphs, portableGlyphs);
+        XCTAssertGreaterThanOrEqual(cgTime / portableTime, 2.0, "scale %g", scale);
+    }
+}
+
+@end
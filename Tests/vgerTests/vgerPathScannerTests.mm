@@ -2,6 +2,9 @@
 
 #import <XCTest/XCTest.h>
 #import "../../Sources/vger/vgerPathScanner.h"
+#include <algorithm>
+#include <vector>
+#include <chrono>
 
 @interface vgerPathScannerTests : XCTestCase
 
@@ -52,7 +55,7 @@
     CGPathCloseSubpath(path);
     
     vgerPathScanner scan;
-    scan.begin(path);
+    vgerPathScannerBegin(scan, path);
     
     while(scan.next()) {
         printf("interval %f %f, active: ", scan.interval.a, scan.interval.b);
@@ -67,4 +70,179 @@
     CGPathRelease(path);
 }
 
+/// Random segments, or a y-monotone zig-zag.
+static void makeSegments(vgerPathScanner& scan, int n, bool monotone) {
+    scan.segments.clear();
+    vector_float2 p{0,0};
+    for(int i=0;i<n;++i) {
+        vector_float2 q = monotone ? vector_float2{float(i % 2 ? 0 : 100), float(i)} : vector_float2{float(rand() % 1000), float(rand() % 1000)};
+        scan.segments.push_back({p, (p+q)/2, q});
+        p = q;
+    }
+}
+
+static bool sameNodes(const vgerPathScanner& a, const vgerPathScanner& b) {
+    if(a.nodes.size() != b.nodes.size()) {
+        return false;
+    }
+    for(size_t i=0;i<a.nodes.size();++i) {
+        auto& x = a.nodes[i];
+        auto& y = b.nodes[i];
+        if(x.coord != y.coord or x.seg != y.seg or x.end != y.end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+- (void)testSortModes {
+
+    srand(0);
+
+    for(int n : {0, 1, 10, 1000}) {
+        for(bool monotone : {false, true}) {
+
+            vgerPathScanner ref, radix, automatic;
+            makeSegments(ref, n, monotone);
+            radix.segments = automatic.segments = ref.segments;
+
+            ref.sortMode = vgerPathScanner::SortModeStd;
+            radix.sortMode = vgerPathScanner::SortModeRadix;
+            automatic.sortMode = vgerPathScanner::SortModeAuto;
+
+            ref._init();
+            radix._init();
+            automatic._init();
+
+            XCTAssertTrue(sameNodes(ref, radix));
+            XCTAssertTrue(sameNodes(ref, automatic));
+        }
+    }
+}
+
+- (void)testSortPerf {
+
+    srand(0);
+
+    printf("segments, monotone, std (ms), radix (ms), auto (ms)\n");
+
+    for(int n : {10, 100, 1000, 10000, 100000}) {
+        for(bool monotone : {false, true}) {
+
+            vgerPathScanner scan;
+            makeSegments(scan, n, monotone);
+            int reps = std::max(1, 1000000 / n);
+
+            double times[3];
+            vgerPathScanner::SortMode modes[3] = {
+                vgerPathScanner::SortModeStd,
+                vgerPathScanner::SortModeRadix,
+                vgerPathScanner::SortModeAuto
+            };
+
+            for(int m=0;m<3;++m) {
+                scan.sortMode = modes[m];
+                auto start = std::chrono::steady_clock::now();
+                for(int r=0;r<reps;++r) {
+                    scan._init();
+                }
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                times[m] = elapsed.count() / reps;
+            }
+
+            printf("%d, %d, %f, %f, %f\n", n, monotone, times[0], times[1], times[2]);
+        }
+    }
+}
+
+- (void)testDenseSlabTiles {
+
+    // A star with thin spikes: slabs through the middle have more than
+    // MaxTileSegments segments, most of which touch every small tile.
+    int n = 1024;
+    vgerPathScanner scan;
+    auto point = [n](int i) {
+        float r = (i % 2) ? 100 : 250;
+        float a = 2 * M_PI * i / (2 * n);
+        return vector_float2{256 + r * cosf(a), 256 + r * sinf(a)};
+    };
+    for(int i=0;i<2*n;++i) {
+        auto a = point(i), c = point(i+1);
+        scan.segments.push_back({a, (a + c) / 2, c});
+    }
+
+    size_t slabCVs = 0;
+    scan._init();
+    while(scan.next()) {
+        slabCVs += 3 * scan.activeCount;
+    }
+
+    std::vector<vgerPrim> prims;
+    std::vector<vector_float2> cvs;
+    scan._init();
+    scan.scanPrims(0, 1, prims, cvs);
+    printf("untiled cvs: %d, tiled: %d in %d prims\n", int(slabCVs), int(cvs.size()), int(prims.size()));
+
+    // Splitting stops where the halves would just copy the segments.
+    XCTAssertLessThan(cvs.size(), 3 * slabCVs);
+}
+
+/// Endpoints with pairs of equal values removed, which have the same
+/// parity at every y.
+static std::vector<float> oddEndpoints(std::vector<float> ys) {
+    std::sort(ys.begin(), ys.end());
+    std::vector<float> odd;
+    for(auto y : ys) {
+        if(odd.size() and odd.back() == y) {
+            odd.pop_back();
+        } else {
+            odd.push_back(y);
+        }
+    }
+    return odd;
+}
+
+- (void)testTileCrossings {
+
+    int n = 1024;
+    vgerPathScanner scan;
+    auto point = [n](int i) {
+        float r = (i % 2) ? 100 : 250;
+        float a = 2 * M_PI * i / (2 * n);
+        return vector_float2{256 + r * cosf(a), 256 + r * sinf(a)};
+    };
+    for(int i=0;i<2*n;++i) {
+        auto a = point(i), c = point(i+1);
+        scan.segments.push_back({a, (a + c) / 2, c});
+    }
+
+    // Each tile's proxies have the parity of the segments to its right.
+    int mismatches = 0;
+    scan._init();
+    while(scan.next()) {
+        scan.tile(16);
+        for(auto& t : scan.tiles) {
+            std::vector<float> proxies, expected;
+            for(int i=t.start;i<t.start+t.count;++i) {
+                // Proxies are vertical and right of the tile. Real
+                // vertical segments are within the fattening of it.
+                auto& seg = scan.tileSegments[i];
+                if(seg.cvs[0].x == seg.cvs[2].x and seg.cvs[0].x > t.xInterval.b + 1) {
+                    proxies.push_back(seg.cvs[0].y);
+                    proxies.push_back(seg.cvs[2].y);
+                }
+            }
+            for(int a = scan.first; a != -1; a = scan.segments[a].next) {
+                auto& seg = scan.segments[a];
+                if(seg.xInterval().a >= t.xInterval.b) {
+                    expected.push_back(std::clamp(seg.cvs[0].y, scan.interval.a - 1, scan.interval.b + 1));
+                    expected.push_back(std::clamp(seg.cvs[2].y, scan.interval.a - 1, scan.interval.b + 1));
+                }
+            }
+            mismatches += oddEndpoints(proxies) != oddEndpoints(expected);
+        }
+    }
+    XCTAssertEqual(mismatches, 0);
+}
+
 @end
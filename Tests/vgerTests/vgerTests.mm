@@ -9,12 +9,14 @@
 #import "vger.h"
 #include "nanovg_mtl.h"
 #include <vector>
+#include <chrono>
 
-#define NANOSVG_IMPLEMENTATION
 #include "nanosvg.h"
 
 #import "../../Sources/vger/sdf.h"
 #import "../../Sources/vger/vger_private.h"
+#import "../../Sources/vger/vgerTrace.h"
+#include <thread>
 
 using namespace simd;
 
@@ -117,8 +119,68 @@ static void SplitBezier(float t,
 }
 
 - (void) testSizes {
-    XCTAssertEqual(sizeof(vgerPaint), 128);
+    XCTAssertEqual(sizeof(vgerPaint), 96);
+    XCTAssertEqual(sizeof(vgerAffine), 24);
     XCTAssertEqual(sizeof(vgerPrim), 96);
+    XCTAssertEqual(sizeof(vgerCompactPrim), 32);
+}
+
+- (void) testCompactPrimRoundTrip {
+
+    float2 cvs[3] = { {1, 2}, {3, 5}, {7, 4} };
+
+    vgerPrim prims[] = {
+        { .type = vgerCircle, .radius = 10, .cvs = { {50, 60} }, .paint = 3, .xform = 7 },
+        { .type = vgerArc, .width = 2, .radius = 10, .cvs = { {50, 60}, {sinf(0.5f), cosf(0.5f)}, {sinf(1.0f), cosf(1.0f)} }, .paint = 3 },
+        { .type = vgerRect, .radius = 4, .cvs = { {10, 20}, {30, 50} } },
+        { .type = vgerSegment, .width = 3, .cvs = { {10, 20}, {30, 50} } },
+        { .type = vgerWire, .width = 3, .cvs = { {10, 20}, {30, 50} } },
+        { .type = vgerBezier, .width = 1, .cvs = { cvs[0], cvs[1], cvs[2] } },
+    };
+
+    for(auto& prim : prims) {
+        auto cp = encodePrim(prim, 0);
+        auto decoded = decodePrim(cp, cvs);
+        decodePrimBounds(cp, decoded, cvs);
+        XCTAssertEqual(decoded.type, prim.type);
+        XCTAssertEqual(decoded.paint, prim.paint);
+        XCTAssertEqual(decoded.xform, prim.xform);
+        XCTAssertEqual(decoded.width, prim.width);
+        XCTAssertEqual(decoded.radius, prim.radius);
+        // Arc sines and cosines are 16-bit.
+        float accuracy = prim.type == vgerArc ? 1e-4 : 1e-6;
+        for(int i=0;i<3;++i) {
+            XCTAssertEqualWithAccuracy(decoded.cvs[i].x, prim.cvs[i].x, accuracy);
+            XCTAssertEqualWithAccuracy(decoded.cvs[i].y, prim.cvs[i].y, accuracy);
+        }
+
+        auto bounds = sdPrimBounds(prim, cvs).inset(-1);
+        XCTAssertTrue(simd_equal(decoded.quadBounds[0], bounds.min));
+        XCTAssertTrue(simd_equal(decoded.quadBounds[1], bounds.max));
+    }
+
+    // Rect stroke bounds come from the piece index.
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+    auto paint = vgerColorPaint(vg, float4{1,1,1,1});
+    vgerStrokeRect(vg, float2{10, 20}, float2{100, 80}, 8, 2, paint);
+
+    float pad = 3, corner = 8;
+    float2 expectedMin[8] = {
+        {10 + corner, 20 - pad}, {100 - pad, 20 + corner}, {10 + corner, 80 - pad}, {10 - pad, 20 + corner},
+        {10 - pad, 20 - pad}, {100 - corner, 20 - pad}, {100 - corner, 80 - corner}, {10 - pad, 80 - corner}
+    };
+
+    auto& scenePrims = vg->scenes[vg->currentScene].prims[0];
+    XCTAssertEqual(scenePrims.count, 8);
+    for(int i=0;i<8;++i) {
+        auto& cp = scenePrims[i];
+        auto decoded = decodePrim(cp, vg->scenes[vg->currentScene].cvs.ptr);
+        decodePrimBounds(cp, decoded, vg->scenes[vg->currentScene].cvs.ptr);
+        XCTAssertTrue(simd_equal(decoded.quadBounds[0], expectedMin[i]));
+    }
+
+    vgerDelete(vg);
 }
 
 - (void) testStrokeRectPrimCount {
@@ -135,6 +197,691 @@ static void SplitBezier(float t,
     vgerDelete(vg);
 }
 
+- (void) testXformDedup {
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+
+    auto paint = vgerColorPaint(vg, float4{1,0,1,1});
+
+    for(int i=0;i<100;++i) {
+        vgerFillCircle(vg, float2{float(i), 0}, 10, paint);
+    }
+    XCTAssertEqual(vgerXformCount(vg), 1);
+
+    vgerSave(vg);
+    vgerFillCircle(vg, float2{0, 0}, 10, paint);
+    XCTAssertEqual(vgerXformCount(vg), 1);
+    vgerTranslate(vg, float2{10, 10});
+    vgerFillCircle(vg, float2{0, 0}, 10, paint);
+    vgerFillCircle(vg, float2{0, 0}, 10, paint);
+    XCTAssertEqual(vgerXformCount(vg), 2);
+    vgerRestore(vg);
+
+    // Restoring goes back to the outer transform's index.
+    vgerFillCircle(vg, float2{0, 0}, 10, paint);
+    XCTAssertEqual(vgerXformCount(vg), 2);
+
+    auto& scene = vg->scenes[vg->currentScene];
+    XCTAssertEqual(scene.prims[0][0].xform, scene.prims[0][103].xform);
+    XCTAssertNotEqual(scene.prims[0][0].xform, scene.prims[0][102].xform);
+
+    // New frames start over.
+    vgerBegin(vg, 512, 512, 1.0);
+    paint = vgerColorPaint(vg, float4{1,0,1,1});
+    vgerFillCircle(vg, float2{0, 0}, 10, paint);
+    XCTAssertEqual(vgerXformCount(vg), 1);
+
+    vgerDelete(vg);
+}
+
+- (void) testStats {
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+
+    auto paint = vgerColorPaint(vg, float4{1,1,1,1});
+    vgerFillCircle(vg, float2{100, 100}, 10, paint);
+    vgerFillCircle(vg, float2{200, 100}, 10, paint);
+    vgerFillRect(vg, float2{10, 10}, float2{50, 50}, 4, paint);
+
+    vgerMoveTo(vg, float2{10, 200});
+    vgerLineTo(vg, float2{100, 250});
+    vgerLineTo(vg, float2{50, 300});
+    vgerFill(vg, paint);
+
+    vgerText(vg, "stats", float4{1,1,1,1}, 0);
+    vgerText(vg, "stats", float4{1,1,1,1}, 0);
+
+    auto commandBuffer = [queue commandBuffer];
+    vgerEncode(vg, commandBuffer, pass);
+    [commandBuffer commit];
+    [commandBuffer waitUntilCompleted];
+
+    vgerStats stats;
+    vgerGetStats(vg, &stats);
+
+    XCTAssertEqual(stats.prims[0][vgerCircle], 2);
+    XCTAssertEqual(stats.prims[0][vgerRect], 1);
+    XCTAssertGreaterThan(stats.prims[0][vgerPathFill], 0);
+    XCTAssertGreaterThan(stats.pathFillSlabs, 0);
+    XCTAssertEqual(stats.textCacheMisses, 1);
+    XCTAssertEqual(stats.textCacheHits, 1);
+    XCTAssertEqual(stats.xforms, vgerXformCount(vg));
+    XCTAssertGreaterThan(stats.glyphAtlasUsage, 0);
+    XCTAssertEqual(stats.dropped, 0);
+    XCTAssertGreaterThan(stats.encodeTime, 0);
+
+    // Counters start over each frame.
+    vgerBegin(vg, 512, 512, 1.0);
+    vgerGetStats(vg, &stats);
+    XCTAssertEqual(stats.prims[0][vgerCircle], 0);
+    XCTAssertEqual(stats.textCacheHits, 0);
+
+    vgerDelete(vg);
+}
+
+- (void) testTrace {
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+    auto paint = vgerColorPaint(vg, float4{1,1,1,1});
+    vgerMoveTo(vg, float2{10, 200});
+    vgerLineTo(vg, float2{100, 250});
+    vgerLineTo(vg, float2{50, 300});
+    vgerFill(vg, paint);
+    vgerText(vg, "trace", float4{1,1,1,1}, 0);
+
+    auto commandBuffer = [queue commandBuffer];
+    vgerEncode(vg, commandBuffer, pass);
+    [commandBuffer commit];
+    [commandBuffer waitUntilCompleted];
+
+    // Package.swift defines VGER_TRACING for debug builds, of vger and
+    // the tests alike.
+    auto path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"vgerTrace.json"];
+#ifdef VGER_TRACING
+    XCTAssertTrue(vgerWriteTrace(path.UTF8String));
+    NSData* data = [NSData dataWithContentsOfFile:path];
+    NSDictionary* json = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+    NSArray* events = json[@"traceEvents"];
+    XCTAssertGreaterThan(events.count, 0);
+    auto names = [events valueForKey:@"name"];
+    XCTAssertTrue([names containsObject:@"vger::fill"]);
+    XCTAssertTrue([names containsObject:@"vger::encodeLayer"]);
+
+    // Writing clears the events.
+    XCTAssertTrue(vgerWriteTrace(path.UTF8String));
+    json = [NSJSONSerialization JSONObjectWithData:[NSData dataWithContentsOfFile:path] options:0 error:nil];
+    XCTAssertFalse([[json[@"traceEvents"] valueForKey:@"name"] containsObject:@"vger::fill"]);
+#else
+    XCTAssertFalse(vgerWriteTrace(path.UTF8String));
+#endif
+
+    vgerDelete(vg);
+}
+
+#ifdef VGER_TRACING
+- (void) testTraceThreads {
+
+    auto path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"vgerTraceThreads.json"];
+    vgerWriteTrace(path.UTF8String);
+
+    // Threads record into their own rings, which keep the most recent
+    // vgerTraceEventsPerThread events. Events outlive their threads.
+    int zones[] = {100, 200, vgerTraceEventsPerThread + 10};
+    std::vector<std::thread> threads;
+    for(int n : zones) {
+        threads.emplace_back([n] {
+            for(int i=0;i<n;++i) {
+                VGER_TRACE_ZONE("testTraceThreads");
+            }
+        });
+    }
+    for(auto& t : threads) {
+        t.join();
+    }
+
+    XCTAssertTrue(vgerWriteTrace(path.UTF8String));
+    NSData* data = [NSData dataWithContentsOfFile:path];
+    NSDictionary* json = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+
+    NSCountedSet* tids = [NSCountedSet new];
+    for(NSDictionary* event in json[@"traceEvents"]) {
+        if([event[@"name"] isEqualToString:@"testTraceThreads"]) {
+            [tids addObject:event[@"tid"]];
+        }
+    }
+
+    XCTAssertEqual(tids.count, 3);
+    NSMutableArray* counts = [NSMutableArray new];
+    for(id tid in tids) {
+        [counts addObject:@([tids countForObject:tid])];
+    }
+    [counts sortUsingSelector:@selector(compare:)];
+    XCTAssertEqualObjects(counts, (@[@100, @200, @(vgerTraceEventsPerThread)]));
+    XCTAssertEqualObjects(json[@"otherData"][@"droppedEvents"], @10);
+}
+#endif
+
+- (void) testPaintInterning {
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+
+    auto& paints = vg->scenes[vg->currentScene].paints;
+    auto count = paints.count;
+
+    auto a = vgerColorPaint(vg, float4{1,0,1,1});
+    auto b = vgerColorPaint(vg, float4{1,0,1,1});
+    auto c = vgerColorPaint(vg, float4{0,1,0,1});
+    XCTAssertEqual(a.index, b.index);
+    XCTAssertNotEqual(a.index, c.index);
+
+    auto g0 = vgerLinearGradient(vg, float2{0,0}, float2{10,0}, float4{1,0,0,1}, float4{0,0,1,1}, 0);
+    auto g1 = vgerLinearGradient(vg, float2{0,0}, float2{10,0}, float4{1,0,0,1}, float4{0,0,1,1}, 0);
+    auto g2 = vgerLinearGradient(vg, float2{0,0}, float2{20,0}, float4{1,0,0,1}, float4{0,0,1,1}, 0);
+    XCTAssertEqual(g0.index, g1.index);
+    XCTAssertNotEqual(g0.index, g2.index);
+
+    XCTAssertEqual(paints.count - count, 4);
+
+    vgerDelete(vg);
+}
+
+- (void) testRetainedPaint {
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+
+    auto color = float4{0.25,0.5,0.75,1};
+    auto retained = vgerRetainPaint(vg, vgerColorPaint(vg, color));
+
+    // Usable in the frame it was retained.
+    auto& paints0 = vg->scenes[vg->currentScene].paints;
+    XCTAssertTrue(simd_equal(paints0.ptr[retained.index].innerColor, color));
+
+    // Same index in later frames.
+    for(int frame=0;frame<3;++frame) {
+        vgerBegin(vg, 512, 512, 1.0);
+        auto& paints = vg->scenes[vg->currentScene].paints;
+        XCTAssertTrue(simd_equal(paints.ptr[retained.index].innerColor, color));
+        XCTAssertNotEqual(vgerColorPaint(vg, float4{1,0,0,1}).index, retained.index);
+    }
+
+    // Released slots are reused.
+    vgerReleasePaint(vg, retained);
+    auto again = vgerRetainPaint(vg, vgerColorPaint(vg, float4{1,0,0,1}));
+    XCTAssertEqual(again.index, retained.index);
+
+    vgerDelete(vg);
+}
+
+- (void) testReleasePaintTwice {
+
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+
+    auto retained = vgerRetainPaint(vg, vgerColorPaint(vg, float4{1,0,0,1}));
+
+    // The second release does nothing, so the slot is only reused once.
+    vgerReleasePaint(vg, retained);
+    vgerReleasePaint(vg, retained);
+
+    auto a = vgerRetainPaint(vg, vgerColorPaint(vg, float4{0,1,0,1}));
+    auto b = vgerRetainPaint(vg, vgerColorPaint(vg, float4{0,0,1,1}));
+    XCTAssertEqual(a.index, retained.index);
+    XCTAssertNotEqual(b.index, a.index);
+
+    // Paints which were never retained aren't released.
+    auto count = vg->freePaints.size();
+    vgerReleasePaint(vg, vgerColorPaint(vg, float4{1,1,0,1}));
+    vgerReleasePaint(vg, {1000});
+    XCTAssertEqual(vg->freePaints.size(), count);
+
+    vgerDelete(vg);
+}
+
+- (void) testRetainManyPaints {
+
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+
+    // More paints than the reserved slots, retained after this frame's
+    // paints.
+    std::vector<vgerPaintIndex> frame;
+    for(int i=0;i<8;++i) {
+        frame.push_back(vgerColorPaint(vg, float4{0, 0, float(i), 1}));
+    }
+
+    std::vector<vgerPaintIndex> retained;
+    auto color = [](int i) { return float4{float(i), 0, 0, 1}; };
+    for(int i=0;i<40;++i) {
+        retained.push_back(vgerRetainPaint(vg, vgerColorPaint(vg, color(i))));
+    }
+
+    auto check = [&] {
+        auto& paints = vg->scenes[vg->currentScene].paints;
+        for(int i=0;i<40;++i) {
+            XCTAssertTrue(simd_equal(paints.ptr[retained[i].index].innerColor, color(i)));
+        }
+    };
+
+    check();
+    for(int i=0;i<8;++i) {
+        auto& paints = vg->scenes[vg->currentScene].paints;
+        XCTAssertTrue(simd_equal(paints.ptr[frame[i].index].innerColor, float4{0, 0, float(i), 1}));
+    }
+
+    // Same indices in later frames, without clashing with new paints.
+    for(int f=0;f<2;++f) {
+        vgerBegin(vg, 512, 512, 1.0);
+        auto p = vgerColorPaint(vg, float4{0, 1, 0, 1});
+        for(auto r : retained) {
+            XCTAssertNotEqual(p.index, r.index);
+        }
+        check();
+    }
+
+    vgerDelete(vg);
+}
+
+- (void) testAffine {
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+
+    vgerTranslate(vg, float2{10, 20});
+    vgerRotate(vg, 0.5);
+    vgerScale(vg, float2{2, 3});
+
+    // Same as the 3x3 matrix product.
+    auto T = matrix_identity_float3x3, R = matrix_identity_float3x3, S = matrix_identity_float3x3;
+    T.columns[2] = float3{10, 20, 1};
+    R.columns[0] = float3{cosf(0.5), sinf(0.5), 0};
+    R.columns[1] = float3{-sinf(0.5), cosf(0.5), 0};
+    S.columns[0].x = 2;
+    S.columns[1].y = 3;
+    auto M = matrix_multiply(T, matrix_multiply(R, S));
+
+    float2 p = {5, 7};
+    auto q = matrix_multiply(M, float3{p.x, p.y, 1});
+    auto r = vgerTransform(vg, p);
+    XCTAssertEqualWithAccuracy(r.x, q.x, 1e-4);
+    XCTAssertEqualWithAccuracy(r.y, q.y, 1e-4);
+
+    auto A = vgerCurrentTransform(vg);
+    auto back = affineApply(affineInverse(A), r);
+    XCTAssertEqualWithAccuracy(back.x, p.x, 1e-4);
+    XCTAssertEqualWithAccuracy(back.y, p.y, 1e-4);
+
+    auto I = affineCompose(A, affineInverse(A));
+    for(int i=0;i<3;++i) {
+        XCTAssertEqualWithAccuracy(simd_distance(I.columns[i], affineIdentity().columns[i]), 0, 1e-5);
+    }
+
+    vgerDelete(vg);
+}
+
+- (void) testTransformRecordingPerf {
+
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+
+    [self measureBlock:^{
+        vgerBegin(vg, 512, 512, 1.0);
+        auto paint = vgerColorPaint(vg, float4{1,0,1,1});
+        for(int i=0;i<100000;++i) {
+            vgerSave(vg);
+            vgerTranslate(vg, float2{float(i % 512), float(i / 512)});
+            vgerRotate(vg, 0.01f * i);
+            vgerScale(vg, float2{1.5, 1.5});
+            vgerFillRect(vg, float2{0,0}, float2{4,4}, 1, paint);
+            vgerRestore(vg);
+        }
+    }];
+
+    vgerDelete(vg);
+}
+
+/// Records n prims, mixing types, into a scene with the given storage.
+template<class Storage>
+static double recordPrims(vgerBasicScene<Storage>& scene, int n) {
+    auto start = std::chrono::steady_clock::now();
+    scene.clear();
+    for(int i=0;i<n;++i) {
+        vgerPrim prim = {
+            .type = (i % 3 == 0) ? vgerBezier : ((i % 3 == 1) ? vgerRect : vgerCircle),
+            .width = 1,
+            .radius = 2,
+            .cvs = { float2{float(i % 512), float(i / 512)}, float2{float(i % 512) + 8, 4}, float2{0, 8} },
+            .xform = uint32_t(i / 16)
+        };
+        scene.addPrim(0, prim);
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+- (void) testSceneRecordingPerf {
+
+    int n = 1000000;
+
+    vgerHeapScene heapScene;
+    vgerScene metalScene;
+    for(int layer=0;layer<VGER_MAX_LAYERS;++layer) {
+        metalScene.prims[layer] = GPUChunkedVec<vgerCompactPrim>(vgerMetalStorage(device));
+    }
+    metalScene.cvs = GPUVec<float2>(vgerMetalStorage(device));
+
+    // The first pass includes growing the buffers. Prims are chunked, so
+    // growing doesn't copy, and clear merges the chunks for the next pass.
+    for(int pass=0;pass<2;++pass) {
+        auto heapTime = recordPrims(heapScene, n);
+        auto metalTime = recordPrims(metalScene, n);
+        printf("pass %d: heap %f ms, metal %f ms\n", pass, heapTime, metalTime);
+    }
+
+    auto& heapPrims = heapScene.prims[0];
+    auto& metalPrims = metalScene.prims[0];
+    XCTAssertEqual(heapPrims.count, n);
+    XCTAssertEqual(metalPrims.count, n);
+    XCTAssertEqual(heapPrims.chunks.size(), 1);
+    XCTAssertEqual(metalPrims.chunks.size(), 1);
+    XCTAssertEqual(heapScene.cvs.count, metalScene.cvs.count);
+    XCTAssertEqual(memcmp(heapPrims.chunks[0].ptr, metalPrims.chunks[0].ptr, n * sizeof(vgerCompactPrim)), 0);
+    XCTAssertEqual(uintptr_t(heapPrims.chunks[0].ptr) % vgerHeapStorage::Alignment, 0);
+    XCTAssertEqual(heapScene.dropped(), 0);
+}
+
+/// Heap storage which fails to allocate more than 4KB.
+struct LimitedStorage : vgerHeapStorage {
+    LimitedStorage() { }
+    LimitedStorage(const vgerHeapStorage& s) : vgerHeapStorage(s) { }
+    LimitedStorage reallocate(size_t length) const {
+        return length > 4096 ? LimitedStorage() : LimitedStorage(vgerHeapStorage::reallocate(length));
+    }
+};
+
+- (void) testChunkedGrowth {
+
+    vgerChunkedVec<int, vgerHeapStorage> vec;
+    vec.append(0);
+    auto first = vec.chunks[0].ptr;
+    for(int i=1;i<5000;++i) {
+        vec.append(i);
+    }
+
+    // Growing adds chunks rather than copying.
+    XCTAssertEqual(vec.count, 5000);
+    XCTAssertGreaterThan(vec.chunks.size(), 1);
+    XCTAssertEqual(vec.chunks[0].ptr, first);
+    for(int i=0;i<5000;++i) {
+        XCTAssertEqual(vec[i], i);
+    }
+
+    // Clearing merges the chunks.
+    auto cap = vec.capacity();
+    vec.clear();
+    XCTAssertEqual(vec.chunks.size(), 1);
+    XCTAssertEqual(vec.capacity(), cap);
+
+    // Elements which don't fit are counted.
+    vgerVec<int, LimitedStorage> limited;
+    for(int i=0;i<2000;++i) {
+        limited.append(i);
+    }
+    XCTAssertEqual(limited.count, 1024);
+    XCTAssertEqual(limited.dropped, 976);
+
+    limited.clear();
+    XCTAssertEqual(limited.dropped, 0);
+}
+
+- (void) testBezierCvsDropped {
+
+    vgerBasicScene<LimitedStorage> scene;
+    LimitedStorage storage = vgerHeapStorage().reallocate(4096);
+    scene.prims[0] = vgerChunkedVec<vgerCompactPrim, LimitedStorage>(vgerVec<vgerCompactPrim, LimitedStorage>(storage));
+    scene.cvs = vgerVec<float2, LimitedStorage>(vgerHeapStorage().reallocate(4096));
+
+    // Only one of the bezier's cvs fits, so the prim is dropped with them.
+    scene.cvs.count = scene.cvs.capacity - 1;
+    vgerPrim bezier{};
+    bezier.type = vgerBezier;
+    scene.addPrim(0, bezier);
+    XCTAssertEqual(scene.prims[0].count, 0);
+    XCTAssertEqual(scene.cvs.count, scene.cvs.capacity - 1);
+    XCTAssertEqual(scene.dropped(), 4);
+
+    // Prims without cvs still fit.
+    vgerPrim circle{};
+    circle.type = vgerCircle;
+    scene.addPrim(0, circle);
+    XCTAssertEqual(scene.prims[0].count, 1);
+}
+
+- (void) testRecordReplay {
+
+    int w = 256, h = 256;
+    auto path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"vgerTestRecording.vgr"];
+
+    auto draw = [](vgerContext vg) {
+        vgerBegin(vg, 256, 256, 1.0);
+        auto red = vgerColorPaint(vg, float4{1,0,0,1});
+        auto gradient = vgerLinearGradient(vg, float2{0,0}, float2{256,0}, float4{0,0,1,1}, float4{0,1,0,1}, 0);
+        vgerSave(vg);
+        vgerTranslate(vg, float2{20, 30});
+        vgerRotate(vg, 0.3);
+        vgerFillRect(vg, float2{0,0}, float2{100,50}, 8, gradient);
+        vgerStrokeSegment(vg, float2{0,0}, float2{200,100}, 3, red);
+        vgerRestore(vg);
+        vgerFillCircle(vg, float2{180, 180}, 40, red);
+        vgerMoveTo(vg, float2{10, 200});
+        vgerLineTo(vg, float2{100, 250});
+        vgerCubicApproxTo(vg, float2{80, 180}, float2{40, 160}, float2{10, 200});
+        vgerFill(vg, gradient);
+        vgerText(vg, "recorded", float4{1,1,1,1}, 0);
+    };
+
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBeginRecording(vg);
+    draw(vg);
+    XCTAssertTrue(vgerEndRecording(vg, path.UTF8String));
+
+    std::vector<uint8_t> expected(w*h*4), replayed(w*h*4);
+    vgerRenderCPU(vg, expected.data(), w, h, w*4);
+    auto primCount = vgerPrimCount(vg);
+    vgerDelete(vg);
+
+    auto vg2 = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    XCTAssertTrue(vgerReplay(vg2, path.UTF8String));
+    XCTAssertEqual(vgerPrimCount(vg2), primCount);
+    vgerRenderCPU(vg2, replayed.data(), w, h, w*4);
+    XCTAssertTrue(expected == replayed);
+
+    // Calls made inside other API calls aren't recorded twice.
+    XCTAssertEqual(vgerStackDepth(vg2), 1);
+
+    XCTAssertFalse(vgerReplay(vg2, "/nonexistent/recording.vgr"));
+
+    vgerDelete(vg2);
+}
+
+- (void) testReplayInvalidPaint {
+
+    auto path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"vgerTestInvalidPaint.vgr"];
+
+    // A release of a paint which isn't retained is rejected.
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBeginRecording(vg);
+    vgerBegin(vg, 256, 256, 1.0);
+    auto retained = vgerRetainPaint(vg, vgerColorPaint(vg, float4{1,0,0,1}));
+    vgerReleasePaint(vg, retained);
+    vgerReleasePaint(vg, retained);
+    XCTAssertTrue(vgerEndRecording(vg, path.UTF8String));
+    vgerDelete(vg);
+
+    auto vg2 = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    XCTAssertFalse(vgerReplay(vg2, path.UTF8String));
+    vgerDelete(vg2);
+
+    // So is a retain of a paint which doesn't exist. The retain's paint
+    // index is second to last.
+    vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBeginRecording(vg);
+    vgerBegin(vg, 256, 256, 1.0);
+    vgerRetainPaint(vg, vgerColorPaint(vg, float4{1,0,0,1}));
+    XCTAssertTrue(vgerEndRecording(vg, path.UTF8String));
+    vgerDelete(vg);
+
+    auto data = [NSMutableData dataWithContentsOfFile:path];
+    uint32_t bad = 1000;
+    [data replaceBytesInRange:NSMakeRange(data.length - 2*sizeof(uint32_t), sizeof(uint32_t)) withBytes:&bad];
+    XCTAssertTrue([data writeToFile:path atomically:YES]);
+
+    vg2 = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    XCTAssertFalse(vgerReplay(vg2, path.UTF8String));
+    vgerDelete(vg2);
+}
+
+- (void) testReplayInvalidGlyphRasterMode {
+
+    auto path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"vgerTestInvalidMode.vgr"];
+
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBeginRecording(vg);
+    vgerSetGlyphRasterMode(vg, VGER_GLYPHS_ASYNC_WAIT);
+    XCTAssertTrue(vgerEndRecording(vg, path.UTF8String));
+    vgerDelete(vg);
+
+    auto vg2 = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    XCTAssertTrue(vgerReplay(vg2, path.UTF8String));
+    XCTAssertEqual(vg2->glyphRasterMode, VGER_GLYPHS_ASYNC_WAIT);
+    vgerDelete(vg2);
+
+    // The mode is last. Out of range modes are rejected.
+    auto data = [NSMutableData dataWithContentsOfFile:path];
+    int32_t bad = 7;
+    [data replaceBytesInRange:NSMakeRange(data.length - sizeof(int32_t), sizeof(int32_t)) withBytes:&bad];
+    XCTAssertTrue([data writeToFile:path atomically:YES]);
+
+    vg2 = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    XCTAssertFalse(vgerReplay(vg2, path.UTF8String));
+    XCTAssertEqual(vg2->glyphRasterMode, VGER_GLYPHS_SYNC);
+    vgerDelete(vg2);
+}
+
+- (void) testStaticScene {
+
+    auto path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"vgerTestScene.vgs"];
+
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+
+    auto red = vgerColorPaint(vg, float4{1,0,0,1});
+    auto gradient = vgerLinearGradient(vg, float2{0,0}, float2{512,0}, float4{0,0,1,1}, float4{0,1,0,1}, 0);
+    vgerTranslate(vg, float2{20, 30});
+    vgerFillRect(vg, float2{0,0}, float2{200,100}, 8, gradient);
+    vgerFillCircle(vg, float2{300, 300}, 80, red);
+    vgerMoveTo(vg, float2{10, 400});
+    vgerLineTo(vg, float2{100, 450});
+    vgerQuadTo(vg, float2{80, 380}, float2{10, 400});
+    vgerFill(vg, red);
+
+    XCTAssertTrue(vgerSaveScene(vg, path.UTF8String));
+
+    auto scene = vgerLoadScene(vg, path.UTF8String);
+    XCTAssertNotEqual(scene.index, 0);
+
+    auto& saved = vg->scenes[vg->currentScene];
+    auto& loaded = vg->staticScenes[scene.index];
+    XCTAssertEqual(loaded.layerCount, 1);
+
+    auto check = [](auto& a, auto& b) {
+        XCTAssertEqual(a.count, b.count);
+        XCTAssertEqual(memcmp(a.ptr, b.ptr, a.count * sizeof(*a.ptr)), 0);
+        XCTAssertEqual(uintptr_t(b.storage.buffer.contents) % vgerSceneFilePageSize, 0);
+    };
+
+    check(saved.prims[0].chunks[0], loaded.scene.prims[0].chunks[0]);
+    check(saved.cvs, loaded.scene.cvs);
+    check(saved.xforms, loaded.scene.xforms);
+    check(saved.paints, loaded.scene.paints);
+
+    auto commandBuffer = [queue commandBuffer];
+    vgerEncodeStaticScene(vg, scene, commandBuffer, pass);
+    [commandBuffer commit];
+    [commandBuffer waitUntilCompleted];
+
+    vgerDeleteStaticScene(vg, scene);
+
+    XCTAssertEqual(vgerLoadScene(vg, "/nonexistent/scene.vgs").index, 0);
+
+    vgerDelete(vg);
+}
+
+- (void) testCorruptStaticScene {
+
+    auto path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"vgerTestCorruptScene.vgs"];
+
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, 512, 512, 1.0);
+
+    auto red = vgerColorPaint(vg, float4{1,0,0,1});
+    vgerFillCircle(vg, float2{300, 300}, 80, red);
+    vgerMoveTo(vg, float2{10, 400});
+    vgerLineTo(vg, float2{100, 450});
+    vgerQuadTo(vg, float2{80, 380}, float2{10, 400});
+    vgerFill(vg, red);
+
+    XCTAssertTrue(vgerSaveScene(vg, path.UTF8String));
+    auto original = [NSData dataWithContentsOfFile:path];
+
+    // Loads the file after changing it.
+    auto load = [&](auto corrupt) {
+        auto data = [original mutableCopy];
+        auto bytes = (uint8_t*) data.mutableBytes;
+        corrupt(bytes, *(vgerSceneFileHeader*) bytes);
+        [data writeToFile:path atomically:YES];
+        auto scene = vgerLoadScene(vg, path.UTF8String);
+        if(scene.index) {
+            vgerDeleteStaticScene(vg, scene);
+        }
+        return scene.index;
+    };
+
+    XCTAssertNotEqual(load([](uint8_t*, vgerSceneFileHeader&) {}), 0);
+
+    // A count whose size in bytes overflows.
+    XCTAssertEqual(load([](uint8_t*, vgerSceneFileHeader& header) {
+        header.cvs.count = (UINT64_MAX / sizeof(float2)) + 2;
+    }), 0);
+
+    // Prims referring past the end of the cvs, paints or transforms.
+    auto prim = [](uint8_t* bytes, vgerSceneFileHeader& header, vgerPrimType type) {
+        auto prims = (vgerCompactPrim*) (bytes + header.prims[0].offset);
+        for(uint64_t i=0;i<header.prims[0].count;++i) {
+            if(primType(prims[i]) == type) {
+                return &prims[i];
+            }
+        }
+        return (vgerCompactPrim*) nullptr;
+    };
+
+    XCTAssertEqual(load([&](uint8_t* bytes, vgerSceneFileHeader& header) {
+        prim(bytes, header, vgerPathFill)->data[1] = UINT32_MAX;
+    }), 0);
+
+    XCTAssertEqual(load([&](uint8_t* bytes, vgerSceneFileHeader& header) {
+        prim(bytes, header, vgerPathFill)->data[0] = uint32_t(header.cvs.count);
+    }), 0);
+
+    XCTAssertEqual(load([&](uint8_t* bytes, vgerSceneFileHeader& header) {
+        auto cp = prim(bytes, header, vgerCircle);
+        cp->header = (cp->header & 0xff) | uint32_t(header.paints.count) << 8;
+    }), 0);
+
+    XCTAssertEqual(load([&](uint8_t* bytes, vgerSceneFileHeader& header) {
+        prim(bytes, header, vgerCircle)->xform = uint32_t(header.xforms.count);
+    }), 0);
+
+    vgerDelete(vg);
+}
+
 - (void) testBasic {
 
     float theta = 0;
@@ -896,6 +1643,311 @@ void makeCircle(vgerContext vger, float2 center, float radius) {
     vgerDelete(vger);
 }
 
+/// Tiling should lower the average number of segments each pixel tests
+/// against for path fills.
+- (void) testTigerSegmentTests {
+
+    auto tigerURL = [self getImageURL:@"Ghostscript_Tiger.svg"];
+
+    auto image = nsvgParseFromFile(tigerURL.path.UTF8String, "px", 96);
+
+    auto vger = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+
+    float result[2];
+    float tileWidths[2] = {0, 64};
+
+    for(int t=0;t<2;++t) {
+
+        vgerSetPathTileWidth(vger, tileWidths[t]);
+        vgerBegin(vger, 512, 512, 1.0);
+
+        vgerSave(vger);
+        vgerTranslate(vger, float2{0, 512});
+        vgerScale(vger, float2{0.5, -0.5});
+
+        for (NSVGshape *shape = image->shapes; shape; shape = shape->next) {
+
+            auto paint = vgerColorPaint(vger, float4{1,1,1,1});
+
+            for (NSVGpath *path = shape->paths; path; path = path->next) {
+                float2* pts = (float2*) path->pts;
+                vgerMoveTo(vger, pts[0]);
+                for(int i=1; i<path->npts-2; i+=3) {
+                    vgerCubicApproxTo(vger, pts[i], pts[i+1], pts[i+2]);
+                }
+            }
+
+            vgerFill(vger, paint);
+        }
+
+        vgerRestore(vger);
+
+        result[t] = vger->scenes[vger->currentScene].segmentTestsPerPixel(0, 0.5);
+        printf("tile width %f: %f segment tests per pixel, %d prims\n", tileWidths[t], result[t], (int) vgerPrimCount(vger));
+    }
+
+    XCTAssertLessThan(result[1], result[0]);
+
+    [self render:vger name:@"tiger_tiled.png"];
+
+    nsvgDelete(image);
+
+    vgerDelete(vger);
+}
+
+/// At scales below 1 a pixel spans more than a unit, so tiles must include
+/// segments further away or there are seams.
+- (void) testTiledFillSmallScale {
+
+    auto tigerURL = [self getImageURL:@"Ghostscript_Tiger.svg"];
+    auto image = nsvgParseFromFile(tigerURL.path.UTF8String, "px", 96);
+
+    int w = 256, h = 256;
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+
+    std::vector<uint8_t> pixels[2];
+    float tileWidths[2] = {0, 16};
+
+    for(int t=0;t<2;++t) {
+
+        vgerSetPathTileWidth(vg, tileWidths[t]);
+        vgerBegin(vg, w, h, 1.0);
+
+        vgerSave(vg);
+        vgerTranslate(vg, float2{0, float(h)});
+        vgerScale(vg, float2{0.25, -0.25});
+
+        auto white = vgerColorPaint(vg, float4{1,1,1,1});
+
+        for (NSVGshape *shape = image->shapes; shape; shape = shape->next) {
+            for (NSVGpath *path = shape->paths; path; path = path->next) {
+                float2* pts = (float2*) path->pts;
+                vgerMoveTo(vg, pts[0]);
+                for(int i=1; i<path->npts-2; i+=3) {
+                    vgerCubicApproxTo(vg, pts[i], pts[i+1], pts[i+2]);
+                }
+            }
+            vgerFill(vg, white);
+        }
+
+        vgerRestore(vg);
+
+        pixels[t].resize(w*h*4);
+        vgerRenderCPU(vg, pixels[t].data(), w, h, w*4);
+    }
+
+    int mismatched = 0;
+    for(int i=0;i<w*h;++i) {
+        if(std::abs(int(pixels[0][4*i]) - int(pixels[1][4*i])) > 2) {
+            ++mismatched;
+        }
+    }
+
+    XCTAssertEqual(mismatched, 0);
+
+    nsvgDelete(image);
+    vgerDelete(vg);
+}
+
+static void addStar(vgerContext vg) {
+    vgerMoveTo(vg, float2{0, 50});
+    for(int i=1;i<=5;++i) {
+        float theta = i * 4 * M_PI / 5;
+        vgerQuadTo(vg, float2{0, 0}, float2{50 * sinf(theta), 50 * cosf(theta)});
+    }
+}
+
+- (void) testRetainedPath {
+
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    int w = 256, h = 256;
+    std::vector<uint8_t> immediate(w*h*4), retained(w*h*4);
+
+    vgerBegin(vg, w, h, 1.0);
+    auto paint = vgerColorPaint(vg, float4{1,1,1,1});
+    for(int i=0;i<3;++i) {
+        vgerSave(vg);
+        vgerTranslate(vg, float2{60.0f + 60*i, 128});
+        vgerRotate(vg, i * 0.3f);
+        addStar(vg);
+        vgerFill(vg, paint);
+        vgerRestore(vg);
+    }
+    vgerRenderCPU(vg, immediate.data(), w, h, w*4);
+
+    addStar(vg);
+    auto path = vgerCreatePath(vg);
+    XCTAssertNotEqual(path.index, 0);
+
+    vgerBegin(vg, w, h, 1.0);
+    paint = vgerColorPaint(vg, float4{1,1,1,1});
+    for(int i=0;i<3;++i) {
+        vgerSave(vg);
+        vgerTranslate(vg, float2{60.0f + 60*i, 128});
+        vgerRotate(vg, i * 0.3f);
+        vgerFillPath(vg, path, paint);
+        vgerRestore(vg);
+    }
+    vgerRenderCPU(vg, retained.data(), w, h, w*4);
+
+    XCTAssertTrue(immediate == retained);
+
+    // Deleted indices are reused.
+    vgerDeletePath(vg, path);
+    addStar(vg);
+    XCTAssertEqual(vgerCreatePath(vg).index, path.index);
+
+    // Empty paths give the error index.
+    XCTAssertEqual(vgerCreatePath(vg).index, 0);
+
+    vgerDelete(vg);
+}
+
+- (void) testDeletePathTwice {
+
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+
+    addStar(vg);
+    auto path = vgerCreatePath(vg);
+    XCTAssertNotEqual(path.index, 0);
+
+    // The second delete does nothing, so the index is only reused once.
+    vgerDeletePath(vg, path);
+    vgerDeletePath(vg, path);
+
+    addStar(vg);
+    auto a = vgerCreatePath(vg);
+    addStar(vg);
+    auto b = vgerCreatePath(vg);
+
+    XCTAssertEqual(a.index, path.index);
+    XCTAssertNotEqual(b.index, a.index);
+
+    vgerDeletePath(vg, b);
+    vgerDeletePath(vg, b);
+    XCTAssertEqual(vg->freePaths.size(), 1);
+
+    vgerDelete(vg);
+}
+
+- (void) testRetainedTigerPerf {
+
+    auto tigerURL = [self getImageURL:@"Ghostscript_Tiger.svg"];
+
+    auto image = nsvgParseFromFile(tigerURL.path.UTF8String, "px", 96);
+
+    auto vger = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+
+    std::vector<vgerPathIndex> paths;
+    std::vector<float4> colors;
+
+    for (NSVGshape *shape = image->shapes; shape; shape = shape->next) {
+
+        auto c = shape->fill.color;
+        colors.push_back(float4{
+            float((c >> 0) & 0xff),
+            float((c >> 8) & 0xff),
+            float((c >> 16) & 0xff),
+            float((c >> 24) & 0xff)
+        } * 1.0/255.0);
+
+        for (NSVGpath *path = shape->paths; path; path = path->next) {
+            float2* pts = (float2*) path->pts;
+            vgerMoveTo(vger, pts[0]);
+            for(int i=1; i<path->npts-2; i+=3) {
+                vgerCubicApproxTo(vger, pts[i], pts[i+1], pts[i+2]);
+            }
+        }
+
+        paths.push_back(vgerCreatePath(vger));
+    }
+
+    nsvgDelete(image);
+
+    [self measureBlock:^{
+
+        vgerBegin(vger, 512, 512, 1.0);
+
+        vgerSave(vger);
+        vgerTranslate(vger, float2{0, 512});
+        vgerScale(vger, float2{0.5, -0.5});
+
+        for(size_t i=0;i<paths.size();++i) {
+            vgerFillPath(vger, paths[i], vgerColorPaint(vger, colors[i]));
+        }
+
+        vgerRestore(vger);
+
+        auto commandBuffer = [queue commandBuffer];
+        vgerEncode(vger, commandBuffer, pass);
+        [commandBuffer commit];
+        [commandBuffer waitUntilCompleted];
+    }];
+
+    vgerDelete(vger);
+}
+
+/// Wiggly circle made of n line segments.
+static void addWigglyCircle(vgerContext vg, int n, float2 center, float radius) {
+    auto point = [&](int i) {
+        float theta = 2 * M_PI * i / n;
+        float r = radius * (1 + 0.05 * sinf(200 * theta));
+        return center + r * float2{cosf(theta), sinf(theta)};
+    };
+    vgerMoveTo(vg, point(0));
+    for(int i=1;i<=n;++i) {
+        vgerLineTo(vg, point(i));
+    }
+}
+
+- (void) testHugePath {
+
+    int w = 512, h = 512;
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+    vgerBegin(vg, w, h, 1.0);
+
+    auto paint = vgerColorPaint(vg, float4{1,1,1,1});
+    addWigglyCircle(vg, 100000, float2{256, 256}, 200);
+    XCTAssertTrue(vgerFill(vg, paint));
+
+    // Dense tiles are split. Segments are fattened by a unit, so tiles
+    // can't get below a few units wide.
+    uint32_t maxCount = 0;
+    auto& prims = vg->scenes[vg->currentScene].prims[0];
+    for(size_t i=0;i<prims.count;++i) {
+        if(primType(prims[i]) == vgerPathFill) {
+            maxCount = std::max(maxCount, decodePrim(prims[i], nullptr).count);
+        }
+    }
+    printf("prims: %d, max segments per prim: %d\n", int(prims.count), int(maxCount));
+    XCTAssertLessThan(maxCount, 1000);
+
+    std::vector<uint8_t> pixels(w*h*4);
+    vgerRenderCPU(vg, pixels.data(), w, h, w*4);
+    XCTAssertEqual(pixels[4*(256*w + 256)], 255);
+    XCTAssertEqual(pixels[4*(10*w + 10)], 0);
+
+    vgerDelete(vg);
+}
+
+- (void) testHugePathPerf {
+
+    auto vg = vgerNew(0, MTLPixelFormatBGRA8Unorm);
+
+    [self measureWithMetrics:@[[XCTClockMetric new], [XCTMemoryMetric new]] block:^{
+        vgerBegin(vg, 512, 512, 1.0);
+        addWigglyCircle(vg, 100000, float2{256, 256}, 200);
+        vgerFill(vg, vgerColorPaint(vg, float4{1,1,1,1}));
+
+        auto commandBuffer = [queue commandBuffer];
+        vgerEncode(vg, commandBuffer, pass);
+        [commandBuffer commit];
+        [commandBuffer waitUntilCompleted];
+    }];
+
+    vgerDelete(vg);
+}
+
 - (void) testTextLayoutKey {
 
     TextLayoutKey keyA{"test", 12, VGER_ALIGN_LEFT};
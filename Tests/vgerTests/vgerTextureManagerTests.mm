@@ -4,6 +4,7 @@
 #import "../../Sources/vger/vgerTextureManager.h"
 #import <MetalKit/MetalKit.h>
 #import "testUtils.h"
+#include <vector>
 
 @interface vgerTextureManagerTests : XCTestCase {
     id<MTLDevice> device;
@@ -71,6 +72,194 @@
     showTexture(mgr.atlas, @"atlas.png");
 }
 
+- (void) update:(vgerTextureManager*)mgr {
+    id<MTLCommandBuffer> buf = [queue commandBuffer];
+    [mgr update:buf];
+
+    #if TARGET_OS_OSX
+    auto blitEncoder = [buf blitCommandEncoder];
+    [blitEncoder synchronizeResource:mgr.atlas];
+    [blitEncoder endEncoding];
+    #endif
+
+    [buf commit];
+    [buf waitUntilCompleted];
+}
+
+- (void)testEviction {
+    vgerTextureManager* mgr = [[vgerTextureManager alloc] initWithDevice:device pixelFormat:MTLPixelFormatA8Unorm];
+
+    // 16 regions fill the atlas.
+    int sz = 512;
+    std::vector<uint8_t> data(sz*sz, 255);
+    for(int i=0;i<16;++i) {
+        XCTAssertEqual([mgr addRegion:data.data() width:sz height:sz bytesPerRow:sz], i+1);
+    }
+    [self update:mgr];
+    XCTAssertEqual(mgr.evictedCount, 0);
+    XCTAssertEqual(mgr.failedCount, 0);
+    XCTAssertEqualWithAccuracy(mgr.usage, 1.0, 0.001);
+
+    // Region 3 wasn't used last frame, so it's evicted to make room.
+    [mgr beginFrame];
+    [mgr beginFrame];
+    for(int i=1;i<=16;++i) {
+        if(i != 3) {
+            [mgr useRegion:i];
+        }
+    }
+    auto old = [mgr getRects][2];
+
+    auto region = [mgr addRegion:data.data() width:sz height:sz bytesPerRow:sz];
+    XCTAssertEqual(region, 17);
+    [self update:mgr];
+
+    XCTAssertEqual(mgr.evictedCount, 1);
+    XCTAssertEqual([mgr getEvictedRegions][0], 3);
+    XCTAssertEqual(mgr.failedCount, 0);
+
+    // The rect is reused.
+    auto r = [mgr getRects][region-1];
+    XCTAssertEqual(r.x, old.x);
+    XCTAssertEqual(r.y, old.y);
+
+    // The index is reused too.
+    XCTAssertEqual([mgr addRegion:data.data() width:sz/2 height:sz/2 bytesPerRow:sz], 3);
+
+    // Everything else was used recently, so this goes on a new page.
+    [self update:mgr];
+    XCTAssertEqual(mgr.evictedCount, 0);
+    XCTAssertEqual(mgr.failedCount, 0);
+    XCTAssertEqual(mgr.pageCount, 2);
+    XCTAssertEqual([mgr getRects][2].id, 1);
+}
+
+- (void)testPages {
+    vgerTextureManager* mgr = [[vgerTextureManager alloc] initWithDevice:device pixelFormat:MTLPixelFormatA8Unorm];
+    XCTAssertEqual(mgr.pageCount, 1);
+    XCTAssertEqual(mgr.atlas.textureType, MTLTextureType2DArray);
+
+    // 16 regions fill a page.
+    int sz = 512;
+    std::vector<uint8_t> data(sz*sz, 255);
+    for(int i=0;i<40;++i) {
+        [mgr addRegion:data.data() width:sz height:sz bytesPerRow:sz];
+    }
+    [self update:mgr];
+
+    XCTAssertEqual(mgr.pageCount, 3);
+    XCTAssertEqual(mgr.atlas.arrayLength, 3);
+    XCTAssertEqual(mgr.failedCount, 0);
+    XCTAssertEqualWithAccuracy(mgr.usage, 40.0 / 48.0, 0.001);
+
+    auto rects = [mgr getRects];
+    for(int i=0;i<40;++i) {
+        XCTAssertEqual(rects[i].id, i / 16);
+    }
+
+    // Pages already in the atlas are copied when it grows.
+    for(int i=0;i<16;++i) {
+        [mgr addRegion:data.data() width:sz height:sz bytesPerRow:sz];
+    }
+    [self update:mgr];
+    XCTAssertEqual(mgr.pageCount, 4);
+
+    rects = [mgr getRects];
+    std::vector<uint8_t> texel(1);
+    [mgr.atlas getBytes:texel.data()
+            bytesPerRow:1
+          bytesPerImage:1
+             fromRegion:MTLRegionMake2D(rects[20].x, rects[20].y, 1, 1)
+            mipmapLevel:0
+                  slice:rects[20].id];
+    XCTAssertEqual(texel[0], 255);
+}
+
+- (void)testFreeRectReuse {
+    vgerTextureManager* mgr = [[vgerTextureManager alloc] initWithDevice:device pixelFormat:MTLPixelFormatA8Unorm];
+
+    int sz = 512;
+    std::vector<uint8_t> data(sz*sz, 255);
+    for(int i=0;i<16;++i) {
+        [mgr addRegion:data.data() width:sz height:sz bytesPerRow:sz];
+    }
+    [self update:mgr];
+
+    // Evicting one big region makes room for four smaller ones, without
+    // evicting more.
+    [mgr beginFrame];
+    [mgr beginFrame];
+    for(int i=2;i<=16;++i) {
+        [mgr useRegion:i];
+    }
+    for(int i=0;i<4;++i) {
+        [mgr addRegion:data.data() width:sz/2 height:sz/2 bytesPerRow:sz];
+    }
+    [self update:mgr];
+
+    XCTAssertEqual(mgr.evictedCount, 1);
+    XCTAssertEqual(mgr.failedCount, 0);
+    XCTAssertEqualWithAccuracy(mgr.usage, 1.0, 0.001);
+}
+
+/// Fills a page with 256x256 glyphs and adds a 512x512 one. Glyphs for
+/// which unused returns true aren't used after the first frame. Those in
+/// the top left 2x2 tiles are used a frame later than the rest, so the
+/// others are least recently used.
+- (vgerTextureManager*) addLargeGlyph:(bool (^)(int tx, int ty))unused {
+    vgerTextureManager* mgr = [[vgerTextureManager alloc] initWithDevice:device pixelFormat:MTLPixelFormatA8Unorm];
+
+    int sz = 256;
+    std::vector<uint8_t> data(4*sz*sz, 255);
+    for(int i=0;i<64;++i) {
+        [mgr addRegion:data.data() width:sz height:sz bytesPerRow:sz];
+    }
+    [self update:mgr];
+    XCTAssertEqual(mgr.pageCount, 1);
+
+    auto rects = [mgr getRects];
+    for(int frame=2;frame<=4;++frame) {
+        [mgr beginFrame];
+        for(int i=0;i<64;++i) {
+            int tx = rects[i].x / sz, ty = rects[i].y / sz;
+            if(!unused(tx, ty) or (frame == 2 and tx < 2 and ty < 2)) {
+                [mgr useRegion:i+1];
+            }
+        }
+    }
+
+    [mgr addRegion:data.data() width:2*sz height:2*sz bytesPerRow:2*sz];
+    [self update:mgr];
+    XCTAssertEqual(mgr.failedCount, 0);
+    return mgr;
+}
+
+- (void)testMixedSizeEviction {
+
+    // Half the page is unused, but no two unused glyphs are next to each
+    // other, so evicting them can't make room. Nothing is evicted and a
+    // page is added instead.
+    auto mgr = [self addLargeGlyph:^(int tx, int ty) { return (tx + ty) % 2 == 0; }];
+    XCTAssertEqual(mgr.evictedCount, 0);
+    XCTAssertEqual(mgr.pageCount, 2);
+    XCTAssertEqual([mgr getRects][64].id, 1);
+
+    // The top left 2x2 glyphs merge into room for the large one. Only
+    // they're evicted, even though the scattered ones are older.
+    mgr = [self addLargeGlyph:^(int tx, int ty) {
+        return (tx < 2 and ty < 2) or (tx >= 4 and (tx + ty) % 2 == 0);
+    }];
+    XCTAssertEqual(mgr.evictedCount, 4);
+    XCTAssertEqual(mgr.pageCount, 1);
+    auto r = [mgr getRects][64];
+    XCTAssertEqual(r.id, 0);
+    XCTAssertEqual(r.x, 0);
+    XCTAssertEqual(r.y, 0);
+    for(int i=0;i<4;++i) {
+        auto e = [mgr getRects][[mgr getEvictedRegions][i] - 1];
+        XCTAssertEqual(e.w, 0);
+    }
+}
 
 
 @end
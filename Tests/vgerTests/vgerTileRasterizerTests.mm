@@ -0,0 +1,237 @@
+// Copyright © 2021 Audulus LLC. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <MetalKit/MetalKit.h>
+#import "vger.h"
+#include <vector>
+#include "nanosvg.h"
+
+#import "../../Sources/vger/vgerTileRasterizer.h"
+
+using namespace simd;
+
+@interface vgerTileRasterizerTests : XCTestCase {
+    id<MTLDevice> device;
+    id<MTLCommandQueue> queue;
+}
+
+@end
+
+@implementation vgerTileRasterizerTests
+
+- (void)setUp {
+    device = MTLCreateSystemDefaultDevice();
+    queue = [device newCommandQueue];
+}
+
+- (NSURL*) getImageURL:(NSString*)name {
+    NSString* path = @"Contents/Resources/vger_vgerTests.bundle/Contents/Resources/images/";
+    path = [path stringByAppendingString:name];
+    NSBundle* bundle = [NSBundle bundleForClass:self.class];
+    return [bundle.bundleURL URLByAppendingPathComponent:path];
+}
+
+static vgerPaint whitePaint() {
+    vgerPaint paint;
+    paint.type = vgerPaintTypeLinearGradient;
+    paint.xform = affineIdentity();
+    paint.innerColor = paint.outerColor = float4{1,1,1,1};
+    paint.image = -1;
+    return paint;
+}
+
+static void addLine(std::vector<float2>& cvs, float2 a, float2 b) {
+    cvs.push_back(a);
+    cvs.push_back((a+b)/2);
+    cvs.push_back(b);
+}
+
+- (void) testSquare {
+
+    vgerTileRasterizer rast;
+    rast.clear(128, 128);
+
+    std::vector<float2> cvs;
+    addLine(cvs, float2{10, 10}, float2{110, 10});
+    addLine(cvs, float2{110, 10}, float2{110, 110});
+    addLine(cvs, float2{110, 110}, float2{10, 110});
+    addLine(cvs, float2{10, 110}, float2{10, 10});
+
+    rast.addPath(cvs.data(), 4, whitePaint(), affineIdentity());
+    rast.render();
+
+    auto alpha = [&](int x, int y) { return rast.pixels[y * 128 + x].w; };
+
+    XCTAssertEqual(alpha(60, 60), 1.0f);
+    XCTAssertEqual(alpha(5, 60), 0.0f);
+    XCTAssertEqual(alpha(120, 60), 0.0f);
+    XCTAssertEqual(alpha(60, 120), 0.0f);
+
+    // Edges are antialiased.
+    XCTAssertGreaterThan(alpha(10, 60), 0.0f);
+    XCTAssertLessThan(alpha(10, 60), 1.0f);
+
+    // Interior tiles are filled from the backdrop without testing segments.
+    XCTAssertEqual(rast.tileSegmentCounts[3 * rast.tilesX + 3], 0);
+    XCTAssertGreaterThan(rast.tileSegmentCounts[0], 0);
+}
+
+- (void) testHole {
+
+    vgerTileRasterizer rast;
+    rast.clear(128, 128);
+
+    // Even-odd, so the inner square is a hole.
+    std::vector<float2> cvs;
+    addLine(cvs, float2{0, 0}, float2{128, 0});
+    addLine(cvs, float2{128, 0}, float2{128, 128});
+    addLine(cvs, float2{128, 128}, float2{0, 128});
+    addLine(cvs, float2{0, 128}, float2{0, 0});
+    addLine(cvs, float2{32, 32}, float2{96, 32});
+    addLine(cvs, float2{96, 32}, float2{96, 96});
+    addLine(cvs, float2{96, 96}, float2{32, 96});
+    addLine(cvs, float2{32, 96}, float2{32, 32});
+
+    rast.addPath(cvs.data(), 8, whitePaint(), affineIdentity());
+    rast.render();
+
+    auto alpha = [&](int x, int y) { return rast.pixels[y * 128 + x].w; };
+
+    XCTAssertEqual(alpha(16, 64), 1.0f);
+    XCTAssertEqual(alpha(64, 64), 0.0f);
+    XCTAssertEqual(alpha(112, 64), 1.0f);
+}
+
+/// Compare against the slab based fill, rendered on the CPU.
+- (void) testMatchesSlabFill {
+
+    auto tigerURL = [self getImageURL:@"Ghostscript_Tiger.svg"];
+    auto image = nsvgParseFromFile(tigerURL.path.UTF8String, "px", 96);
+
+    int w = 512, h = 512;
+
+    auto textureDesc = [MTLTextureDescriptor
+                        texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA8Unorm
+                        width:w
+                        height:h
+                        mipmapped:NO];
+    textureDesc.storageMode = MTLStorageModeShared;
+    auto texture = [device newTextureWithDescriptor:textureDesc];
+
+    auto vg = vgerNew(0, MTLPixelFormatRGBA8Unorm);
+
+    std::vector<uint8_t> slabPixels(w*h*4), tilePixels(w*h*4);
+
+    for(int pass=0;pass<2;++pass) {
+
+        vgerBegin(vg, w, h, 1.0);
+        vgerSave(vg);
+        vgerTranslate(vg, float2{0, 512});
+        vgerScale(vg, float2{0.5, -0.5});
+
+        auto white = vgerColorPaint(vg, float4{1,1,1,1});
+
+        for (NSVGshape *shape = image->shapes; shape; shape = shape->next) {
+            for (NSVGpath *path = shape->paths; path; path = path->next) {
+                float2* pts = (float2*) path->pts;
+                vgerMoveTo(vg, pts[0]);
+                for(int i=1; i<path->npts-2; i+=3) {
+                    vgerCubicApproxTo(vg, pts[i], pts[i+1], pts[i+2]);
+                }
+            }
+
+            if(pass == 0) {
+                vgerFill(vg, white);
+            } else {
+                vgerFillForTile(vg, white);
+            }
+        }
+
+        vgerRestore(vg);
+
+        if(pass == 0) {
+            vgerRenderCPU(vg, slabPixels.data(), w, h, w*4);
+        } else {
+            auto commandBuffer = [queue commandBuffer];
+            vgerEncodeTileRender(vg, commandBuffer, texture);
+            [commandBuffer commit];
+            [commandBuffer waitUntilCompleted];
+            [texture getBytes:tilePixels.data() bytesPerRow:w*4 fromRegion:MTLRegionMake2D(0, 0, w, h) mipmapLevel:0];
+        }
+    }
+
+    // White over black (slab) and white over transparent (tile) both give
+    // coverage in the red channel.
+    int mismatched = 0;
+    for(int i=0;i<w*h;++i) {
+        if(std::abs(int(slabPixels[4*i]) - int(tilePixels[4*i])) > 8) {
+            ++mismatched;
+        }
+    }
+
+    XCTAssertLessThan(mismatched, w*h / 1000);
+
+    XCTAssertNotNil(vgerGetCoarseDebugTexture(vg));
+
+    nsvgDelete(image);
+    vgerDelete(vg);
+}
+
+- (void) testTigerPerf {
+
+    auto tigerURL = [self getImageURL:@"Ghostscript_Tiger.svg"];
+    auto image = nsvgParseFromFile(tigerURL.path.UTF8String, "px", 96);
+
+    auto textureDesc = [MTLTextureDescriptor
+                        texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA8Unorm
+                        width:1920
+                        height:1080
+                        mipmapped:NO];
+    textureDesc.storageMode = MTLStorageModeShared;
+    auto texture = [device newTextureWithDescriptor:textureDesc];
+
+    auto vg = vgerNew(0, MTLPixelFormatRGBA8Unorm);
+
+    [self measureBlock:^{
+
+        vgerBegin(vg, 512, 512, 1.0);
+        vgerSave(vg);
+        vgerTranslate(vg, float2{0, 512});
+        vgerScale(vg, float2{0.5, -0.5});
+
+        for (NSVGshape *shape = image->shapes; shape; shape = shape->next) {
+
+            auto c = shape->fill.color;
+            auto fcolor = float4{
+                float((c >> 0) & 0xff),
+                float((c >> 8) & 0xff),
+                float((c >> 16) & 0xff),
+                float((c >> 24) & 0xff)
+            } * 1.0/255.0;
+
+            auto paint = vgerColorPaint(vg, fcolor);
+
+            for (NSVGpath *path = shape->paths; path; path = path->next) {
+                float2* pts = (float2*) path->pts;
+                vgerMoveTo(vg, pts[0]);
+                for(int i=1; i<path->npts-2; i+=3) {
+                    vgerCubicApproxTo(vg, pts[i], pts[i+1], pts[i+2]);
+                }
+            }
+
+            vgerFillForTile(vg, paint);
+        }
+
+        vgerRestore(vg);
+
+        auto commandBuffer = [queue commandBuffer];
+        vgerEncodeTileRender(vg, commandBuffer, texture);
+        [commandBuffer commit];
+        [commandBuffer waitUntilCompleted];
+    }];
+
+    nsvgDelete(image);
+    vgerDelete(vg);
+}
+
+@end